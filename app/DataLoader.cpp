@@ -10,15 +10,56 @@
  * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
  * 
  */
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <thread>
 #include "../include/DataLoader.h"
-#include "../include/Detection.h"
-#include "../include/Track.h"
+#include "../include/Pipeline.h"
+#include "../include/Profiler.h"
 
-Detection detection;
-Track tracker;
+namespace {
+/**
+ * @brief Milliseconds elapsed since start
+ */
+double elapsedMs(const std::chrono::steady_clock::time_point &start) {
+    return std::chrono::duration<double, std::milli>
+    (std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief CPU time of all threads of the process in milliseconds
+ */
+double cpuTimeMs() {
+    return 1000.0 * std::clock() / CLOCKS_PER_SEC;
+}
+
+/**
+ * @brief Prints the CPU time per frame of a run, to compare the display
+ *        and headless paths
+ */
+void printCpuTime(double cpuStartMs, double wallMs, int frames) {
+    if (frames <= 0)
+        return;
+    std::cout << std::fixed << std::setprecision(2) << "CPU time "
+    << (cpuTimeMs() - cpuStartMs) / frames << " ms/frame, wall time "
+    << wallMs / frames << " ms/frame over " << frames << " frames"
+    << std::endl;
+}
+}  // namespace
+
+/**
+ * @brief Gets the detector shared by all loaders of the process.
+ */
+Detection &DataLoader::sharedDetection() {
+    static Detection detection;
+    return detection;
+}
 /**
  * @brief Dataloader constructor.
  */
@@ -53,6 +94,118 @@ void DataLoader::setPath(const std::string path) {
     path_ = path;
 }
 
+/**
+ * @brief Enables the staged multi-threaded pipeline
+ */
+void DataLoader::setPipelined(bool pipelined) {
+    pipelined_ = pipelined;
+}
+
+/**
+ * @brief Enables the latency bounded real-time mode
+ */
+void DataLoader::setRealtime(bool realtime, double latencyBudgetMs) {
+    realtime_ = realtime;
+    latencyBudgetMs_ = latencyBudgetMs;
+}
+
+/**
+ * @brief Selects the tracking algorithm of this loader
+ */
+void DataLoader::setTrackerMode(TrackerMode mode) {
+    tracker_.setTrackerMode(mode);
+}
+
+/**
+ * @brief Sets the number of threads that update the per-person trackers
+ */
+void DataLoader::setTrackerThreads(int numThreads) {
+    tracker_.setNumThreads(numThreads);
+}
+
+/**
+ * @brief Replaces the fixed detection interval by the adaptive detection policy
+ */
+void DataLoader::setAdaptiveDetection(bool adaptive) {
+    adaptive_ = adaptive;
+}
+
+/**
+ * @brief Gets the detection policy of this loader
+ */
+DetectionPolicy &DataLoader::getDetectionPolicy() {
+    return policy_;
+}
+
+/**
+ * @brief Runs detection only on crops around the tracked people between full-frame passes
+ */
+void DataLoader::setRoiDetection(bool enabled, int fullFrameEvery) {
+    roiDetection_ = enabled;
+    fullFrameEvery_ = fullFrameEvery > 0 ? fullFrameEvery : 1;
+}
+
+/**
+ * @brief Runs full-frame detection on overlapping native resolution tiles
+ */
+void DataLoader::setTiledDetection(bool enabled, int tileSize,
+double overlap, int tileBatch) {
+    tiled_ = enabled;
+    tileSize_ = tileSize;
+    tileOverlap_ = overlap;
+    tileBatch_ = tileBatch;
+}
+
+/**
+ * @brief Skips detection and tracker updates while the scene does not change
+ */
+void DataLoader::setMotionGate(bool enabled, double threshold) {
+    motionGated_ = enabled;
+    gate_.setThreshold(threshold);
+}
+
+/**
+ * @brief Switches processInput to the headless path
+ */
+void DataLoader::setHeadless(bool enabled, const std::string &output) {
+    headless_ = enabled;
+    headlessOutput_ = output;
+}
+
+/**
+ * @brief Runs detection on the whole frame or on regions around the tracks
+ */
+const std::vector<cv::Rect> &DataLoader::detectFrame(Detection &detection) {
+    std::vector<cv::Rect2d> tracked;
+    if (roiDetection_ || motionGated_)
+        tracked = tracker_.getTrackedBoxes();
+    // New people show up in the changed blocks first
+    if (motionGated_) {
+        std::vector<cv::Rect2d> changed = gate_.getChangedRegions();
+        tracked.insert(tracked.end(), changed.begin(), changed.end());
+    }
+    size_t passes = regionPasses_ + fullFramePasses_;
+    if (tracked.empty() || passes % fullFrameEvery_ == 0) {
+        fullFramePasses_++;
+        return tiled_ ? detection.processTiles() :
+        detection.processFrameforHuman();
+    }
+    regionPasses_++;
+    return detection.processRegions(
+    Detection::regionsOfInterest(tracked, frame_.size()));
+}
+
+/**
+ * @brief Decides whether a frame gets a detection pass
+ */
+bool DataLoader::detectionDue(int frameNumber, const cv::Mat &frame) {
+    if (!adaptive_)
+        return frameNumber % 45 == 0;
+    return policy_.shouldDetect(frame,
+    static_cast<int>(tracker_.getTrackTable().size()),
+    tracker_.getLostCount());
+}
+
 /**
  * @brief: Updates the isVideo and isImage value and sets the imagePath and videoPath.
  */
@@ -74,6 +227,10 @@ int DataLoader::checkParser(cv::CommandLineParser parser) {
  * @brief: Processes the video and updates the video frames with bounding boxes.
  */
 void DataLoader::processInput(cv::CommandLineParser parser) {
+    if (headless_) {
+        processHeadless();
+        return;
+    }
     // Open a video file or an image file or a camera stream.
     cv::VideoCapture capture;
     cv::VideoWriter video;
@@ -137,37 +294,114 @@ void DataLoader::processInput(cv::CommandLineParser parser) {
 //     cv::namedWindow(kWinName, cv::WINDOW_NORMAL);
     int frameNumber = 1;
 
-    tracker.initializeTracker();
+    Detection &detection = sharedDetection();
+    if (detection.getWarmUpTime() == 0)
+        detection.warmUp();
+    if (pipelined_ || realtime_) {
+        Pipeline pipeline(detection, tracker_);
+        if (adaptive_)
+            pipeline.setDetectionPolicy(&policy_);
+        bool isImage = parser.has("image");
+        bool isVideo = parser.has("video");
+        auto sink = [&](const cv::Mat &finalFrame) {
+            ScopedTimer timer(Stage::ENCODE);
+            if (isImage)
+                cv::imwrite(outputFile, finalFrame);
+            else if (isVideo)
+                video.write(finalFrame);
+        };
+        if (realtime_) {
+            pipeline.runRealtime(capture, sink, latencyBudgetMs_);
+            pipeline.printRealtimeStats();
+        } else {
+            pipeline.run(capture, sink);
+            pipeline.printStats();
+        }
+        if (adaptive_)
+            policy_.printStats();
+        std::cout << "Output file is stored as " << outputFile << std::endl;
+        capture.release();
+        if (isVideo)
+            video.release();
+        return;
+    }
+    tracker_.initializeTracker();
+    regionPasses_ = 0;
+    fullFramePasses_ = 0;
+    if (tiled_) {
+        detection.setTiling(tileSize_, tileOverlap_);
+        detection.setTileBatchSize(tileBatch_);
+    }
     std::vector<cv::Rect> detections;
     std::vector<float> confidenceDetection;
+    const double cpuStartMs = cpuTimeMs();
+    auto wallStart = std::chrono::steady_clock::now();
+    trackConfidences_.clear();
+    std::vector<TrackResult> results;
     while (cv::waitKey(1) < 0) {
         // perform analysis
-        capture >> frame_;
+        {
+            ScopedTimer timer(Stage::DECODE);
+            capture >> frame_;
+        }
         frameNumber++;
         if (frame_.empty()) {
             std::cout << "Output file is stored as " << outputFile << std::endl;
+            if (adaptive_)
+                policy_.printStats();
+            if (roiDetection_)
+                std::cout << "ROI detection: " << regionPasses_
+                << " region passes, " << fullFramePasses_
+                << " full-frame passes" << std::endl;
+            if (tiled_)
+                std::cout << "Tiled detection: " << detection.getTilesRun()
+                << " tiles run, " << detection.getTilesSkipped()
+                << " unchanged tiles skipped" << std::endl;
+            if (motionGated_)
+                gate_.printStats();
+            printCpuTime(cpuStartMs, elapsedMs(wallStart), frameNumber - 2);
             cv::waitKey(3000);
             break;
         }
         detection.setFrame(frame_);
-        tracker.setFrame(frame_);
-        if (frameNumber % 45 == 0) {
+        tracker_.setFrame(frame_);
+        if (motionGated_)
+            gate_.update(frame_);
+        if (detectionDue(frameNumber, frame_) &&
+        (!motionGated_ || gate_.allowDetection())) {
             detections.clear();
+            auto detectionStart = std::chrono::steady_clock::now();
             detection.setFrame(frame_);
-            detections = detection.processFrameforHuman();
-            tracker.setFrame(frame_);
-            tracker.runTrackerAlgorithm(detections);
+            detections = detectFrame(detection);
+            policy_.recordDetection(elapsedMs(detectionStart));
+            gate_.recordDetection(elapsedMs(detectionStart));
+            tracker_.setFrame(frame_);
+            tracker_.runTrackerAlgorithm(detections);
+            if (publisher_) {
+                collectTracks(detection, true, results);
+                publisher_->publish(frameNumber - 2, results);
+            }
             // write frame to video
         } else {
-            tracker.updateTracker();
+            if (!motionGated_ || gate_.allowTrackerUpdate()) {
+                auto updateStart = std::chrono::steady_clock::now();
+                tracker_.updateTracker();
+                gate_.recordTrackerUpdate(elapsedMs(updateStart));
+            }
+            if (publisher_) {
+                collectTracks(detection, false, results);
+                publisher_->publish(frameNumber - 2, results);
+            }
         }
-        frame_ = tracker.drawGreenBoundingBox();
-        cv::Mat finalFrame;
-        frame_.convertTo(finalFrame, CV_8U);
+        frame_ = tracker_.drawGreenBoundingBox();
+        // Decoded frames are 8-bit already, converting them would only copy
+        if (frame_.depth() != CV_8U)
+            frame_.convertTo(frame_, CV_8U);
+        ScopedTimer encodeTimer(Stage::ENCODE);
         if (parser.has("image")) {
-            cv::imwrite(outputFile, finalFrame);
+            cv::imwrite(outputFile, frame_);
         } else if (parser.has("video")) {
-            video.write(finalFrame);
+            video.write(frame_);
         }
 //         cv::imshow(kWinName, frame_);
     }
@@ -175,3 +409,243 @@ void DataLoader::processInput(cv::CommandLineParser parser) {
     if (parser.has("video"))
         video.release();
 }
+
+/**
+ * @brief Gathers ID, box, confidence and pose of the current tracks
+ */
+void DataLoader::collectTracks(Detection &detection, bool detected,
+std::vector<TrackResult> &results) {
+    const TrackTable &table = tracker_.getTrackTable();
+    TrackView tracks = table.view();
+    std::vector<cv::Rect> found;
+    std::vector<float> scores;
+    if (detected) {
+        found = detection.getDetections();
+        scores = detection.getConfidence();
+    }
+    // Tracks keep the confidence of the detection they last matched
+    results.resize(tracks.count);
+    for (size_t i = 0; i < tracks.count; ++i) {
+        int slot = tracks.slots[i];
+        int id = tracks.id[slot];
+        cv::Rect2d box = table.getBox(slot);
+        double best = 0.3;
+        for (size_t j = 0; j < found.size() && j < scores.size(); ++j) {
+            double overlap = Track::iou(box, found[j]);
+            if (overlap >= best) {
+                best = overlap;
+                trackConfidences_[id] = scores[j];
+            }
+        }
+        results[i].id = id;
+        results[i].box = box;
+        results[i].confidence = trackConfidences_[id];
+        results[i].pose = cv::Point2f(tracks.poseX[slot], tracks.poseY[slot]);
+    }
+}
+
+/**
+ * @brief Publishes the tracks of every frame to a shared memory ring
+ */
+bool DataLoader::setShmPublisher(bool enabled, const std::string &name,
+uint32_t capacity) {
+    publisher_.reset();
+    if (!enabled)
+        return true;
+    publisher_ = std::make_shared<ShmRingPublisher>();
+    if (publisher_->create(name, capacity))
+        return true;
+    std::cout << "Could not create the shared memory ring " << name
+    << std::endl;
+    publisher_.reset();
+    return false;
+}
+
+/**
+ * @brief Runs detection and tracking without drawing, display or encoding
+ */
+void DataLoader::processHeadless() {
+    cv::VideoCapture capture(path_);
+    if (!capture.isOpened()) {
+        std::cout << "Could not open the input image/video stream" << std::endl;
+        return;
+    }
+    ResultWriter writer;
+    if (!writer.open(headlessOutput_)) {
+        std::cout << "Could not write " << headlessOutput_ << std::endl;
+        return;
+    }
+    Detection &detection = sharedDetection();
+    if (detection.getWarmUpTime() == 0)
+        detection.warmUp();
+    detection.setDrawBoxes(false);
+    if (tiled_) {
+        detection.setTiling(tileSize_, tileOverlap_);
+        detection.setTileBatchSize(tileBatch_);
+    }
+    tracker_.initializeTracker();
+
+    trackConfidences_.clear();
+    std::vector<TrackResult> results;
+    const double cpuStartMs = cpuTimeMs();
+    auto wallStart = std::chrono::steady_clock::now();
+    int frameNumber = 1;
+    int frames = 0;
+    while (capture.read(frame_)) {
+        frameNumber++;
+        double timestampMs = capture.get(cv::CAP_PROP_POS_MSEC);
+        tracker_.setFrame(frame_);
+        if (motionGated_)
+            gate_.update(frame_);
+        bool detected = false;
+        if (detectionDue(frameNumber, frame_) &&
+        (!motionGated_ || gate_.allowDetection())) {
+            auto detectionStart = std::chrono::steady_clock::now();
+            detection.setFrame(frame_);
+            const std::vector<cv::Rect> &boxes = detectFrame(detection);
+            policy_.recordDetection(elapsedMs(detectionStart));
+            gate_.recordDetection(elapsedMs(detectionStart));
+            tracker_.runTrackerAlgorithm(boxes);
+            detected = true;
+        } else if (!motionGated_ || gate_.allowTrackerUpdate()) {
+            auto updateStart = std::chrono::steady_clock::now();
+            tracker_.updateTracker();
+            gate_.recordTrackerUpdate(elapsedMs(updateStart));
+        }
+
+        collectTracks(detection, detected, results);
+        if (publisher_)
+            publisher_->publish(frameNumber - 2, results);
+        writer.writeFrame(frameNumber - 2, timestampMs, results);
+        frames++;
+    }
+    writer.close();
+    capture.release();
+    printCpuTime(cpuStartMs, elapsedMs(wallStart), frames);
+}
+
+/**
+ * @brief Processes one of several concurrent streams through the shared scheduler
+ */
+void DataLoader::processStream(InferenceScheduler &scheduler, int streamId) {
+    streamStats_ = StreamStats();
+    streamStats_.input = path_;
+    cv::VideoCapture capture;
+    cv::VideoWriter video;
+    bool isCamera = !path_.empty() &&
+    std::all_of(path_.begin(), path_.end(), ::isdigit);
+    if (isCamera) {
+        capture.open(std::stoi(path_));
+        outputFile = "camera" + path_ + "_YOLOv4_output_cpp.avi";
+    } else {
+        capture.open(path_);
+        outputFile = path_.substr(0, path_.find_last_of('.')) +
+        "_YOLOv4_output_cpp.avi";
+    }
+    if (!capture.isOpened()) {
+        std::cout << "Could not open the input stream " << path_ << std::endl;
+        return;
+    }
+    video.open(outputFile, cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), 28,
+    cv::Size(capture.get(cv::CAP_PROP_FRAME_WIDTH),
+    capture.get(cv::CAP_PROP_FRAME_HEIGHT)));
+
+    auto start = std::chrono::steady_clock::now();
+    tracker_.initializeTracker();
+    int frameNumber = 1;
+    cv::Mat frame;
+    while (true) {
+        {
+            ScopedTimer timer(Stage::DECODE);
+            capture >> frame;
+        }
+        frameNumber++;
+        if (frame.empty())
+            break;
+        auto frameStart = std::chrono::steady_clock::now();
+        tracker_.setFrame(frame);
+        if (detectionDue(frameNumber, frame)) {
+            InferenceResult result = scheduler.submit(streamId, frame).get();
+            policy_.recordDetection(elapsedMs(frameStart));
+            streamStats_.detectionSumMs += elapsedMs(frameStart);
+            streamStats_.detections++;
+            tracker_.runTrackerAlgorithm(result.detections);
+        } else {
+            tracker_.updateTracker();
+        }
+        frame = tracker_.drawGreenBoundingBox();
+        if (frame.depth() != CV_8U)
+            frame.convertTo(frame, CV_8U);
+        {
+            ScopedTimer timer(Stage::ENCODE);
+            video.write(frame);
+        }
+        double latencyMs = elapsedMs(frameStart);
+        streamStats_.latencySumMs += latencyMs;
+        streamStats_.maxLatencyMs = std::max(streamStats_.maxLatencyMs,
+        latencyMs);
+        streamStats_.frames++;
+    }
+    streamStats_.wallMs = elapsedMs(start);
+    capture.release();
+    video.release();
+    std::cout << "Output file is stored as " << outputFile << std::endl;
+}
+
+/**
+ * @brief Gets the counters of the last processStream call
+ */
+StreamStats DataLoader::getStreamStats() {
+    return streamStats_;
+}
+
+/**
+ * @brief Processes several streams concurrently with one shared network
+ */
+void DataLoader::processStreams(const std::vector<std::string> &inputs,
+TrackerMode mode, bool adaptive) {
+    Detection &detection = sharedDetection();
+    if (detection.getWarmUpTime() == 0)
+        detection.warmUp();
+    InferenceScheduler scheduler(detection, static_cast<int>(inputs.size()));
+    std::vector<DataLoader> loaders;
+    for (const auto &input : inputs) {
+        loaders.emplace_back(input, "video");
+        loaders.back().setTrackerMode(mode);
+        loaders.back().setAdaptiveDetection(adaptive);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> streams;
+    for (size_t i = 0; i < loaders.size(); ++i)
+        streams.emplace_back(&DataLoader::processStream, &loaders[i],
+        std::ref(scheduler), static_cast<int>(i));
+    for (auto &stream : streams)
+        stream.join();
+    scheduler.stop();
+    double wallMs = elapsedMs(start);
+
+    size_t totalFrames = 0;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Stream                    frames     fps   avg ms   max ms"
+    "   detections   avg detect ms" << std::endl;
+    for (auto &loader : loaders) {
+        StreamStats stats = loader.getStreamStats();
+        totalFrames += stats.frames;
+        double fps = stats.wallMs > 0 ? stats.frames * 1000.0 / stats.wallMs
+        : 0;
+        double avgMs = stats.frames ? stats.latencySumMs / stats.frames : 0;
+        double avgDetectMs = stats.detections ?
+        stats.detectionSumMs / stats.detections : 0;
+        std::cout << std::left << std::setw(24) << stats.input << std::right
+        << std::setw(8) << stats.frames << std::setw(8) << fps
+        << std::setw(9) << avgMs << std::setw(9) << stats.maxLatencyMs
+        << std::setw(13) << stats.detections << std::setw(16) << avgDetectMs
+        << std::endl;
+    }
+    std::cout << "Total " << totalFrames << " frames at "
+    << (wallMs > 0 ? totalFrames * 1000.0 / wallMs : 0) << " fps, "
+    << scheduler.getFrameCount() << " detections in "
+    << scheduler.getBatchCount() << " batches" << std::endl;
+    std::cout << std::defaultfloat;
+}
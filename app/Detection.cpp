@@ -10,7 +10,80 @@
  * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
  * 
  */
+#include <opencv2/core/hal/intrin.hpp>
 #include "../include/Detection.h"
+#include "../include/ModelBundle.h"
+#include "../include/Profiler.h"
+
+namespace {
+/** @brief Bundle of full YOLOv4 written by model-bundle, preferred over the cfg and weights */
+const char kDefaultBundle[] = "../yolov4.bundle";
+
+/**
+ * @brief Converts a normalized YOLO center/size row to a box in frame pixels
+ */
+cv::Rect rowToBox(const float *row, const cv::Size &frameSize) {
+  int centerX = static_cast<int>(row[0] * frameSize.width);
+  int centerY = static_cast<int>(row[1] * frameSize.height);
+  int width = static_cast<int>(row[2] * frameSize.width);
+  int height = static_cast<int>(row[3] * frameSize.height);
+  int left = centerX - width / 2;
+  int top = centerY - height / 2;
+  return cv::Rect(left, top, width, height);
+}
+
+/**
+ * @brief Checks that no class scores higher than the person class, with ties
+ *        going to the lower class index like minMaxLoc
+ */
+bool personIsBestClass(const float *scores, int numClasses,
+int personClassId) {
+  const float personScore = scores[personClassId];
+  for (int c = 0; c < personClassId; ++c)
+    if (scores[c] >= personScore)
+      return false;
+  for (int c = personClassId + 1; c < numClasses; ++c)
+    if (scores[c] > personScore)
+      return false;
+  return true;
+}
+
+/**
+ * @brief Grows a region to a square around its center, each side capped at the
+ *        frame, and shifts it inside the frame
+ */
+cv::Rect squareInside(const cv::Rect &rect, const cv::Size &frameSize) {
+  int side = std::max(rect.width, rect.height);
+  int width = std::min(side, frameSize.width);
+  int height = std::min(side, frameSize.height);
+  int x = rect.x + rect.width / 2 - width / 2;
+  int y = rect.y + rect.height / 2 - height / 2;
+  x = std::max(0, std::min(x, frameSize.width - width));
+  y = std::max(0, std::min(y, frameSize.height - height));
+  return cv::Rect(x, y, width, height);
+}
+
+/** @brief Side of the gray copy a tile is compared on */
+const int kTileThumbnail = 32;
+
+/** @brief Skipped passes after which a tile runs again anyway */
+const int kMaxTileAge = 8;
+
+/**
+ * @brief Start offsets of tiles along one axis, the last one aligned with the end
+ */
+std::vector<int> tileStarts(int length, int tile, int stride) {
+  std::vector<int> starts;
+  if (length <= tile) {
+    starts.push_back(0);
+    return starts;
+  }
+  for (int start = 0; start + tile < length; start += stride)
+    starts.push_back(start);
+  starts.push_back(length - tile);
+  return starts;
+}
+}  // namespace
 
 /**
  * @brief Detection constructor.
@@ -20,6 +93,9 @@ Detection::Detection() {
   nmsThreshold_ = 0.4;
   inpWidth_ = 416;
   inpHeight_ = 416;
+  modelClassFile_ = "../coco.names";
+  if (loadModelBundle(kDefaultBundle))
+    return;
   loadModelandLabelClasses("../yolov4.weights",
    "../yolov4.cfg", "../coco.names");
 }
@@ -55,38 +131,574 @@ modelConfigFile, const std::string modelClassFile) {
   modelClassFile_ = modelClassFile;
   modelConfigFile_ = modelConfigFile;
   modelWeightsFile_ = modelWeightsFile;
+
+  auto start = std::chrono::steady_clock::now();
+  warmUpTimeMs_ = 0;
+  classes.clear();
+  outNames_.clear();
+  std::ifstream ifs(modelClassFile_.c_str());
+  std::string line;
+  while (getline(ifs, line))
+    classes.push_back(line);
+  auto person = std::find(classes.begin(), classes.end(), "person");
+  personClassId_ = person == classes.end() ? -1 :
+  static_cast<int>(person - classes.begin());
+  try {
+    const std::string onnx = ".onnx";
+    bool isOnnx = modelWeightsFile_.size() > onnx.size() &&
+    modelWeightsFile_.compare(modelWeightsFile_.size() - onnx.size(),
+    onnx.size(), onnx) == 0;
+    // ONNX exports keep their weights, FP16 and INT8 included, in one file
+    net_ = isOnnx ? cv::dnn::readNetFromONNX(modelWeightsFile_) :
+    cv::dnn::readNetFromDarknet(modelConfigFile_, modelWeightsFile_);
+    net_.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+    net_.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+    outNames_ = getOutputsNames(net_);
+  }
+  catch (...) {
+    net_ = cv::dnn::Net();
+    std::cout << "Could not load the model files" << std::endl;
+    return;
+  }
+  loadTimeMs_ = std::chrono::duration<double, std::milli>
+  (std::chrono::steady_clock::now() - start).count();
+  std::cout << "Model loaded in " << loadTimeMs_ << " ms" << std::endl;
 }
 
 /**
- * @brief Sets current frame
+ * @brief Builds the network from a model bundle
  */
-void Detection::setFrame(cv::Mat frame) {
-  frame_ = frame;
+bool Detection::loadModelBundle(const std::string &bundleFile) {
+  auto start = std::chrono::steady_clock::now();
+  ModelBundle bundle;
+  if (!bundle.open(bundleFile))
+    return false;
+  cv::dnn::Net net;
+  try {
+    net = cv::dnn::readNetFromDarknet(bundle.getConfig(),
+    bundle.getConfigSize(), bundle.getWeights(), bundle.getWeightsSize());
+    net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+    net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+  }
+  catch (...) {
+    std::cout << "Could not build the network from " << bundleFile
+    << std::endl;
+    return false;
+  }
+  net_ = net;
+  modelWeightsFile_ = bundleFile;
+  modelConfigFile_.clear();
+  warmUpTimeMs_ = 0;
+  outNames_.clear();
+  for (const auto &name : bundle.getOutputNames())
+    outNames_.push_back(name);
+  classes = bundle.getLabels();
+  auto person = std::find(classes.begin(), classes.end(), "person");
+  personClassId_ = person == classes.end() ? -1 :
+  static_cast<int>(person - classes.begin());
+  loadTimeMs_ = std::chrono::duration<double, std::milli>
+  (std::chrono::steady_clock::now() - start).count();
+  std::cout << "Model bundle loaded in " << loadTimeMs_ << " ms" << std::endl;
+  return true;
 }
+
 /**
- * @brief RUns YOLOv4 algo and detects humans and returns detections
+ * @brief Sets the launch time of the process
  */
-std::vector<cv::Rect> Detection::processFrameforHuman() {
-  std::ifstream ifs(modelClassFile_.c_str());
-  std::string line;
-  while (getline(ifs, line))
-    classes.push_back(line);
-  cv::dnn::Net net =
-  cv::dnn::readNetFromDarknet(modelConfigFile_, modelWeightsFile_);
-  net.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
-  net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+void Detection::setLaunchTime(
+std::chrono::steady_clock::time_point launchTime) {
+  launchTime_ = launchTime;
+  reportStartup_ = true;
+  startupMs_ = 0;
+}
 
+/**
+ * @brief Gets the time from launch to the first detection
+ */
+double Detection::getStartupTime() {
+  return startupMs_;
+}
+
+/**
+ * @brief Records and prints the time from launch to the first detection
+ */
+void Detection::reportStartup() {
+  if (!reportStartup_)
+    return;
+  reportStartup_ = false;
+  startupMs_ = std::chrono::duration<double, std::milli>
+  (std::chrono::steady_clock::now() - launchTime_).count();
+  std::cout << "First detection " << startupMs_ << " ms after launch"
+  << std::endl;
+}
+
+/**
+ * @brief Runs one forward pass on a blank input to warm up the network
+ */
+void Detection::warmUp() {
+  if (net_.empty())
+    return;
+  auto start = std::chrono::steady_clock::now();
+  cv::Mat blank(cv::Size(inpWidth_, inpHeight_), CV_8UC3, cv::Scalar(0, 0, 0));
   cv::Mat blob;
-  cv::dnn::blobFromImage(frame_, blob, 1 / 255.0,
+  cv::dnn::blobFromImage(blank, blob, 1 / 255.0,
     cv::Size(inpWidth_, inpHeight_), cv::Scalar(0, 0, 0), true, false);
-  net.setInput(blob);
+  net_.setInput(blob);
   std::vector<cv::Mat> outs;
-  net.forward(outs, getOutputsNames(net));
+  net_.forward(outs, outNames_);
+  warmUpTimeMs_ = std::chrono::duration<double, std::milli>
+  (std::chrono::steady_clock::now() - start).count();
+  std::cout << "Model warmed up in " << warmUpTimeMs_ << " ms" << std::endl;
+}
+
+/**
+ * @brief Checks whether the network was loaded successfully
+ */
+bool Detection::isModelLoaded() {
+  return !net_.empty();
+}
+
+/**
+ * @brief Gets the time taken by the last model load
+ */
+double Detection::getLoadTime() {
+  return loadTimeMs_;
+}
+
+/**
+ * @brief Gets the time taken by the last warm-up pass
+ */
+double Detection::getWarmUpTime() {
+  return warmUpTimeMs_;
+}
+
+/**
+ * @brief Selects the person-only or the full-class decoder
+ */
+void Detection::setPersonOnlyDecoding(bool personOnly) {
+  personOnly_ = personOnly;
+}
+
+/**
+ * @brief Loads the model of a profile and sets its network input size
+ */
+void Detection::setModelProfile(ModelProfile profile) {
+  ModelProfileSpec spec = ModelProfiles::spec(profile);
+  inpWidth_ = static_cast<float>(spec.inputSize.width);
+  inpHeight_ = static_cast<float>(spec.inputSize.height);
+  // Both darknet YOLOv4 profiles run the same network, which the bundle holds
+  if (spec.weightsFile == "../yolov4.weights" &&
+  loadModelBundle(kDefaultBundle))
+    return;
+  loadModelandLabelClasses(spec.weightsFile, spec.configFile,
+  modelClassFile_);
+}
+
+/**
+ * @brief Gets the network input size
+ */
+cv::Size Detection::getInputSize() {
+  return cv::Size(static_cast<int>(inpWidth_), static_cast<int>(inpHeight_));
+}
+
+/**
+ * @brief Selects whether kept detections are drawn on the frame
+ */
+void Detection::setDrawBoxes(bool drawBoxes) {
+  drawBoxes_ = drawBoxes;
+}
+
+/**
+ * @brief Selects the letterboxed or the stretched network input
+ */
+void Detection::setLetterbox(bool letterbox) {
+  letterbox_ = letterbox;
+}
+
+/**
+ * @brief Sets the number of threads of the fused kernel
+ */
+void Detection::setPreprocessThreads(int numThreads) {
+  preprocessor_.setNumThreads(numThreads);
+}
+
+/**
+ * @brief Sets the suppression method and the cap on detections per frame
+ */
+void Detection::setNmsOptions(const NmsOptions &options) {
+  nms_.setOptions(options);
+}
+
+/**
+ * @brief Sets current frame
+ */
+void Detection::setFrame(const cv::Mat &frame) {
+  frame_ = frame;
+}
+
+/**
+ * @brief Turns a frame into the network input, reusing the blob
+ */
+const cv::Mat &Detection::preprocess(const cv::Mat &frame) {
+  ScopedTimer timer(Stage::PREPROCESS);
+  const cv::Size size(static_cast<int>(inpWidth_),
+  static_cast<int>(inpHeight_));
+  const int shape[] = {1, 3, size.height, size.width};
+  if (letterbox_ && frame.type() == CV_8UC3) {
+    blob_.create(4, shape, CV_32F);
+    preprocessor_.setInputSize(size);
+    letterboxInfo_ = preprocessor_.run(frame, blob_.ptr<float>());
+    return blob_;
+  }
+  letterboxInfo_.active = false;
+  // Same steps as blobFromImage with swapRB, but every buffer is kept, so
+  // frames of the same size allocate nothing
+  cv::resize(frame, resized_, size);
+  resized_.convertTo(scaled_, CV_32F, 1 / 255.0);
+  blob_.create(4, shape, CV_32F);
+  // split writes B, G, R, the blob planes are in R, G, B order
+  for (int c = 0; c < 3; ++c)
+    planes_[2 - c] = cv::Mat(size, CV_32F, blob_.ptr<float>(0, c));
+  cv::split(scaled_, planes_);
+  return blob_;
+}
+
+/**
+ * @brief RUns YOLOv4 algo and detects humans and returns detections
+ */
+const std::vector<cv::Rect> &Detection::processFrameforHuman() {
+  if (net_.empty()) {
+    detections.clear();
+    confidenceDetection.clear();
+    return detections;
+  }
+  net_.setInput(preprocess(frame_));
+  {
+    ScopedTimer timer(Stage::FORWARD);
+    net_.forward(outs_, outNames_);
+  }
+
+  postProcess(outs_);
+  reportStartup();
 
-  detections = postProcess(outs);
+  return detections;
+}
+/**
+ * @brief Post-processes recorded network outputs for the current frame
+ */
+const std::vector<cv::Rect> &Detection::processOutputs(
+const std::vector<cv::Mat> &outs) {
+  letterboxInfo_.active = false;
+  return postProcess(outs);
+}
+
+/**
+ * @brief Runs YOLOv4 on several frames with one forward pass per chunk
+ */
+void Detection::processBatch(const std::vector<cv::Mat> &frames,
+std::vector<std::vector<cv::Rect>> &batchDetections,
+std::vector<std::vector<float>> &batchConfidences, cv::Size inputSize,
+int batchSize) {
+  if (inputSize.area() <= 0)
+    inputSize = cv::Size(inpWidth_, inpHeight_);
+  batchDetections.assign(frames.size(), std::vector<cv::Rect>());
+  batchConfidences.assign(frames.size(), std::vector<float>());
+  if (net_.empty())
+    return;
+  const size_t chunkSize = batchSize > 0 ? batchSize : batchSize_;
+  for (size_t first = 0; first < frames.size(); first += chunkSize) {
+    size_t last = std::min(frames.size(), first + chunkSize);
+    std::vector<cv::Mat> chunk(frames.begin() + first, frames.begin() + last);
+    const int n = static_cast<int>(chunk.size());
+    std::vector<LetterboxInfo> placements(n);
+
+    {
+      ScopedTimer timer(Stage::PREPROCESS);
+      bool letterbox = letterbox_;
+      for (const auto &frame : chunk)
+        letterbox = letterbox && frame.type() == CV_8UC3;
+      if (letterbox) {
+        // Every frame is letterboxed into its own plane of the blob
+        const int shape[] = {n, 3, inputSize.height, inputSize.width};
+        blob_.create(4, shape, CV_32F);
+        preprocessor_.setInputSize(inputSize);
+        for (int k = 0; k < n; ++k)
+          placements[k] = preprocessor_.run(chunk[k], blob_.ptr<float>(k));
+      } else {
+        cv::dnn::blobFromImages(chunk, blob_, 1 / 255.0,
+          inputSize, cv::Scalar(0, 0, 0), true, false);
+      }
+    }
+    net_.setInput(blob_);
+    {
+      ScopedTimer timer(Stage::FORWARD);
+      net_.forward(outs_, outNames_);
+    }
+
+    for (int k = 0; k < n; ++k) {
+      // Split every output layer back into the rows of frame k. Batched
+      // outputs are either 3D (N x rows x cols) or N stacked 2D blocks.
+      std::vector<cv::Mat> frameOuts;
+      for (const auto &out : outs_) {
+        if (out.dims == 3) {
+          frameOuts.push_back(cv::Mat(out.size[1], out.size[2], CV_32F,
+          const_cast<float *>(out.ptr<float>(k))));
+        } else {
+          int rows = out.rows / n;
+          frameOuts.push_back(out.rowRange(k * rows, (k + 1) * rows));
+        }
+      }
+      // Boxes are normalized, so postProcess scales them to frame k and
+      // takes out its letterbox
+      frame_ = chunk[k];
+      letterboxInfo_ = placements[k];
+      batchDetections[first + k] = postProcess(frameOuts);
+      batchConfidences[first + k] = confidenceDetection;
+    }
+  }
+  detections = batchDetections.empty() ? std::vector<cv::Rect>() :
+  batchDetections.back();
+  reportStartup();
+}
+
+/**
+ * @brief Expands, squares and merges tracked boxes into regions of interest
+ */
+std::vector<cv::Rect> Detection::regionsOfInterest(
+const std::vector<cv::Rect2d> &boxes, cv::Size frameSize, double margin) {
+  std::vector<cv::Rect> regions;
+  for (const auto &box : boxes) {
+    if (box.width <= 0 || box.height <= 0)
+      continue;
+    double pad = margin * std::max(box.width, box.height);
+    cv::Rect region(cvRound(box.x - pad), cvRound(box.y - pad),
+    cvRound(box.width + 2 * pad), cvRound(box.height + 2 * pad));
+    region &= cv::Rect(0, 0, frameSize.width, frameSize.height);
+    if (region.area() > 0)
+      regions.push_back(squareInside(region, frameSize));
+  }
+  // A merged region may overlap others again, repeat until none overlap
+  bool merged = true;
+  while (merged) {
+    merged = false;
+    for (size_t i = 0; i < regions.size() && !merged; ++i) {
+      for (size_t j = i + 1; j < regions.size() && !merged; ++j) {
+        if ((regions[i] & regions[j]).area() > 0) {
+          regions[i] = squareInside(regions[i] | regions[j], frameSize);
+          regions.erase(regions.begin() + j);
+          merged = true;
+        }
+      }
+    }
+  }
+  return regions;
+}
 
+/**
+ * @brief Runs YOLOv4 on crops of the current frame as one batch
+ */
+const std::vector<cv::Rect> &Detection::processRegions(
+const std::vector<cv::Rect> &regions) {
+  std::vector<cv::Rect> crops;
+  int side = 0;
+  for (const auto &region : regions) {
+    cv::Rect crop = region & cv::Rect(0, 0, frame_.cols, frame_.rows);
+    if (crop.area() <= 0)
+      continue;
+    crops.push_back(crop);
+    side = std::max(side, std::max(crop.width, crop.height));
+  }
+  detections.clear();
+  confidenceDetection.clear();
+  if (crops.empty() || net_.empty())
+    return detections;
+  // Small crops run at a smaller input, the cost of a forward pass
+  // grows with its input area
+  const int fullSide = static_cast<int>(inpWidth_);
+  int inputSide = std::min(fullSide, std::max(64, (side + 31) / 32 * 32));
+  if (crops.size() * inputSide * inputSide >= inpWidth_ * inpHeight_)
+    return processFrameforHuman();
+
+  // The crops are views, so the boxes drawn on them land on the frame
+  cv::Mat frame = frame_;
+  std::vector<cv::Mat> views;
+  for (const auto &crop : crops)
+    views.push_back(frame(crop));
+  std::vector<std::vector<cv::Rect>> cropDetections;
+  std::vector<std::vector<float>> cropConfidences;
+  processBatch(views, cropDetections, cropConfidences,
+  cv::Size(inputSide, inputSide));
+  frame_ = frame;
+
+  // processBatch left the last crop's results in the members
+  detections.clear();
+  confidenceDetection.clear();
+  for (size_t i = 0; i < crops.size(); ++i) {
+    for (size_t j = 0; j < cropDetections[i].size(); ++j) {
+      detections.push_back(cropDetections[i][j] + crops[i].tl());
+      confidenceDetection.push_back(cropConfidences[i][j]);
+    }
+  }
   return detections;
 }
+
+/**
+ * @brief Sets the tiles of processTiles
+ */
+void Detection::setTiling(int tileSize, double overlap,
+double changeThreshold) {
+  tileSize_ = std::max(32, (tileSize + 31) / 32 * 32);
+  tileOverlap_ = std::min(0.9, std::max(0.0, overlap));
+  tileChangeThreshold_ = changeThreshold;
+  tileCache_.clear();
+}
+
+/**
+ * @brief Sets the maximum number of tiles per forward pass
+ */
+void Detection::setTileBatchSize(int batchSize) {
+  tileBatchSize_ = std::max(0, batchSize);
+}
+
+/**
+ * @brief Splits a frame into overlapping tiles that cover it
+ */
+std::vector<cv::Rect> Detection::tileGrid(cv::Size frameSize, int tileSize,
+double overlap) {
+  std::vector<cv::Rect> tiles;
+  if (frameSize.area() <= 0 || tileSize <= 0)
+    return tiles;
+  int stride = std::max(1, static_cast<int>(tileSize * (1 - overlap)));
+  std::vector<int> xs = tileStarts(frameSize.width, tileSize, stride);
+  std::vector<int> ys = tileStarts(frameSize.height, tileSize, stride);
+  for (int y : ys)
+    for (int x : xs)
+      tiles.emplace_back(x, y, std::min(tileSize, frameSize.width),
+      std::min(tileSize, frameSize.height));
+  return tiles;
+}
+
+/**
+ * @brief Runs YOLOv4 on the changed tiles of the current frame and merges all tiles
+ */
+const std::vector<cv::Rect> &Detection::processTiles() {
+  detections.clear();
+  confidenceDetection.clear();
+  if (net_.empty() || frame_.empty())
+    return detections;
+  std::vector<cv::Rect> grid = tileGrid(frame_.size(), tileSize_,
+  tileOverlap_);
+  if (tileCache_.size() != grid.size())
+    tileCache_.assign(grid.size(), TileCache());
+
+  cv::Mat gray;
+  if (frame_.channels() == 3)
+    cv::cvtColor(frame_, gray, cv::COLOR_BGR2GRAY);
+  else
+    gray = frame_;
+  cv::Mat frame = frame_;
+  std::vector<size_t> changed;
+  std::vector<cv::Mat> views;
+  for (size_t i = 0; i < grid.size(); ++i) {
+    TileCache &cache = tileCache_[i];
+    cv::Mat thumbnail;
+    cv::resize(gray(grid[i]), thumbnail,
+    cv::Size(kTileThumbnail, kTileThumbnail), 0, 0, cv::INTER_AREA);
+    bool stale = cache.tile != grid[i] || cache.thumbnail.empty() ||
+    cache.age >= kMaxTileAge;
+    if (!stale) {
+      cv::Mat diff;
+      cv::absdiff(thumbnail, cache.thumbnail, diff);
+      stale = cv::mean(diff)[0] > tileChangeThreshold_;
+    }
+    if (!stale) {
+      cache.age++;
+      tilesSkipped_++;
+      continue;
+    }
+    cache.tile = grid[i];
+    cache.thumbnail = thumbnail;
+    cache.age = 0;
+    changed.push_back(i);
+    views.push_back(frame(grid[i]));
+  }
+
+  // Tiles run at their own size, the boxes are drawn once after the
+  // NMS over all tiles
+  std::vector<std::vector<cv::Rect>> tileDetections;
+  std::vector<std::vector<float>> tileConfidences;
+  int side = std::max(grid.empty() ? 0 : grid[0].width,
+  grid.empty() ? 0 : grid[0].height);
+  const bool draw = drawBoxes_;
+  drawBoxes_ = false;
+  suppress_ = false;
+  int tileBatch = tileBatchSize_ > 0 ? tileBatchSize_ :
+  static_cast<int>(std::max<size_t>(1, views.size()));
+  processBatch(views, tileDetections, tileConfidences,
+  cv::Size((side + 31) / 32 * 32, (side + 31) / 32 * 32), tileBatch);
+  drawBoxes_ = draw;
+  suppress_ = true;
+  frame_ = frame;
+  tilesRun_ += changed.size();
+  for (size_t k = 0; k < changed.size(); ++k) {
+    TileCache &cache = tileCache_[changed[k]];
+    cache.boxes.clear();
+    for (const auto &box : tileDetections[k])
+      cache.boxes.push_back(box + cache.tile.tl());
+    cache.confidences = tileConfidences[k];
+  }
+
+  std::vector<cv::Rect> boxes;
+  std::vector<float> confidences;
+  for (const auto &cache : tileCache_) {
+    boxes.insert(boxes.end(), cache.boxes.begin(), cache.boxes.end());
+    confidences.insert(confidences.end(), cache.confidences.begin(),
+    cache.confidences.end());
+  }
+  std::vector<int> indices;
+  nms_.run(boxes, confidences, confThreshold_, nmsThreshold_, indices);
+  const std::vector<float> &keptScores = nms_.getKeptScores();
+  detections.clear();
+  confidenceDetection.clear();
+  for (size_t i = 0; i < indices.size(); ++i) {
+    const cv::Rect &box = boxes[indices[i]];
+    detections.push_back(box);
+    confidenceDetection.push_back(keptScores[i]);
+    if (drawBoxes_ && personClassId_ >= 0)
+      drawRedBoundingBox({box.x, box.y, box.x + box.width,
+      box.y + box.height}, personClassId_, keptScores[i]);
+  }
+  return detections;
+}
+
+/**
+ * @brief Gets the number of tiles run through the network so far
+ */
+size_t Detection::getTilesRun() {
+  return tilesRun_;
+}
+
+/**
+ * @brief Gets the number of unchanged tiles skipped so far
+ */
+size_t Detection::getTilesSkipped() {
+  return tilesSkipped_;
+}
+
+/**
+ * @brief Sets the maximum number of frames per forward pass
+ */
+void Detection::setBatchSize(int batchSize) {
+  batchSize_ = batchSize > 0 ? batchSize : 1;
+}
+
+/**
+ * @brief Gets the maximum number of frames per forward pass
+ */
+int Detection::getBatchSize() {
+  return batchSize_;
+}
+
 /**
  * @brief Draws a red bounding box over frame from the given coordinates
  */
@@ -117,78 +729,157 @@ int classID, float conf) {
  * @brief Gets correct detections and bounding boxes are reduced
  */
 
-std::vector<cv::Rect> Detection::postProcess(const std::vector<cv::Mat> &outs) {
-  std::vector<int> classIds;
-  std::vector<float> confidences;
-  std::vector<cv::Rect> boxes;
+const std::vector<cv::Rect> &Detection::postProcess(
+const std::vector<cv::Mat> &outs) {
+  ScopedTimer timer(Stage::POSTPROCESS);
+  classIds_.clear();
+  confidences_.clear();
+  boxes_.clear();
+  // Letterboxed boxes are decoded in network input pixels and mapped back
+  const cv::Size decodeSize = letterboxInfo_.active ? letterboxInfo_.input :
+  frame_.size();
 
   for (size_t i = 0; i < outs.size(); ++i) {
-    // Scan through all the bounding boxes output from the
-    // network and keep only the ones with high confidence
-    // scores. Assign the box's class label as the class
-    // with the highest score for the box.
-    float *data = reinterpret_cast<float *> (outs[i].data);
-    for (int j = 0; j < outs[i].rows; ++j, data += outs[i].cols) {
-      cv::Mat scores = outs[i].row(j).colRange(5, outs[i].cols);
-      cv::Point classIdPoint;
-      double confidence;
-      // Get the value and location of the maximum score
-      minMaxLoc(scores, 0, &confidence, 0, &classIdPoint);
-      if (confidence > confThreshold_) {
-        int centerX = static_cast<int>(data[0] * frame_.cols);
-        int centerY = static_cast<int>(data[1] * frame_.rows);
-        int width = static_cast<int>(data[2] * frame_.cols);
-        int height = static_cast<int>(data[3] * frame_.rows);
-        int left = centerX - width / 2;
-        int top = centerY - height / 2;
-
-        if (classes[classIdPoint.x] == "person") {
-          classIds.push_back(classIdPoint.x);
-          confidences.push_back(static_cast<float> (confidence));
-          boxes.push_back(cv::Rect(left, top, width, height));
-        }
+    if (personOnly_ && personClassId_ >= 0) {
+      decodePersonRows(outs[i], personClassId_, confThreshold_,
+      decodeSize, boxes_, confidences_);
+      classIds_.resize(boxes_.size(), personClassId_);
+      continue;
+    }
+    // General path, keep the persons out of all classes
+    std::vector<int> allIds;
+    std::vector<float> allConfidences;
+    std::vector<cv::Rect> allBoxes;
+    decodeAllClassRows(outs[i], confThreshold_, decodeSize, allIds,
+    allBoxes, allConfidences);
+    for (size_t j = 0; j < allIds.size(); ++j) {
+      if (allIds[j] == personClassId_) {
+        classIds_.push_back(allIds[j]);
+        confidences_.push_back(allConfidences[j]);
+        boxes_.push_back(allBoxes[j]);
       }
     }
   }
 
+  if (letterboxInfo_.active)
+    for (auto &box : boxes_)
+      box = Preprocessor::undo(box, letterboxInfo_);
+
+  detections.clear();
+  confidenceDetection.clear();
+  // processTiles suppresses once over the boxes of all tiles
+  if (!suppress_) {
+    detections = boxes_;
+    confidenceDetection = confidences_;
+    return detections;
+  }
   // Perform non maximum suppression to eliminate
   // redundant overlapping boxes with lower confidences
-  std::vector<int> indices;
-  cv::dnn::NMSBoxes
-  (boxes, confidences, confThreshold_, nmsThreshold_, indices);
-  for (size_t i = 0; i < indices.size(); ++i) {
-    int idx = indices[i];
-    cv::Rect box = boxes[idx];
+  nms_.run(boxes_, confidences_, confThreshold_, nmsThreshold_, indices_);
+  const std::vector<float> &keptScores = nms_.getKeptScores();
+  for (size_t i = 0; i < indices_.size(); ++i) {
+    int idx = indices_[i];
+    cv::Rect box = boxes_[idx];
+    detections.push_back(box);
+    confidenceDetection.push_back(keptScores[i]);
 
     std::vector<int> coordinates =
     {box.x, box.y, box.x + box.width, box.y + box.height};
 
-    if (classes[classIds[idx]] == "person")
-      drawRedBoundingBox(coordinates, classIds[idx], confidences[idx]);
+    if (drawBoxes_ && classIds_[idx] == personClassId_)
+      drawRedBoundingBox(coordinates, classIds_[idx], keptScores[i]);
+  }
+  return detections;
+}
+/**
+ * @brief Decodes one YOLO output, keeping only rows whose best class is person
+ */
+void Detection::decodePersonRows(const cv::Mat &out, int personClassId,
+float confThreshold, cv::Size frameSize, std::vector<cv::Rect> &boxes,
+std::vector<float> &confidences) {
+  const int rows = out.rows;
+  const int cols = out.cols;
+  const int numClasses = cols - 5;
+  if (personClassId < 0 || personClassId >= numClasses)
+    return;
+  const float *data = out.ptr<float>();
+  const int scoreCol = 5 + personClassId;
+  int j = 0;
+#if CV_SIMD
+  // Gather the person score of nlanes rows at once and skip the whole
+  // block when none of them passes the threshold
+  const int lanes = cv::v_float32::nlanes;
+  int offsets[cv::v_float32::nlanes];
+  for (int k = 0; k < lanes; ++k)
+    offsets[k] = k * cols;
+  const cv::v_float32 threshold = cv::vx_setall_f32(confThreshold);
+  for (; j <= rows - lanes; j += lanes) {
+    const float *block = data + static_cast<size_t>(j) * cols;
+    int mask = cv::v_signmask(cv::v_lut(block + scoreCol, offsets) >
+    threshold);
+    for (int k = 0; mask; ++k, mask >>= 1) {
+      if (!(mask & 1))
+        continue;
+      const float *row = block + static_cast<size_t>(k) * cols;
+      if (personIsBestClass(row + 5, numClasses, personClassId)) {
+        boxes.push_back(rowToBox(row, frameSize));
+        confidences.push_back(row[scoreCol]);
+      }
+    }
   }
+#endif
+  for (; j < rows; ++j) {
+    const float *row = data + static_cast<size_t>(j) * cols;
+    if (row[scoreCol] > confThreshold &&
+    personIsBestClass(row + 5, numClasses, personClassId)) {
+      boxes.push_back(rowToBox(row, frameSize));
+      confidences.push_back(row[scoreCol]);
+    }
+  }
+}
 
-  confidenceDetection = confidences;
-  return boxes;
+/**
+ * @brief Decodes one YOLO output with a full argmax over all class scores
+ */
+void Detection::decodeAllClassRows(const cv::Mat &out, float confThreshold,
+cv::Size frameSize, std::vector<int> &classIds,
+std::vector<cv::Rect> &boxes, std::vector<float> &confidences) {
+  // Scan through all the bounding boxes output from the
+  // network and keep only the ones with high confidence
+  // scores. Assign the box's class label as the class
+  // with the highest score for the box.
+  const float *data = out.ptr<float>();
+  for (int j = 0; j < out.rows; ++j, data += out.cols) {
+    cv::Mat scores = out.row(j).colRange(5, out.cols);
+    cv::Point classIdPoint;
+    double confidence;
+    // Get the value and location of the maximum score
+    minMaxLoc(scores, 0, &confidence, 0, &classIdPoint);
+    if (confidence > confThreshold) {
+      classIds.push_back(classIdPoint.x);
+      confidences.push_back(static_cast<float> (confidence));
+      boxes.push_back(rowToBox(data, frameSize));
+    }
+  }
 }
+
 /**
  * @brief Gets output names of the last layer of the neural network
  */
 
 std::vector<cv::String>
 Detection::getOutputsNames(const cv::dnn::Net &net) {
-  static std::vector<cv::String> names;
-  if (names.empty()) {
-    // Get the indices of the output layers,
-    // i.e. the layers with unconnected outputs
-    std::vector<int> outLayers = net.getUnconnectedOutLayers();
+  std::vector<cv::String> names;
+  // Get the indices of the output layers,
+  // i.e. the layers with unconnected outputs
+  std::vector<int> outLayers = net.getUnconnectedOutLayers();
 
-    // get the names of all the layers in the network
-    std::vector<cv::String> layersNames = net.getLayerNames();
+  // get the names of all the layers in the network
+  std::vector<cv::String> layersNames = net.getLayerNames();
 
-    // Get the names of the output layers in names
-    names.resize(outLayers.size());
-    for (size_t i = 0; i < outLayers.size(); ++i)
-      names[i] = layersNames[outLayers[i] - 1];
-  }
+  // Get the names of the output layers in names
+  names.resize(outLayers.size());
+  for (size_t i = 0; i < outLayers.size(); ++i)
+    names[i] = layersNames[outLayers[i] - 1];
   return names;
 }
@@ -0,0 +1,191 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file DetectionPolicy.cpp
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief DetectionPolicy Class implementation
+ * @version 0.1
+ * @date 2020-12-03
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "../include/DetectionPolicy.h"
+
+namespace {
+/** @brief Width of the gray copy the motion is measured on */
+const int kMotionWidth = 64;
+
+/** @brief Weight of a new sample in the smoothed timings */
+const double kSmoothing = 0.1;
+
+/** @brief Milliseconds between two time points */
+double elapsedMs(std::chrono::steady_clock::time_point start,
+std::chrono::steady_clock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+}  // namespace
+
+/**
+ * @brief Sets the interval bounds and the fixed cadence used for comparison
+ */
+void DetectionPolicy::setIntervals(int minInterval, int maxInterval,
+int fixedInterval) {
+  minInterval_ = std::max(1, minInterval);
+  maxInterval_ = std::max(minInterval_, maxInterval);
+  fixedInterval_ = std::max(1, fixedInterval);
+}
+
+/**
+ * @brief Sets the fraction of wall time detection may use
+ */
+void DetectionPolicy::setCpuBudget(double cpuBudget) {
+  cpuBudget_ = std::min(1.0, std::max(0.01, cpuBudget));
+}
+
+/**
+ * @brief Sets the mean gray level change that counts as strong motion
+ */
+void DetectionPolicy::setMotionThreshold(double motionThreshold) {
+  motionThreshold_ = std::max(0.1, motionThreshold);
+}
+
+/**
+ * @brief Mean absolute change of a small gray copy against the previous frame
+ */
+double DetectionPolicy::measureMotion(const cv::Mat &frame) {
+  if (frame.empty())
+    return 0;
+  cv::Size size(kMotionWidth,
+  std::max(1, frame.rows * kMotionWidth / std::max(1, frame.cols)));
+  if (frame.channels() == 3)
+    cv::cvtColor(frame, gray_, cv::COLOR_BGR2GRAY);
+  else
+    gray_ = frame;
+  cv::Mat small;
+  cv::resize(gray_, small, size, 0, 0, cv::INTER_AREA);
+  double motion = 0;
+  if (previousGray_.size() == small.size()) {
+    cv::Mat diff;
+    cv::absdiff(small, previousGray_, diff);
+    motion = cv::mean(diff)[0];
+  }
+  previousGray_ = small;
+  return motion;
+}
+
+/**
+ * @brief Decides whether the detector runs on this frame
+ */
+bool DetectionPolicy::shouldDetect(const cv::Mat &frame, int activeTracks,
+int lostTracks) {
+  auto now = std::chrono::steady_clock::now();
+  if (stats_.frames > 0) {
+    double period = elapsedMs(lastFrame_, now);
+    framePeriodMs_ = framePeriodMs_ > 0 ?
+    (1 - kSmoothing) * framePeriodMs_ + kSmoothing * period : period;
+  }
+  lastFrame_ = now;
+  stats_.frames++;
+  if (stats_.frames % fixedInterval_ == 0)
+    stats_.fixedCadence++;
+  motion_ = measureMotion(frame);
+
+  DetectionReason reason = DetectionReason::NONE;
+  if (framesSinceDetection_ < 0) {
+    reason = DetectionReason::FIRST_FRAME;
+  } else if (++framesSinceDetection_ >= maxInterval_) {
+    reason = DetectionReason::MAX_INTERVAL;
+  } else {
+    if (lostTracks > 0) {
+      reason = DetectionReason::TRACKER_FAILURE;
+    } else if (activeTracks == 0 && motion_ >= motionThreshold_) {
+      reason = DetectionReason::EMPTY_SCENE_MOTION;
+    } else {
+      // A still scene keeps the trackers reliable up to the maximum
+      // interval, motion shortens it
+      double interval = maxInterval_ / (1 + motion_ / motionThreshold_);
+      if (framesSinceDetection_ >= interval)
+        reason = DetectionReason::CADENCE;
+    }
+    // Detection may use at most cpuBudget_ of the wall time
+    int minInterval = minInterval_;
+    if (detectionMs_ > 0 && framePeriodMs_ > 0) {
+      int cpuInterval = static_cast<int>(std::ceil(detectionMs_ /
+      (cpuBudget_ * framePeriodMs_)));
+      minInterval = std::min(maxInterval_, std::max(minInterval, cpuInterval));
+    }
+    if (reason != DetectionReason::NONE && framesSinceDetection_ < minInterval) {
+      if (framesSinceDetection_ >= minInterval_)
+        stats_.cpuLimited++;
+      reason = DetectionReason::NONE;
+    }
+  }
+
+  lastReason_ = reason;
+  switch (reason) {
+    case DetectionReason::NONE:
+      return false;
+    case DetectionReason::FIRST_FRAME:
+      stats_.firstFrame++;
+      break;
+    case DetectionReason::MAX_INTERVAL:
+      stats_.maxInterval++;
+      break;
+    case DetectionReason::TRACKER_FAILURE:
+      stats_.trackerFailure++;
+      break;
+    case DetectionReason::EMPTY_SCENE_MOTION:
+      stats_.emptySceneMotion++;
+      break;
+    case DetectionReason::CADENCE:
+      stats_.cadence++;
+      break;
+  }
+  stats_.triggered++;
+  framesSinceDetection_ = 0;
+  return true;
+}
+
+/**
+ * @brief Records how long a detection pass took
+ */
+void DetectionPolicy::recordDetection(double detectionMs) {
+  detectionMs_ = detectionMs_ > 0 ?
+  (1 - kSmoothing) * detectionMs_ + kSmoothing * detectionMs : detectionMs;
+}
+
+/**
+ * @brief Gets the reason of the last decision
+ */
+DetectionReason DetectionPolicy::getLastReason() {
+  return lastReason_;
+}
+
+/**
+ * @brief Gets the policy counters
+ */
+PolicyStats DetectionPolicy::getStats() {
+  return stats_;
+}
+
+/**
+ * @brief Prints the triggered and saved detections against the fixed cadence
+ */
+void DetectionPolicy::printStats() {
+  long saved = static_cast<long>(stats_.fixedCadence) -
+  static_cast<long>(stats_.triggered);
+  std::cout << "Adaptive detection over " << stats_.frames << " frames: "
+  << stats_.triggered << " detections, " << stats_.fixedCadence
+  << " with a fixed interval of " << fixedInterval_ << ", saved " << saved
+  << std::endl;
+  std::cout << "  first frame " << stats_.firstFrame
+  << ", max interval " << stats_.maxInterval
+  << ", tracker failure " << stats_.trackerFailure
+  << ", motion in empty scene " << stats_.emptySceneMotion
+  << ", cadence " << stats_.cadence
+  << ", held back by CPU budget " << stats_.cpuLimited << std::endl;
+}
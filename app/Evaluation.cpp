@@ -0,0 +1,434 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file Evaluation.cpp
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief MotAccumulator and Evaluator Class implementation
+ * @version 0.1
+ * @date 2020-12-12
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <opencv2/imgcodecs.hpp>
+#include "../include/Evaluation.h"
+#include "../include/Detection.h"
+#include "../include/Track.h"
+
+namespace {
+/**
+ * @brief CPU seconds of the calling thread or of the whole process
+ */
+double cpuSeconds(bool thread) {
+  timespec now;
+  clock_gettime(thread ? CLOCK_THREAD_CPUTIME_ID : CLOCK_PROCESS_CPUTIME_ID,
+  &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Share of part in total, 0 for an empty total
+ */
+double ratio(double part, double total) {
+  return total > 0 ? part / total : 0;
+}
+}  // namespace
+
+/**
+ * @brief Adds the matches, misses, false positives and ID switches of a frame
+ */
+void MotAccumulator::update(const std::vector<MotBox> &truth,
+const std::vector<MotBox> &hypotheses) {
+  metrics_.frames++;
+  metrics_.groundTruth += static_cast<int>(truth.size());
+  metrics_.hypotheses += static_cast<int>(hypotheses.size());
+  for (const auto &box : truth)
+    truthBoxes_[box.id]++;
+  for (const auto &box : hypotheses)
+    hypothesisBoxes_[box.id]++;
+
+  std::vector<std::vector<double>> cost(truth.size(),
+  std::vector<double>(hypotheses.size(), 1.0));
+  for (size_t i = 0; i < truth.size(); ++i)
+    for (size_t j = 0; j < hypotheses.size(); ++j) {
+      double iou = Track::iou(truth[i].box, hypotheses[j].box);
+      cost[i][j] = 1.0 - iou;
+      if (iou >= minIou_)
+        overlaps_[{truth[i].id, hypotheses[j].id}]++;
+    }
+
+  // Matches of the last frame that still overlap are kept
+  std::vector<int> match(truth.size(), -1);
+  std::vector<bool> taken(hypotheses.size(), false);
+  for (size_t i = 0; i < truth.size(); ++i) {
+    auto last = lastMatch_.find(truth[i].id);
+    if (last == lastMatch_.end())
+      continue;
+    for (size_t j = 0; j < hypotheses.size(); ++j)
+      if (!taken[j] && hypotheses[j].id == last->second &&
+      1.0 - cost[i][j] >= minIou_) {
+        match[i] = static_cast<int>(j);
+        taken[j] = true;
+        break;
+      }
+  }
+  // The others are assigned at the lowest total cost
+  std::vector<size_t> rows, cols;
+  for (size_t i = 0; i < truth.size(); ++i)
+    if (match[i] < 0)
+      rows.push_back(i);
+  for (size_t j = 0; j < hypotheses.size(); ++j)
+    if (!taken[j])
+      cols.push_back(j);
+  std::vector<std::vector<double>> open(rows.size(),
+  std::vector<double>(cols.size()));
+  for (size_t r = 0; r < rows.size(); ++r)
+    for (size_t c = 0; c < cols.size(); ++c)
+      open[r][c] = cost[rows[r]][cols[c]];
+  std::vector<int> assignment = Track::solveAssignment(open);
+  for (size_t r = 0; r < rows.size(); ++r) {
+    int c = assignment[r];
+    if (c < 0 || 1.0 - open[r][c] < minIou_)
+      continue;
+    const int i = static_cast<int>(rows[r]);
+    const int j = static_cast<int>(cols[c]);
+    auto last = lastMatch_.find(truth[i].id);
+    if (last != lastMatch_.end() && last->second != hypotheses[j].id)
+      metrics_.idSwitches++;
+    match[i] = j;
+  }
+
+  int matched = 0;
+  for (size_t i = 0; i < truth.size(); ++i)
+    if (match[i] >= 0) {
+      lastMatch_[truth[i].id] = hypotheses[match[i]].id;
+      matched++;
+    }
+  metrics_.truePositives += matched;
+  metrics_.misses += static_cast<int>(truth.size()) - matched;
+  metrics_.falsePositives += static_cast<int>(hypotheses.size()) - matched;
+}
+
+/**
+ * @brief Computes the metrics of all frames added so far
+ */
+MotMetrics MotAccumulator::finish() const {
+  MotMetrics metrics = metrics_;
+  // IDF1 assigns every ground truth identity to at most one hypothesis
+  // identity, maximizing the frames they overlap
+  std::vector<int> truthIds, hypothesisIds;
+  for (const auto &entry : truthBoxes_)
+    truthIds.push_back(entry.first);
+  for (const auto &entry : hypothesisBoxes_)
+    hypothesisIds.push_back(entry.first);
+  int most = 0;
+  for (const auto &entry : overlaps_)
+    most = std::max(most, entry.second);
+  std::vector<std::vector<double>> cost(truthIds.size(),
+  std::vector<double>(hypothesisIds.size(), most));
+  for (size_t i = 0; i < truthIds.size(); ++i)
+    for (size_t j = 0; j < hypothesisIds.size(); ++j) {
+      auto overlap = overlaps_.find({truthIds[i], hypothesisIds[j]});
+      if (overlap != overlaps_.end())
+        cost[i][j] = most - overlap->second;
+    }
+  std::vector<int> assignment = Track::solveAssignment(cost);
+  metrics.idTruePositives = 0;
+  for (size_t i = 0; i < truthIds.size(); ++i)
+    if (assignment[i] >= 0)
+      metrics.idTruePositives += static_cast<int>(most -
+      cost[i][assignment[i]]);
+
+  metrics.precision = ratio(metrics.truePositives, metrics.hypotheses);
+  metrics.recall = ratio(metrics.truePositives, metrics.groundTruth);
+  metrics.mota = metrics.groundTruth > 0 ? 1.0 - static_cast<double>(
+  metrics.misses + metrics.falsePositives + metrics.idSwitches) /
+  metrics.groundTruth : 0;
+  metrics.idf1 = ratio(2.0 * metrics.idTruePositives,
+  metrics.groundTruth + metrics.hypotheses);
+  return metrics;
+}
+
+/**
+ * @brief Loads a MOTChallenge sequence directory
+ */
+bool Evaluator::setSequence(const std::string &directory) {
+  frames_.clear();
+  truth_.clear();
+  try {
+    cv::glob(directory + "/img1/*.jpg", frames_, false);
+  }
+  catch (const cv::Exception &) {
+    frames_.clear();
+  }
+  std::sort(frames_.begin(), frames_.end());
+  if (frames_.empty()) {
+    std::cout << "No frames in " << directory << "/img1" << std::endl;
+    return false;
+  }
+  if (!loadGroundTruth(directory + "/gt/gt.txt", truth_)) {
+    std::cout << "No ground truth in " << directory << "/gt" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Sets the number of worker threads of a sweep
+ */
+void Evaluator::setNumWorkers(int numWorkers) {
+  numWorkers_ = std::max(0, numWorkers);
+}
+
+/**
+ * @brief Selects SORT instead of KCF tracking
+ */
+void Evaluator::setSortTracker(bool sort) {
+  sort_ = sort;
+}
+
+/**
+ * @brief Sets the minimum IoU of a match
+ */
+void Evaluator::setMinIou(double minIou) {
+  minIou_ = minIou;
+}
+
+/**
+ * @brief Runs one setting over the sequence, timing detection and tracking
+ * but not reading the frames
+ */
+EvalResult Evaluator::evaluate(const EvalParams &params,
+Detection &detection, bool threadCpu) const {
+  EvalResult result;
+  result.params = params;
+  Track tracker;
+  configure(params, detection, tracker);
+  MotAccumulator accumulator(minIou_);
+  const std::vector<MotBox> none;
+  double wallSeconds = 0;
+  double cpuTotal = 0;
+  std::vector<MotBox> hypotheses;
+  for (size_t index = 0; index < frames_.size(); ++index) {
+    cv::Mat frame = cv::imread(frames_[index]);
+    if (frame.empty())
+      continue;
+    auto start = std::chrono::steady_clock::now();
+    double cpuStart = cpuSeconds(threadCpu);
+    tracker.setFrame(frame);
+    if (index % std::max(1, params.detectionInterval) == 0) {
+      detection.setFrame(frame);
+      tracker.runTrackerAlgorithm(detection.processFrameforHuman());
+    } else {
+      tracker.updateTracker();
+    }
+    collectHypotheses(tracker, hypotheses);
+    cpuTotal += cpuSeconds(threadCpu) - cpuStart;
+    wallSeconds += std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+    // MOTChallenge frames are numbered from 1
+    auto truth = truth_.find(static_cast<int>(index) + 1);
+    accumulator.update(truth == truth_.end() ? none : truth->second,
+    hypotheses);
+  }
+  result.metrics = accumulator.finish();
+  result.fps = ratio(result.metrics.frames, wallSeconds);
+  result.cpuSecondsPerFrame = ratio(cpuTotal, result.metrics.frames);
+  return result;
+}
+
+/**
+ * @brief Evaluates every setting of a grid, in parallel
+ */
+std::vector<EvalResult> Evaluator::sweep(
+const std::vector<EvalParams> &grid) const {
+  std::vector<EvalResult> results(grid.size());
+  int workers = numWorkers_ > 0 ? numWorkers_ :
+  static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+  workers = std::min(workers, static_cast<int>(grid.size()));
+  if (workers <= 1) {
+    Detection detection;
+    for (size_t i = 0; i < grid.size(); ++i)
+      results[i] = evaluate(grid[i], detection, false);
+  } else {
+    // One network per core, so every setting is timed on one core and the
+    // CPU time of its own thread is its whole cost
+    const int openCvThreads = cv::getNumThreads();
+    cv::setNumThreads(1);
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> threads;
+    for (int w = 0; w < workers; ++w) {
+      threads.emplace_back([&]() {
+        // The network is loaded once per worker, not once per setting
+        Detection detection;
+        for (size_t i = next++; i < grid.size(); i = next++)
+          results[i] = evaluate(grid[i], detection, true);
+      });
+    }
+    for (auto &thread : threads)
+      thread.join();
+    cv::setNumThreads(openCvThreads);
+  }
+  markPareto(results);
+  return results;
+}
+
+/**
+ * @brief Sets a detector and a fresh tracker to a setting
+ */
+void Evaluator::configure(const EvalParams &params, Detection &detection,
+Track &tracker) const {
+  cv::Size inputSize = detection.getInputSize();
+  detection.initializeParams(params.confThreshold, params.nmsThreshold,
+  inputSize.width, inputSize.height);
+  detection.setDrawBoxes(false);
+  if (sort_)
+    tracker.setTrackerMode(TrackerMode::SORT);
+  tracker.setBoxShrink(params.shrinkWidth, params.shrinkHeight);
+  tracker.initializeTracker();
+}
+
+/**
+ * @brief Gets the current tracks as the hypotheses of a frame
+ */
+void Evaluator::collectHypotheses(Track &tracker,
+std::vector<MotBox> &hypotheses) {
+  const TrackTable &table = tracker.getTrackTable();
+  hypotheses.clear();
+  for (int slot : table.getSlots())
+    hypotheses.push_back({table.getId(slot), table.getBox(slot)});
+}
+
+/**
+ * @brief Reads MOTChallenge ground truth
+ */
+bool Evaluator::loadGroundTruth(const std::string &file,
+MotSequence &sequence) {
+  std::ifstream in(file);
+  if (!in)
+    return false;
+  std::string line;
+  while (std::getline(in, line)) {
+    std::vector<double> fields;
+    std::stringstream row(line);
+    std::string field;
+    while (std::getline(row, field, ','))
+      fields.push_back(std::atof(field.c_str()));
+    if (fields.size() < 6)
+      continue;
+    if (fields.size() > 6 && fields[6] == 0)
+      continue;
+    // Class 1 is pedestrian, the others are ignored regions and distractors
+    if (fields.size() > 7 && fields[7] != 1)
+      continue;
+    MotBox box;
+    box.id = static_cast<int>(fields[1]);
+    box.box = cv::Rect2d(fields[2] - 1, fields[3] - 1, fields[4], fields[5]);
+    sequence[static_cast<int>(fields[0])].push_back(box);
+  }
+  return true;
+}
+
+/**
+ * @brief Builds the cartesian product of parameter lists
+ */
+std::vector<EvalParams> Evaluator::grid(
+const std::vector<float> &confThresholds,
+const std::vector<float> &nmsThresholds, const std::vector<int> &intervals,
+const std::vector<double> &shrinks) {
+  std::vector<EvalParams> settings;
+  for (float conf : confThresholds)
+    for (float nms : nmsThresholds)
+      for (int interval : intervals)
+        for (double shrink : shrinks) {
+          EvalParams params;
+          params.confThreshold = conf;
+          params.nmsThreshold = nms;
+          params.detectionInterval = interval;
+          params.shrinkWidth = shrink;
+          params.shrinkHeight = shrink;
+          settings.push_back(params);
+        }
+  return settings;
+}
+
+/**
+ * @brief Marks the results no other result beats on MOTA and CPU time
+ */
+void Evaluator::markPareto(std::vector<EvalResult> &results) {
+  for (auto &result : results) {
+    result.pareto = true;
+    for (const auto &other : results) {
+      bool noWorse = other.metrics.mota >= result.metrics.mota &&
+      other.cpuSecondsPerFrame <= result.cpuSecondsPerFrame;
+      bool better = other.metrics.mota > result.metrics.mota ||
+      other.cpuSecondsPerFrame < result.cpuSecondsPerFrame;
+      if (noWorse && better) {
+        result.pareto = false;
+        break;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Prints the results sorted by CPU time per frame
+ */
+void Evaluator::printTable(const std::vector<EvalResult> &results) {
+  std::vector<EvalResult> sorted(results);
+  std::sort(sorted.begin(), sorted.end(),
+  [](const EvalResult &a, const EvalResult &b) {
+    return a.cpuSecondsPerFrame < b.cpuSecondsPerFrame;
+  });
+  std::cout << std::fixed;
+  std::cout << "  conf   nms  every  shrink   prec    rec    MOTA    IDF1"
+  "  IDsw      fps  cpu s/frame" << std::endl;
+  for (const auto &result : sorted) {
+    const EvalParams &p = result.params;
+    const MotMetrics &m = result.metrics;
+    std::cout << (result.pareto ? "*" : " ") << std::setprecision(2)
+    << std::setw(5) << p.confThreshold << std::setw(6) << p.nmsThreshold
+    << std::setw(7) << p.detectionInterval << std::setw(8)
+    << p.shrinkWidth << std::setprecision(3) << std::setw(7) << m.precision
+    << std::setw(7) << m.recall << std::setw(8) << m.mota << std::setw(8)
+    << m.idf1 << std::setw(6) << m.idSwitches << std::setprecision(1)
+    << std::setw(9) << result.fps << std::setprecision(4) << std::setw(13)
+    << result.cpuSecondsPerFrame << std::endl;
+  }
+  std::cout << "* Pareto optimal in MOTA and CPU time per frame" << std::endl;
+}
+
+/**
+ * @brief Writes the results as CSV
+ */
+bool Evaluator::writeCsv(const std::string &file,
+const std::vector<EvalResult> &results) {
+  std::ofstream out(file);
+  if (!out)
+    return false;
+  out << "conf,nms,interval,shrink_width,shrink_height,frames,ground_truth,"
+  "hypotheses,true_positives,false_positives,misses,id_switches,precision,"
+  "recall,mota,idf1,fps,cpu_seconds_per_frame,pareto\n";
+  for (const auto &result : results) {
+    const EvalParams &p = result.params;
+    const MotMetrics &m = result.metrics;
+    out << p.confThreshold << "," << p.nmsThreshold << ","
+    << p.detectionInterval << "," << p.shrinkWidth << "," << p.shrinkHeight
+    << "," << m.frames << "," << m.groundTruth << "," << m.hypotheses << ","
+    << m.truePositives << "," << m.falsePositives << "," << m.misses << ","
+    << m.idSwitches << "," << m.precision << "," << m.recall << ","
+    << m.mota << "," << m.idf1 << "," << result.fps << ","
+    << result.cpuSecondsPerFrame << "," << (result.pareto ? 1 : 0) << "\n";
+  }
+  return static_cast<bool>(out);
+}
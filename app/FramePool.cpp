@@ -0,0 +1,192 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file FramePool.cpp
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief FramePool Class implementation
+ * @version 0.1
+ * @date 2020-12-05
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+#include <utility>
+#include "../include/FramePool.h"
+
+/**
+ * @brief FrameHandle constructor for a slot that already holds one reference
+ */
+FrameHandle::FrameHandle(FramePool *pool, size_t slot) : pool_(pool),
+slot_(slot) {
+}
+
+/**
+ * @brief Copies a handle, sharing its buffer
+ */
+FrameHandle::FrameHandle(const FrameHandle &other) : pool_(other.pool_),
+slot_(other.slot_) {
+  if (pool_)
+    pool_->refs_[slot_]++;
+}
+
+/**
+ * @brief Moves a handle, the source becomes empty
+ */
+FrameHandle::FrameHandle(FrameHandle &&other) noexcept : pool_(other.pool_),
+slot_(other.slot_) {
+  other.pool_ = nullptr;
+}
+
+/**
+ * @brief Shares the buffer of another handle
+ */
+FrameHandle &FrameHandle::operator=(const FrameHandle &other) {
+  if (this != &other) {
+    if (other.pool_)
+      other.pool_->refs_[other.slot_]++;
+    reset();
+    pool_ = other.pool_;
+    slot_ = other.slot_;
+  }
+  return *this;
+}
+
+/**
+ * @brief Takes over the buffer of another handle
+ */
+FrameHandle &FrameHandle::operator=(FrameHandle &&other) noexcept {
+  if (this != &other) {
+    reset();
+    pool_ = other.pool_;
+    slot_ = other.slot_;
+    other.pool_ = nullptr;
+  }
+  return *this;
+}
+
+/**
+ * @brief Drops this handle's reference
+ */
+void FrameHandle::reset() {
+  if (pool_ && --pool_->refs_[slot_] == 0)
+    pool_->release(slot_);
+  pool_ = nullptr;
+}
+
+/**
+ * @brief Gets the frame buffer
+ */
+cv::Mat &FrameHandle::mat() const {
+  return pool_->frames_[slot_];
+}
+
+/**
+ * @brief Gets the number of handles sharing the buffer
+ */
+int FrameHandle::useCount() const {
+  return pool_ ? pool_->refs_[slot_].load() : 0;
+}
+
+/**
+ * @brief FramePool constructor, all buffers start free and empty
+ */
+FramePool::FramePool(size_t capacity) : frames_(capacity ? capacity : 1),
+refs_(new std::atomic<int>[capacity ? capacity : 1]) {
+  free_.reserve(frames_.size());
+  for (size_t i = frames_.size(); i > 0; --i) {
+    refs_[i - 1] = 0;
+    free_.push_back(i - 1);
+  }
+}
+
+/**
+ * @brief Takes a free buffer, waits if none is free
+ */
+FrameHandle FramePool::acquire() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  hasFree_.wait(lock, [this] { return !free_.empty(); });
+  size_t slot = free_.back();
+  free_.pop_back();
+  refs_[slot] = 1;
+  return FrameHandle(this, slot);
+}
+
+/**
+ * @brief Returns a slot whose last handle was destroyed
+ */
+void FramePool::release(size_t slot) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(slot);
+  }
+  hasFree_.notify_one();
+}
+
+/**
+ * @brief Gets the number of free buffers
+ */
+size_t FramePool::available() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return free_.size();
+}
+
+/**
+ * @brief Gets the number of buffers
+ */
+size_t FramePool::capacity() {
+  return frames_.size();
+}
+
+/**
+ * @brief Counts a buffer and allocates it with OpenCV's standard allocator
+ */
+cv::UMatData *MatAllocationCounter::allocate(int dims, const int *sizes,
+int type, void *data, size_t *step, cv::AccessFlag flags,
+cv::UMatUsageFlags usageFlags) const {
+  if (!data)
+    count_++;
+  return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step,
+  flags, usageFlags);
+}
+
+/**
+ * @brief Forwards to OpenCV's standard allocator
+ */
+bool MatAllocationCounter::allocate(cv::UMatData *data,
+cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const {
+  return cv::Mat::getStdAllocator()->allocate(data, accessFlags, usageFlags);
+}
+
+/**
+ * @brief Forwards to OpenCV's standard allocator
+ */
+void MatAllocationCounter::deallocate(cv::UMatData *data) const {
+  cv::Mat::getStdAllocator()->deallocate(data);
+}
+
+/**
+ * @brief Makes this counter the default allocator and resets the count
+ */
+void MatAllocationCounter::install() {
+  if (!previous_)
+    previous_ = cv::Mat::getDefaultAllocator();
+  count_ = 0;
+  cv::Mat::setDefaultAllocator(this);
+}
+
+/**
+ * @brief Restores the previous default allocator
+ */
+void MatAllocationCounter::uninstall() {
+  if (previous_) {
+    cv::Mat::setDefaultAllocator(previous_);
+    previous_ = nullptr;
+  }
+}
+
+/**
+ * @brief Gets the number of buffers allocated since install
+ */
+size_t MatAllocationCounter::getCount() const {
+  return count_;
+}
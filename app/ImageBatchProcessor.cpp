@@ -0,0 +1,332 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file ImageBatchProcessor.cpp
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief ImageBatchProcessor Class implementation
+ * @version 0.1
+ * @date 2020-12-08
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include "../include/ImageBatchProcessor.h"
+#include "../include/ThreadPool.h"
+
+namespace {
+/** @brief Extensions imread is asked to decode */
+const char *const kImageExtensions[] = {".jpg", ".jpeg", ".png", ".bmp",
+".tif", ".tiff", ".webp"};
+
+/** @brief Fields of a complete results line */
+const int kResultFields = 6;
+
+/** @brief Confidence fields of the line that closes a finished image */
+const char *const kDoneMarker = "done";
+const char *const kUnreadableMarker = "unreadable";
+
+/** @brief Header of the results file */
+const char *const kResultsHeader = "image,x,y,width,height,confidence";
+
+/**
+ * @brief Checks the extension of a file name, ignoring case
+ */
+bool isImage(const std::string &file) {
+  std::string extension = std::filesystem::path(file).extension().string();
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+  ::tolower);
+  for (const char *known : kImageExtensions)
+    if (extension == known)
+      return true;
+  return false;
+}
+
+/**
+ * @brief Quotes an image name that holds a comma or a quote, the CSV way
+ */
+std::string csvField(const std::string &text) {
+  if (text.find_first_of(",\"\n") == std::string::npos)
+    return text;
+  std::string quoted = "\"";
+  for (char c : text) {
+    if (c == '"')
+      quoted += '"';
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+/**
+ * @brief Reads the image name and the confidence field of a results line. Returns false for a
+ *        line without all fields.
+ */
+bool parseLine(const std::string &line, std::string &image,
+std::string &confidence) {
+  size_t rest = 0;
+  image.clear();
+  if (!line.empty() && line[0] == '"') {
+    size_t i = 1;
+    for (; i < line.size(); ++i) {
+      if (line[i] != '"') {
+        image += line[i];
+      } else if (i + 1 < line.size() && line[i + 1] == '"') {
+        image += '"';
+        ++i;
+      } else {
+        break;
+      }
+    }
+    if (i + 1 >= line.size() || line[i + 1] != ',')
+      return false;
+    rest = i + 1;
+  } else {
+    // Unquoted names have no comma, older files may still hold some, so
+    // the numeric fields are the last ones
+    rest = line.size();
+    for (int field = 1; field < kResultFields; ++field) {
+      if (rest == 0)
+        return false;
+      rest = line.rfind(',', rest - 1);
+      if (rest == std::string::npos)
+        return false;
+    }
+    image = line.substr(0, rest);
+  }
+  if (std::count(line.begin() + rest, line.end(), ',') != kResultFields - 1)
+    return false;
+  confidence = line.substr(line.rfind(',') + 1);
+  return true;
+}
+
+/**
+ * @brief Rewrites a results file with only the lines of finished images. Drops a last line
+ *        cut short by a crash and the lines of an image that was only partly written.
+ */
+bool dropUnfinished(const std::string &resultsFile,
+const std::set<std::string> &finished) {
+  std::ifstream in(resultsFile);
+  if (!in)
+    return true;
+  std::string kept = std::string(kResultsHeader) + "\n";
+  std::string line, image, confidence;
+  while (std::getline(in, line)) {
+    if (in.eof())
+      break;
+    if (parseLine(line, image, confidence) && finished.count(image))
+      kept += line + "\n";
+  }
+  in.close();
+  const std::string temporary = resultsFile + ".tmp";
+  std::ofstream out(temporary, std::ios::trunc);
+  out << kept;
+  out.close();
+  std::error_code error;
+  std::filesystem::rename(temporary, resultsFile, error);
+  return out && !error;
+}
+
+/**
+ * @brief Milliseconds since start
+ */
+double elapsedMs(const std::chrono::steady_clock::time_point &start) {
+  return std::chrono::duration<double, std::milli>
+  (std::chrono::steady_clock::now() - start).count();
+}
+}  // namespace
+
+/**
+ * @brief Sets the number of decode and encode threads
+ */
+void ImageBatchProcessor::setNumThreads(int numThreads) {
+  numThreads_ = std::max(0, numThreads);
+}
+
+/**
+ * @brief Sets the directory of the annotated images
+ */
+void ImageBatchProcessor::setOutputDirectory(
+const std::string &outputDirectory) {
+  outputDirectory_ = outputDirectory;
+}
+
+/**
+ * @brief Sets the results file
+ */
+void ImageBatchProcessor::setResultsFile(const std::string &resultsFile) {
+  resultsFile_ = resultsFile;
+}
+
+/**
+ * @brief Selects between resuming and starting over
+ */
+void ImageBatchProcessor::setResume(bool resume) {
+  resume_ = resume;
+}
+
+/**
+ * @brief Lists the images of a directory or a glob pattern
+ */
+std::vector<std::string> ImageBatchProcessor::listImages(
+const std::string &pattern) {
+  // glob lists every file of a directory and the matches of a pattern
+  std::vector<cv::String> matches;
+  cv::glob(pattern, matches, false);
+  std::vector<std::string> images;
+  for (const auto &match : matches)
+    if (isImage(match))
+      images.push_back(match);
+  std::sort(images.begin(), images.end());
+  return images;
+}
+
+/**
+ * @brief Reads the images a results file already covers
+ */
+std::set<std::string> ImageBatchProcessor::finishedImages(
+const std::string &resultsFile) {
+  std::set<std::string> finished;
+  std::ifstream results(resultsFile);
+  std::string line, image, confidence;
+  while (std::getline(results, line)) {
+    // The last line has no newline if the run stopped while writing it
+    if (results.eof())
+      break;
+    // Only the closing line says all lines of an image were written
+    if (parseLine(line, image, confidence) && (confidence == kDoneMarker ||
+    confidence == kUnreadableMarker))
+      finished.insert(image);
+  }
+  return finished;
+}
+
+/**
+ * @brief Detects people on every image of a directory or glob
+ */
+bool ImageBatchProcessor::process(Detection &detection,
+const std::string &pattern) {
+  stats_ = ImageBatchStats();
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::string> images = listImages(pattern);
+  std::set<std::string> finished;
+  if (resume_) {
+    finished = finishedImages(resultsFile_);
+    if (!dropUnfinished(resultsFile_, finished)) {
+      std::cout << "Could not rewrite the results file " << resultsFile_
+      << std::endl;
+      return false;
+    }
+  }
+  std::vector<std::string> pending;
+  for (const auto &image : images)
+    if (!finished.count(image))
+      pending.push_back(image);
+  stats_.resumed = images.size() - pending.size();
+
+  std::error_code error;
+  bool header = !resume_ || !std::filesystem::exists(resultsFile_, error) ||
+  std::filesystem::file_size(resultsFile_, error) == 0;
+  std::ofstream results(resultsFile_, resume_ ? std::ios::app :
+  std::ios::trunc);
+  if (!results) {
+    std::cout << "Could not write the results file " << resultsFile_
+    << std::endl;
+    return false;
+  }
+  if (header)
+    results << kResultsHeader << "\n";
+  if (!outputDirectory_.empty())
+    std::filesystem::create_directories(outputDirectory_);
+
+  int threads = numThreads_ > 0 ? numThreads_ :
+  static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+  ThreadPool pool(threads);
+  const size_t batchSize = std::max(1, detection.getBatchSize());
+  auto decode = [&](size_t first) {
+    size_t last = std::min(pending.size(), first + batchSize);
+    std::vector<cv::Mat> decoded(last - first);
+    pool.parallelFor(decoded.size(), [&](size_t i) {
+      decoded[i] = cv::imread(pending[first + i], cv::IMREAD_COLOR);
+    });
+    return decoded;
+  };
+
+  std::future<std::vector<cv::Mat>> next;
+  if (!pending.empty())
+    next = std::async(std::launch::async, decode, 0);
+  for (size_t first = 0; first < pending.size(); first += batchSize) {
+    std::vector<cv::Mat> decoded = next.get();
+    // Decode the next batch while this one is in the network
+    if (first + batchSize < pending.size())
+      next = std::async(std::launch::async, decode, first + batchSize);
+
+    std::vector<cv::Mat> frames;
+    std::vector<size_t> owners;
+    for (size_t i = 0; i < decoded.size(); ++i) {
+      if (decoded[i].empty()) {
+        // Marked, so a resumed run does not decode it again
+        results << csvField(pending[first + i]) << ",,,,,"
+        << kUnreadableMarker << "\n";
+        stats_.unreadable++;
+        continue;
+      }
+      frames.push_back(decoded[i]);
+      owners.push_back(first + i);
+    }
+    std::vector<std::vector<cv::Rect>> boxes;
+    std::vector<std::vector<float>> confidences;
+    detection.processBatch(frames, boxes, confidences);
+
+    if (!outputDirectory_.empty()) {
+      pool.parallelFor(frames.size(), [&](size_t k) {
+        std::filesystem::path name =
+        std::filesystem::path(pending[owners[k]]).filename();
+        cv::imwrite((std::filesystem::path(outputDirectory_) / name).string(),
+        frames[k]);
+      });
+    }
+    for (size_t k = 0; k < frames.size(); ++k) {
+      const std::string image = csvField(pending[owners[k]]);
+      // All lines of an image go out in one write, closed by the line
+      // that marks it finished
+      std::ostringstream lines;
+      for (size_t idx = 0; idx < boxes[k].size(); ++idx) {
+        const cv::Rect &box = boxes[k][idx];
+        lines << image << "," << box.x << "," << box.y << "," << box.width
+        << "," << box.height << "," << confidences[k][idx] << "\n";
+      }
+      lines << image << ",,,,," << kDoneMarker << "\n";
+      results << lines.str();
+      stats_.detections += boxes[k].size();
+      stats_.images++;
+    }
+    results.flush();
+  }
+  stats_.wallMs = elapsedMs(start);
+  return true;
+}
+
+/**
+ * @brief Gets the counters of the last run
+ */
+ImageBatchStats ImageBatchProcessor::getStats() {
+  return stats_;
+}
+
+/**
+ * @brief Prints the counters of the last run
+ */
+void ImageBatchProcessor::printStats() {
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "Batch images: " << stats_.images << " processed, "
+  << stats_.resumed << " already done, " << stats_.unreadable
+  << " unreadable, " << stats_.detections << " people, "
+  << (stats_.wallMs > 0 ? stats_.images * 1000.0 / stats_.wallMs : 0)
+  << " images/s" << std::endl;
+}
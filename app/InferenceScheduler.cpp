@@ -0,0 +1,140 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file InferenceScheduler.cpp
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief InferenceScheduler Class implementation
+ * @version 0.1
+ * @date 2020-11-27
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+#include <iostream>
+#include "../include/InferenceScheduler.h"
+
+/**
+ * @brief InferenceScheduler constructor, starts the worker thread.
+ */
+InferenceScheduler::InferenceScheduler(Detection &detection, int numStreams,
+size_t maxPendingPerStream) : detection_(detection),
+queues_(numStreams > 0 ? numStreams : 1),
+maxPendingPerStream_(maxPendingPerStream ? maxPendingPerStream : 1) {
+  worker_ = std::thread(&InferenceScheduler::workerLoop, this);
+}
+
+/**
+ * @brief Queues a frame of a stream for detection
+ */
+std::future<InferenceResult> InferenceScheduler::submit(int streamId,
+const cv::Mat &frame) {
+  InferenceRequest request;
+  request.frame = frame;
+  std::future<InferenceResult> result = request.promise.get_future();
+  std::unique_lock<std::mutex> lock(mutex_);
+  std::deque<InferenceRequest> &queue = queues_.at(streamId);
+  hasRoom_.wait(lock, [&] {
+    return stopping_ || queue.size() < maxPendingPerStream_;
+  });
+  if (stopping_) {
+    request.promise.set_value(InferenceResult());
+    return result;
+  }
+  queue.push_back(std::move(request));
+  hasWork_.notify_one();
+  return result;
+}
+
+/**
+ * @brief Collects fair batches and runs them until the scheduler stops
+ */
+void InferenceScheduler::workerLoop() {
+  while (true) {
+    std::vector<InferenceRequest> batch;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      auto pending = [this] {
+        for (const auto &queue : queues_)
+          if (!queue.empty())
+            return true;
+        return false;
+      };
+      hasWork_.wait(lock, [&] { return stopping_ || pending(); });
+      if (!pending())
+        return;
+      // One request per stream per round, starting from a rotating
+      // stream so that no stream is always served first
+      const size_t maxBatch = static_cast<size_t>(detection_.getBatchSize());
+      const size_t numStreams = queues_.size();
+      bool took = true;
+      while (batch.size() < maxBatch && took) {
+        took = false;
+        for (size_t i = 0; i < numStreams && batch.size() < maxBatch; ++i) {
+          std::deque<InferenceRequest> &queue =
+          queues_[(nextStream_ + i) % numStreams];
+          if (queue.empty())
+            continue;
+          batch.push_back(std::move(queue.front()));
+          queue.pop_front();
+          took = true;
+        }
+      }
+      nextStream_ = (nextStream_ + 1) % numStreams;
+      hasRoom_.notify_all();
+    }
+
+    std::vector<cv::Mat> frames;
+    for (const auto &request : batch)
+      frames.push_back(request.frame);
+    std::vector<std::vector<cv::Rect>> detections;
+    std::vector<std::vector<float>> confidences;
+    try {
+      detection_.processBatch(frames, detections, confidences);
+    }
+    catch (...) {
+      std::cout << "Inference failed for a batch of " << frames.size()
+      << " frames" << std::endl;
+      detections.assign(frames.size(), std::vector<cv::Rect>());
+      confidences.assign(frames.size(), std::vector<float>());
+    }
+    for (size_t i = 0; i < batch.size(); ++i) {
+      InferenceResult result;
+      result.detections = detections[i];
+      result.confidences = confidences[i];
+      batch[i].promise.set_value(result);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    batchCount_++;
+    frameCount_ += batch.size();
+  }
+}
+
+/**
+ * @brief Finishes the pending requests and joins the worker thread
+ */
+void InferenceScheduler::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  hasWork_.notify_all();
+  hasRoom_.notify_all();
+  if (worker_.joinable())
+    worker_.join();
+}
+
+/**
+ * @brief Gets the number of forward batches run so far
+ */
+size_t InferenceScheduler::getBatchCount() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return batchCount_;
+}
+
+/**
+ * @brief Gets the number of frames run so far
+ */
+size_t InferenceScheduler::getFrameCount() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return frameCount_;
+}
@@ -0,0 +1,274 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file ModelBundle.cpp
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief ModelBundle Class implementation
+ * @version 0.1
+ * @date 2020-12-07
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include "../include/ModelBundle.h"
+
+namespace {
+/** @brief First bytes of every bundle */
+const char kMagic[8] = {'H', 'D', 'T', 'B', 'N', 'D', 'L', '\0'};
+
+/** @brief Sections in file order: config, weights, output names, labels */
+const int kSections = 4;
+
+/** @brief Sections start on this boundary, so the weights are page aligned */
+const size_t kAlignment = 4096;
+
+/**
+ * @brief Fixed size start of a bundle, followed by the section table
+ */
+struct BundleHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t sectionCount;
+  uint64_t checksum;
+  uint64_t fileSize;
+};
+
+/**
+ * @brief Position of one section in the bundle
+ */
+struct SectionEntry {
+  uint64_t offset;
+  uint64_t size;
+};
+
+/**
+ * @brief Reads a whole file, returns false if it cannot be opened
+ */
+bool readFile(const std::string &path, std::string &contents) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    return false;
+  contents.assign(std::istreambuf_iterator<char>(file),
+  std::istreambuf_iterator<char>());
+  return true;
+}
+
+/**
+ * @brief Rounds up to the section alignment
+ */
+size_t aligned(size_t offset) {
+  return (offset + kAlignment - 1) / kAlignment * kAlignment;
+}
+}  // namespace
+
+/**
+ * @brief 64-bit checksum of a buffer
+ */
+uint64_t ModelBundle::checksum(const char *data, size_t size) {
+  // FNV-1a over 64-bit words, with a final mix of the length
+  const uint64_t prime = 1099511628211ull;
+  uint64_t hash = 14695981039346656037ull;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, 8);
+    hash = (hash ^ word) * prime;
+  }
+  for (; i < size; ++i)
+    hash = (hash ^ static_cast<unsigned char>(data[i])) * prime;
+  return (hash ^ size) * prime;
+}
+
+/**
+ * @brief Packs model files into a bundle
+ */
+bool ModelBundle::write(const std::string &bundleFile,
+const std::string &configFile, const std::string &weightsFile,
+const std::string &classFile, const std::vector<std::string> &outputNames) {
+  std::string sections[kSections];
+  if (!readFile(configFile, sections[0]) ||
+  !readFile(weightsFile, sections[1]) || !readFile(classFile, sections[2]))
+    return false;
+  // Labels go last, the names read above move to their slot
+  std::swap(sections[2], sections[3]);
+  for (const auto &name : outputNames)
+    sections[2] += name + "\n";
+
+  const size_t tableEnd = sizeof(BundleHeader) +
+  kSections * sizeof(SectionEntry);
+  std::string file(aligned(tableEnd), '\0');
+  SectionEntry table[kSections];
+  for (int s = 0; s < kSections; ++s) {
+    file.resize(aligned(file.size()), '\0');
+    table[s].offset = file.size();
+    table[s].size = sections[s].size();
+    file += sections[s];
+  }
+  std::memcpy(&file[sizeof(BundleHeader)], table, sizeof(table));
+
+  BundleHeader header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.sectionCount = kSections;
+  header.fileSize = file.size();
+  header.checksum = checksum(file.data() + sizeof(BundleHeader),
+  file.size() - sizeof(BundleHeader));
+  std::memcpy(&file[0], &header, sizeof(header));
+
+  // Write next to the target and rename, so a running process never maps a
+  // half written bundle
+  const std::string partial = bundleFile + ".partial";
+  {
+    std::ofstream out(partial, std::ios::binary | std::ios::trunc);
+    if (!out.write(file.data(), file.size()))
+      return false;
+  }
+  return std::rename(partial.c_str(), bundleFile.c_str()) == 0;
+}
+
+/**
+ * @brief Maps a bundle and checks it
+ */
+bool ModelBundle::open(const std::string &bundleFile) {
+  close();
+  int fd = ::open(bundleFile.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat info;
+  if (fstat(fd, &info) != 0 ||
+  static_cast<size_t>(info.st_size) < sizeof(BundleHeader)) {
+    ::close(fd);
+    return false;
+  }
+  size_t size = static_cast<size_t>(info.st_size);
+  void *mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  // The mapping keeps the file alive
+  ::close(fd);
+  if (mapped == MAP_FAILED)
+    return false;
+  data_ = static_cast<const char *>(mapped);
+  size_ = size;
+
+  BundleHeader header;
+  std::memcpy(&header, data_, sizeof(header));
+  const size_t tableEnd = sizeof(BundleHeader) +
+  kSections * sizeof(SectionEntry);
+  if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+  header.version != kVersion || header.sectionCount != kSections ||
+  header.fileSize != size_ || size_ < tableEnd) {
+    close();
+    return false;
+  }
+  SectionEntry table[kSections];
+  std::memcpy(table, data_ + sizeof(BundleHeader), sizeof(table));
+  for (int s = 0; s < kSections; ++s) {
+    if (table[s].offset < tableEnd || table[s].offset > size_ ||
+    table[s].size > size_ - table[s].offset) {
+      close();
+      return false;
+    }
+    offsets_[s] = table[s].offset;
+    sizes_[s] = table[s].size;
+  }
+  // Reading the weights to checksum them also pulls them into the page
+  // cache, which the network parser needs right after anyway
+  madvise(const_cast<char *>(data_), size_, MADV_SEQUENTIAL);
+  if (checksum(data_ + sizeof(BundleHeader), size_ - sizeof(BundleHeader)) !=
+  header.checksum) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Unmaps the bundle
+ */
+void ModelBundle::close() {
+  if (data_)
+    munmap(const_cast<char *>(data_), size_);
+  data_ = nullptr;
+  size_ = 0;
+  for (int s = 0; s < kSections; ++s)
+    offsets_[s] = sizes_[s] = 0;
+}
+
+/**
+ * @brief Checks whether a bundle is mapped
+ */
+bool ModelBundle::isOpen() {
+  return data_ != nullptr;
+}
+
+/**
+ * @brief Gets the darknet config text
+ */
+const char *ModelBundle::getConfig() {
+  return data_ ? data_ + offsets_[0] : nullptr;
+}
+
+/**
+ * @brief Gets the size of the darknet config in bytes
+ */
+size_t ModelBundle::getConfigSize() {
+  return sizes_[0];
+}
+
+/**
+ * @brief Gets the darknet weights
+ */
+const char *ModelBundle::getWeights() {
+  return data_ ? data_ + offsets_[1] : nullptr;
+}
+
+/**
+ * @brief Gets the size of the darknet weights in bytes
+ */
+size_t ModelBundle::getWeightsSize() {
+  return sizes_[1];
+}
+
+/**
+ * @brief Splits a section into its lines
+ */
+std::vector<std::string> ModelBundle::lines(int section) {
+  std::vector<std::string> result;
+  if (!data_)
+    return result;
+  std::istringstream stream(std::string(data_ + offsets_[section],
+  sizes_[section]));
+  std::string line;
+  while (std::getline(stream, line))
+    result.push_back(line);
+  return result;
+}
+
+/**
+ * @brief Gets the output layer names
+ */
+std::vector<std::string> ModelBundle::getOutputNames() {
+  return lines(2);
+}
+
+/**
+ * @brief Gets the class labels
+ */
+std::vector<std::string> ModelBundle::getLabels() {
+  return lines(3);
+}
+
+/**
+ * @brief Destroy the Model Bundle object
+ */
+ModelBundle::~ModelBundle() {
+  close();
+}
@@ -0,0 +1,68 @@
+/**
+ * @file    ModelBundleTool.cpp
+ * @author  Sneha Nayak, Sukoon Sarin
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ * @version 0.1
+ * @date 2020-12-07
+ * @brief Converts the darknet model files into a memory-mapped model bundle
+ */
+
+#include <chrono>
+#include <iostream>
+#include <opencv2/core/core.hpp>
+#include <opencv2/dnn.hpp>
+#include "../include/ModelBundle.h"
+
+/**
+ * @fn main
+ * @brief Main function
+ * @detail Packs cfg, weights, output layer names and labels into one bundle and verifies it
+ * @return Program execution status
+ */
+int main(int argc, char **argv) {
+    const char *keys =
+        "{help h usage ? | | Usage example: \n\t\t."
+        "/model-bundle --config=../yolov4.cfg --weights=../yolov4.weights"
+        " --classes=../coco.names --output=../yolov4.bundle}"
+        "{config        | ../yolov4.cfg     | darknet config }"
+        "{weights       | ../yolov4.weights | darknet weights }"
+        "{classes       | ../coco.names     | class labels, one per line }"
+        "{output        | ../yolov4.bundle  | bundle to write }";
+    cv::CommandLineParser parser(argc, argv, keys);
+    if (parser.has("help")) {
+        parser.printMessage();
+        return 0;
+    }
+    const std::string config = parser.get<std::string>("config");
+    const std::string weights = parser.get<std::string>("weights");
+    const std::string output = parser.get<std::string>("output");
+    // The output layer names are looked up once here, not on every start
+    std::vector<std::string> outputNames;
+    try {
+        cv::dnn::Net net = cv::dnn::readNetFromDarknet(config, weights);
+        for (const auto &name : net.getUnconnectedOutLayersNames())
+            outputNames.push_back(name);
+    }
+    catch (...) {
+        std::cout << "Could not load the model files" << std::endl;
+        return 1;
+    }
+    if (!ModelBundle::write(output, config, weights,
+    parser.get<std::string>("classes"), outputNames)) {
+        std::cout << "Could not write " << output << std::endl;
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    ModelBundle bundle;
+    if (!bundle.open(output)) {
+        std::cout << "Written bundle failed verification" << std::endl;
+        return 1;
+    }
+    double openMs = std::chrono::duration<double, std::milli>
+    (std::chrono::steady_clock::now() - start).count();
+    std::cout << "Wrote " << output << " (version " << ModelBundle::kVersion
+    << ", " << bundle.getWeightsSize() << " weight bytes, "
+    << outputNames.size() << " output layers, " << bundle.getLabels().size()
+    << " labels), mapped and verified in " << openMs << " ms" << std::endl;
+    return 0;
+}
@@ -0,0 +1,178 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file ModelProfile.cpp
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief ModelProfiles Class implementation
+ * @version 0.1
+ * @date 2020-12-07
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+#include <iomanip>
+#include "../include/ModelProfile.h"
+#include "../include/Detection.h"
+
+namespace {
+/**
+ * @brief Runs the detector on a frame and gets the boxes it keeps
+ */
+std::vector<cv::Rect> detectPersons(Detection &detection,
+const cv::Mat &frame, double &elapsedMs) {
+  cv::Mat scratch = frame.clone();
+  detection.setFrame(scratch);
+  auto start = std::chrono::steady_clock::now();
+  std::vector<cv::Rect> boxes = detection.processFrameforHuman();
+  elapsedMs = std::chrono::duration<double, std::milli>
+  (std::chrono::steady_clock::now() - start).count();
+  return boxes;
+}
+}  // namespace
+
+/**
+ * @brief Gets the files and input size of a profile
+ */
+ModelProfileSpec ModelProfiles::spec(ModelProfile profile) {
+  switch (profile) {
+    case ModelProfile::YOLOV4_LOW_RES:
+      return {"yolov4-320", "../yolov4.weights", "../yolov4.cfg",
+      cv::Size(320, 320)};
+    case ModelProfile::YOLOV4_TINY:
+      return {"yolov4-tiny", "../yolov4-tiny.weights", "../yolov4-tiny.cfg",
+      cv::Size(416, 416)};
+    case ModelProfile::ONNX_FP16:
+      return {"onnx-fp16", "../yolov4-fp16.onnx", "", cv::Size(416, 416)};
+    case ModelProfile::ONNX_INT8:
+      return {"onnx-int8", "../yolov4-int8.onnx", "", cv::Size(416, 416)};
+    default:
+      return {"yolov4", "../yolov4.weights", "../yolov4.cfg",
+      cv::Size(416, 416)};
+  }
+}
+
+/**
+ * @brief Gets every profile, the reference first
+ */
+std::vector<ModelProfile> ModelProfiles::all() {
+  return {ModelProfile::YOLOV4, ModelProfile::YOLOV4_LOW_RES,
+  ModelProfile::YOLOV4_TINY, ModelProfile::ONNX_FP16, ModelProfile::ONNX_INT8};
+}
+
+/**
+ * @brief Parses a profile name
+ */
+bool ModelProfiles::parse(const std::string &name, ModelProfile &profile) {
+  for (ModelProfile candidate : all()) {
+    if (spec(candidate).name == name) {
+      profile = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Matches candidate boxes to reference boxes greedily by IoU
+ */
+size_t ModelProfiles::matchBoxes(const std::vector<cv::Rect> &reference,
+const std::vector<cv::Rect> &candidate, double iouThreshold) {
+  std::vector<bool> used(candidate.size(), false);
+  size_t matched = 0;
+  for (const auto &ref : reference) {
+    int best = -1;
+    double bestIou = iouThreshold;
+    for (size_t j = 0; j < candidate.size(); ++j) {
+      if (used[j])
+        continue;
+      double overlap = (ref & candidate[j]).area();
+      double iou = overlap / (ref.area() + candidate[j].area() - overlap);
+      if (iou >= bestIou) {
+        bestIou = iou;
+        best = static_cast<int>(j);
+      }
+    }
+    if (best >= 0) {
+      used[best] = true;
+      ++matched;
+    }
+  }
+  return matched;
+}
+
+/**
+ * @brief Runs every profile on the first frames of a clip
+ */
+std::vector<ProfileResult> ModelProfiles::compare(const std::string &clip,
+int maxFrames) {
+  std::vector<cv::Mat> frames;
+  cv::VideoCapture capture(clip);
+  cv::Mat frame;
+  while (static_cast<int>(frames.size()) < maxFrames && capture.read(frame))
+    frames.push_back(frame.clone());
+
+  std::vector<ProfileResult> results;
+  std::vector<std::vector<cv::Rect>> reference;
+  Detection detection;
+  for (ModelProfile profile : all()) {
+    ProfileResult result;
+    result.name = spec(profile).name;
+    detection.setModelProfile(profile);
+    result.loaded = detection.isModelLoaded();
+    if (!result.loaded || frames.empty()) {
+      results.push_back(result);
+      continue;
+    }
+    detection.warmUp();
+    size_t referenceBoxes = 0, candidateBoxes = 0, matched = 0;
+    double totalMs = 0;
+    for (size_t i = 0; i < frames.size(); ++i) {
+      double elapsedMs = 0;
+      std::vector<cv::Rect> boxes = detectPersons(detection, frames[i],
+      elapsedMs);
+      totalMs += elapsedMs;
+      // The first profile is full YOLOv4, it scores itself perfectly
+      if (profile == ModelProfile::YOLOV4)
+        reference.push_back(boxes);
+      if (i >= reference.size())
+        continue;
+      referenceBoxes += reference[i].size();
+      candidateBoxes += boxes.size();
+      matched += matchBoxes(reference[i], boxes);
+    }
+    result.frames = frames.size();
+    result.meanMs = totalMs / frames.size();
+    result.precision = candidateBoxes ?
+    static_cast<double>(matched) / candidateBoxes : 1.0;
+    result.recall = referenceBoxes ?
+    static_cast<double>(matched) / referenceBoxes : 1.0;
+    // Without the reference there is nothing to score against
+    if (reference.empty())
+      result.precision = result.recall = 0;
+    results.push_back(result);
+  }
+  detection.setModelProfile(ModelProfile::YOLOV4);
+  return results;
+}
+
+/**
+ * @brief Prints a comparison as a table
+ */
+void ModelProfiles::printComparison(
+const std::vector<ProfileResult> &results) {
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "profile        frames   mean ms     fps   precision   recall"
+  << std::endl;
+  for (const auto &result : results) {
+    std::cout << std::left << std::setw(13) << result.name << std::right;
+    if (!result.loaded) {
+      std::cout << "  model files not found" << std::endl;
+      continue;
+    }
+    std::cout << std::setw(8) << result.frames << std::setw(10)
+    << result.meanMs << std::setw(8)
+    << (result.meanMs > 0 ? 1000.0 / result.meanMs : 0.0)
+    << std::setprecision(3) << std::setw(12) << result.precision
+    << std::setw(9) << result.recall << std::setprecision(1) << std::endl;
+  }
+}
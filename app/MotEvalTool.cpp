@@ -0,0 +1,82 @@
+/**
+ * @file    MotEvalTool.cpp
+ * @author  Sneha Nayak, Sukoon Sarin
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ * @version 0.1
+ * @date 2020-12-12
+ * @brief Evaluates detector and tracker settings on an annotated MOTChallenge sequence
+ */
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "../include/Evaluation.h"
+
+/**
+ * @brief Parses a comma separated list of numbers
+ */
+template <typename T>
+std::vector<T> parseList(const std::string &text) {
+    std::vector<T> values;
+    std::stringstream list(text);
+    std::string item;
+    while (std::getline(list, item, ','))
+        if (!item.empty())
+            values.push_back(static_cast<T>(std::stod(item)));
+    return values;
+}
+
+/**
+ * @fn main
+ * @brief Main function
+ * @detail Runs every combination of the parameter lists over the sequence and prints
+ *         precision, recall, MOTA, IDF1 and ID switches next to FPS and CPU time per frame
+ * @return Program execution status
+ */
+int main(int argc, char **argv) {
+    const char *keys =
+        "{help h usage ? | | Usage example: \n\t\t."
+        "/mot-eval --sequence=../MOT17-09 --conf=0.3,0.5 --interval=15,45}"
+        "{sequence      |        | MOTChallenge sequence with img1/ and gt/gt.txt }"
+        "{conf          | 0.5    | confidence thresholds, comma separated }"
+        "{nms           | 0.4    | NMS thresholds, comma separated }"
+        "{interval      | 45     | frames between detections, comma separated }"
+        "{shrink        | 0.8    | tracked fraction of a detection's width and"
+        " height, comma separated }"
+        "{sort          |        | track with SORT instead of KCF }"
+        "{iou           | 0.5    | minimum IoU of a match }"
+        "{workers       | 0      | settings evaluated in parallel, 0 for one"
+        " per core }"
+        "{output        | eval.csv | results file }";
+    cv::CommandLineParser parser(argc, argv, keys);
+    if (parser.has("help") || !parser.has("sequence")) {
+        parser.printMessage();
+        return parser.has("help") ? 0 : 1;
+    }
+    Evaluator evaluator;
+    if (!evaluator.setSequence(parser.get<std::string>("sequence")))
+        return 1;
+    evaluator.setSortTracker(parser.has("sort"));
+    evaluator.setMinIou(parser.get<double>("iou"));
+    evaluator.setNumWorkers(parser.get<int>("workers"));
+    std::vector<EvalParams> grid = Evaluator::grid(
+    parseList<float>(parser.get<std::string>("conf")),
+    parseList<float>(parser.get<std::string>("nms")),
+    parseList<int>(parser.get<std::string>("interval")),
+    parseList<double>(parser.get<std::string>("shrink")));
+    if (grid.empty()) {
+        std::cout << "Empty parameter grid" << std::endl;
+        return 1;
+    }
+    std::vector<EvalResult> results = evaluator.sweep(grid);
+    Evaluator::printTable(results);
+    const std::string output = parser.get<std::string>("output");
+    if (!Evaluator::writeCsv(output, results)) {
+        std::cout << "Could not write " << output << std::endl;
+        return 1;
+    }
+    std::cout << "Results are stored as " << output << std::endl;
+    return 0;
+}
@@ -0,0 +1,240 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file MotionGate.cpp
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief MotionGate Class implementation
+ * @version 0.1
+ * @date 2020-12-04
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <utility>
+#include "../include/MotionGate.h"
+
+namespace {
+/** @brief Weight of a new sample in the smoothed costs */
+const double kSmoothing = 0.1;
+
+/** @brief Mean change a shift must save over no shift to count as camera motion */
+const double kShiftMargin = 0.5;
+
+/** @brief Milliseconds since a time point */
+double elapsedMs(const std::chrono::steady_clock::time_point &start) {
+  return std::chrono::duration<double, std::milli>
+  (std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Overlapping parts of the current and previous frame for a shift,
+ *        the content at (x, y) in the previous frame is at (x + dx, y + dy) now
+ */
+std::pair<cv::Rect, cv::Rect> overlap(const cv::Size &size, int dx, int dy) {
+  int width = size.width - std::abs(dx);
+  int height = size.height - std::abs(dy);
+  cv::Rect current(std::max(0, dx), std::max(0, dy), width, height);
+  cv::Rect previous(std::max(0, -dx), std::max(0, -dy), width, height);
+  return std::make_pair(current, previous);
+}
+}  // namespace
+
+/**
+ * @brief Sets the mean gray level change that marks a block as changed
+ */
+void MotionGate::setThreshold(double threshold) {
+  threshold_ = threshold;
+}
+
+/**
+ * @brief Finds the global shift with the least mean change
+ */
+cv::Point MotionGate::estimateShift() {
+  auto cost = [this](int dx, int dy) {
+    std::pair<cv::Rect, cv::Rect> rois = overlap(current_.size(), dx, dy);
+    return cv::norm(current_(rois.first), previous_(rois.second),
+    cv::NORM_L1) / rois.first.area();
+  };
+  cv::Point best(0, 0);
+  double bestCost = cost(0, 0) - kShiftMargin;
+  for (int dy = -searchRadius_; dy <= searchRadius_; ++dy) {
+    for (int dx = -searchRadius_; dx <= searchRadius_; ++dx) {
+      if (dx == 0 && dy == 0)
+        continue;
+      double shiftCost = cost(dx, dy);
+      if (shiftCost < bestCost) {
+        bestCost = shiftCost;
+        best = cv::Point(dx, dy);
+      }
+    }
+  }
+  return best;
+}
+
+/**
+ * @brief Compares a frame with the previous one and updates the change mask
+ */
+void MotionGate::update(const cv::Mat &frame) {
+  auto start = std::chrono::steady_clock::now();
+  stats_.frames++;
+  if (frame.empty())
+    return;
+  frameSize_ = frame.size();
+  const int gridRows = std::max(1, cvRound(static_cast<double>(frame.rows) *
+  gridCols_ / std::max(1, frame.cols)));
+  const cv::Size size(gridCols_ * blockSize_, gridRows * blockSize_);
+  if (frame.channels() == 3)
+    cv::cvtColor(frame, gray_, cv::COLOR_BGR2GRAY);
+  else
+    gray_ = frame;
+  // The buffer of two frames ago is free, so no frame allocates once running
+  std::swap(previous_, current_);
+  cv::resize(gray_, current_, size, 0, 0, cv::INTER_AREA);
+
+  if (previous_.size() != current_.size()) {
+    mask_ = cv::Mat(gridRows, gridCols_, CV_8U, cv::Scalar(255));
+    shift_ = cv::Point(0, 0);
+  } else {
+    shift_ = estimateShift();
+    std::pair<cv::Rect, cv::Rect> rois = overlap(size, shift_.x, shift_.y);
+    diff_.create(size, CV_8U);
+    diff_.setTo(cv::Scalar(0));
+    cv::absdiff(current_(rois.first), previous_(rois.second),
+    diff_(rois.first));
+    // Area resampling by exactly blockSize_ is the mean of every block
+    cv::resize(diff_, blockMeans_, cv::Size(gridCols_, gridRows), 0, 0,
+    cv::INTER_AREA);
+    cv::threshold(blockMeans_, mask_, threshold_, 255, cv::THRESH_BINARY);
+  }
+  changedBlocks_ = cv::countNonZero(mask_);
+  if (changedBlocks_ == 0 && shift_ == cv::Point(0, 0))
+    stats_.staticFrames++;
+  if (shift_ != cv::Point(0, 0))
+    stats_.shiftedFrames++;
+  stats_.changedBlockSum += static_cast<double>(changedBlocks_) / mask_.total();
+  stats_.gateMs += elapsedMs(start);
+}
+
+/**
+ * @brief Checks whether any block changed on the last frame
+ */
+bool MotionGate::sceneChanged() {
+  return changedBlocks_ > 0;
+}
+
+/**
+ * @brief Decides whether a scheduled detection runs
+ */
+bool MotionGate::allowDetection() {
+  if (sceneChanged()) {
+    stats_.detectionsAllowed++;
+    return true;
+  }
+  stats_.detectionsSkipped++;
+  return false;
+}
+
+/**
+ * @brief Decides whether the tracker updates
+ */
+bool MotionGate::allowTrackerUpdate() {
+  if (sceneChanged() || shift_ != cv::Point(0, 0)) {
+    stats_.trackerUpdatesAllowed++;
+    return true;
+  }
+  stats_.trackerUpdatesSkipped++;
+  return false;
+}
+
+/**
+ * @brief Gets the change mask of the last frame
+ */
+cv::Mat MotionGate::getChangeMask() {
+  return mask_;
+}
+
+/**
+ * @brief Gets the changed blocks of the last frame in frame coordinates,
+ *        neighbouring blocks of a row joined into one region
+ */
+std::vector<cv::Rect2d> MotionGate::getChangedRegions() {
+  std::vector<cv::Rect2d> regions;
+  if (mask_.empty())
+    return regions;
+  const double scaleX = static_cast<double>(frameSize_.width) / mask_.cols;
+  const double scaleY = static_cast<double>(frameSize_.height) / mask_.rows;
+  for (int y = 0; y < mask_.rows; ++y) {
+    const uchar *row = mask_.ptr<uchar>(y);
+    for (int x = 0; x < mask_.cols; ++x) {
+      if (!row[x])
+        continue;
+      int first = x;
+      while (x + 1 < mask_.cols && row[x + 1])
+        ++x;
+      regions.emplace_back(first * scaleX, y * scaleY,
+      (x - first + 1) * scaleX, scaleY);
+    }
+  }
+  return regions;
+}
+
+/**
+ * @brief Gets the global shift of the last frame in frame pixels
+ */
+cv::Point2d MotionGate::getGlobalShift() {
+  if (current_.empty())
+    return cv::Point2d(0, 0);
+  double scale = static_cast<double>(frameSize_.width) / current_.cols;
+  return cv::Point2d(shift_.x * scale, shift_.y * scale);
+}
+
+/**
+ * @brief Records the cost of a detection pass
+ */
+void MotionGate::recordDetection(double detectionMs) {
+  detectionMs_ = detectionMs_ > 0 ?
+  (1 - kSmoothing) * detectionMs_ + kSmoothing * detectionMs : detectionMs;
+}
+
+/**
+ * @brief Records the cost of a tracker update
+ */
+void MotionGate::recordTrackerUpdate(double trackerMs) {
+  trackerMs_ = trackerMs_ > 0 ?
+  (1 - kSmoothing) * trackerMs_ + kSmoothing * trackerMs : trackerMs;
+}
+
+/**
+ * @brief Gets the gate counters
+ */
+GateStats MotionGate::getStats() {
+  return stats_;
+}
+
+/**
+ * @brief Prints the skip rates and the estimated compute saved
+ */
+void MotionGate::printStats() {
+  auto percent = [](size_t part, size_t total) {
+    return total ? 100.0 * part / total : 0.0;
+  };
+  size_t detections = stats_.detectionsAllowed + stats_.detectionsSkipped;
+  size_t updates = stats_.trackerUpdatesAllowed + stats_.trackerUpdatesSkipped;
+  double savedMs = stats_.detectionsSkipped * detectionMs_ +
+  stats_.trackerUpdatesSkipped * trackerMs_;
+  std::cout << "Motion gate over " << stats_.frames << " frames: "
+  << percent(stats_.staticFrames, stats_.frames) << "% static, "
+  << percent(stats_.shiftedFrames, stats_.frames) << "% with camera motion, "
+  << (stats_.frames ? 100.0 * stats_.changedBlockSum / stats_.frames : 0)
+  << "% of blocks changed on average" << std::endl;
+  std::cout << "  skipped " << stats_.detectionsSkipped << " of " << detections
+  << " detections (" << percent(stats_.detectionsSkipped, detections)
+  << "%) and " << stats_.trackerUpdatesSkipped << " of " << updates
+  << " tracker updates (" << percent(stats_.trackerUpdatesSkipped, updates)
+  << "%), saved about " << savedMs << " ms for " << stats_.gateMs
+  << " ms spent in the gate" << std::endl;
+}
@@ -0,0 +1,427 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file Nms.cpp
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Nms Class implementation
+ * @version 0.1
+ * @date 2020-12-13
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <opencv2/core/hal/intrin.hpp>
+#include "../include/Nms.h"
+
+namespace {
+// Below this many candidates every kept box is compared, the grid does not pay
+const int kGridMinCandidates = 64;
+// Most cells along one side of the grid
+const int kMaxGridSide = 128;
+// Float IoU this far below the threshold is decided without the exact check
+const float kIouMargin = 1e-4f;
+// Coordinates up to this size are exact in float
+const int kExactFloatLimit = 1 << 22;
+
+/**
+ * @brief Overlap the way cv::dnn::NMSBoxes computes it
+ */
+float exactOverlap(const cv::Rect &a, const cv::Rect &b) {
+  return 1.f - static_cast<float>(cv::jaccardDistance(a, b));
+}
+
+/**
+ * @brief Distance IoU, the IoU less the squared distance of the centers over
+ *        the squared diagonal of the box enclosing both
+ */
+float distanceOverlap(const cv::Rect &a, const cv::Rect &b) {
+  double iou = 1.0 - cv::jaccardDistance(a, b);
+  double dx = (a.x + a.width / 2.0) - (b.x + b.width / 2.0);
+  double dy = (a.y + a.height / 2.0) - (b.y + b.height / 2.0);
+  double cw = std::max(a.x + a.width, b.x + b.width) - std::min(a.x, b.x);
+  double ch = std::max(a.y + a.height, b.y + b.height) - std::min(a.y, b.y);
+  double diagonal = cw * cw + ch * ch;
+  return static_cast<float>(diagonal > 0 ?
+  iou - (dx * dx + dy * dy) / diagonal : iou);
+}
+
+/**
+ * @brief First position from `from` whose float IoU with the box is above
+ *        floor, or count. Compares several boxes per SIMD instruction.
+ */
+int nextOverlap(const float *x1, const float *y1, const float *x2,
+const float *y2, const float *area, int from, int count, const float box[5],
+float floor) {
+  int k = from;
+#if CV_SIMD
+  const int lanes = cv::v_float32::nlanes;
+  const cv::v_float32 bx1 = cv::vx_setall_f32(box[0]);
+  const cv::v_float32 by1 = cv::vx_setall_f32(box[1]);
+  const cv::v_float32 bx2 = cv::vx_setall_f32(box[2]);
+  const cv::v_float32 by2 = cv::vx_setall_f32(box[3]);
+  const cv::v_float32 bArea = cv::vx_setall_f32(box[4]);
+  const cv::v_float32 zero = cv::vx_setzero_f32();
+  const cv::v_float32 vFloor = cv::vx_setall_f32(floor);
+  for (; k <= count - lanes; k += lanes) {
+    cv::v_float32 w = cv::v_max(cv::v_min(cv::vx_load(x2 + k), bx2) -
+    cv::v_max(cv::vx_load(x1 + k), bx1), zero);
+    cv::v_float32 h = cv::v_max(cv::v_min(cv::vx_load(y2 + k), by2) -
+    cv::v_max(cv::vx_load(y1 + k), by1), zero);
+    cv::v_float32 inter = w * h;
+    // iou > floor without the division, the union is positive
+    int mask = cv::v_signmask(inter > vFloor * (cv::vx_load(area + k) +
+    bArea - inter));
+    if (mask)
+      return k + __builtin_ctz(mask);
+  }
+#endif
+  for (; k < count; ++k) {
+    float w = std::max(std::min(x2[k], box[2]) - std::max(x1[k], box[0]), 0.f);
+    float h = std::max(std::min(y2[k], box[3]) - std::max(y1[k], box[1]), 0.f);
+    float inter = w * h;
+    if (inter > floor * (area[k] + box[4] - inter))
+      return k;
+  }
+  return count;
+}
+
+/**
+ * @brief Corners and area of a box for nextOverlap
+ */
+void corners(const cv::Rect &box, float out[5]) {
+  out[0] = static_cast<float>(box.x);
+  out[1] = static_cast<float>(box.y);
+  out[2] = static_cast<float>(box.x + box.width);
+  out[3] = static_cast<float>(box.y + box.height);
+  out[4] = static_cast<float>(box.area());
+}
+}  // namespace
+
+/**
+ * @brief Sets the method, soft-NMS sigma and output cap
+ */
+void Nms::setOptions(const NmsOptions &options) {
+  options_ = options;
+}
+
+/**
+ * @brief Gets the settings
+ */
+NmsOptions Nms::getOptions() {
+  return options_;
+}
+
+/**
+ * @brief Gets the score of every kept box
+ */
+const std::vector<float> &Nms::getKeptScores() {
+  return keptScores_;
+}
+
+/**
+ * @brief Parses a method name
+ */
+bool Nms::parseMethod(const std::string &name, NmsMethod &method) {
+  if (name == "greedy")
+    method = NmsMethod::GREEDY;
+  else if (name == "diou")
+    method = NmsMethod::DIOU;
+  else if (name == "soft-linear")
+    method = NmsMethod::SOFT_LINEAR;
+  else if (name == "soft-gaussian")
+    method = NmsMethod::SOFT_GAUSSIAN;
+  else
+    return false;
+  return true;
+}
+
+/**
+ * @brief Appends a box to the entry arrays
+ */
+void Nms::addEntry(const cv::Rect &box, int index) {
+  float c[5];
+  corners(box, c);
+  x1_.push_back(c[0]);
+  y1_.push_back(c[1]);
+  x2_.push_back(c[2]);
+  y2_.push_back(c[3]);
+  area_.push_back(c[4]);
+  entries_.push_back(index);
+}
+
+/**
+ * @brief Sizes the grid to the candidates and empties it
+ */
+void Nms::buildGrid(const std::vector<cv::Rect> &boxes) {
+  float minX = std::numeric_limits<float>::max(), minY = minX;
+  float maxX = std::numeric_limits<float>::lowest(), maxY = maxX;
+  double sumWidth = 0, sumHeight = 0;
+  for (const auto &candidate : order_) {
+    const cv::Rect &box = boxes[candidate.second];
+    minX = std::min(minX, static_cast<float>(box.x));
+    minY = std::min(minY, static_cast<float>(box.y));
+    maxX = std::max(maxX, static_cast<float>(box.x + box.width));
+    maxY = std::max(maxY, static_cast<float>(box.y + box.height));
+    sumWidth += box.width;
+    sumHeight += box.height;
+  }
+  // Cells of about the mean box size, so a box covers a few cells
+  const double n = static_cast<double>(order_.size());
+  originX_ = minX;
+  originY_ = minY;
+  cellWidth_ = std::max(1.f, static_cast<float>(sumWidth / n));
+  cellHeight_ = std::max(1.f, static_cast<float>(sumHeight / n));
+  gridCols_ = std::min(kMaxGridSide,
+  std::max(1, static_cast<int>(std::ceil((maxX - minX) / cellWidth_))));
+  gridRows_ = std::min(kMaxGridSide,
+  std::max(1, static_cast<int>(std::ceil((maxY - minY) / cellHeight_))));
+  cellWidth_ = std::max(cellWidth_, (maxX - minX) / gridCols_);
+  cellHeight_ = std::max(cellHeight_, (maxY - minY) / gridRows_);
+  const size_t cells = static_cast<size_t>(gridCols_) * gridRows_;
+  if (cells_.size() < cells)
+    cells_.resize(cells);
+  for (size_t i = 0; i < cells; ++i)
+    cells_[i].clear();
+}
+
+/**
+ * @brief Adds an entry to every cell its box covers
+ */
+void Nms::insert(int entry) {
+  const int c0 = std::min(gridCols_ - 1, std::max(0,
+  static_cast<int>((x1_[entry] - originX_) / cellWidth_)));
+  const int c1 = std::min(gridCols_ - 1, std::max(0,
+  static_cast<int>((x2_[entry] - originX_) / cellWidth_)));
+  const int r0 = std::min(gridRows_ - 1, std::max(0,
+  static_cast<int>((y1_[entry] - originY_) / cellHeight_)));
+  const int r1 = std::min(gridRows_ - 1, std::max(0,
+  static_cast<int>((y2_[entry] - originY_) / cellHeight_)));
+  for (int r = r0; r <= r1; ++r)
+    for (int c = c0; c <= c1; ++c)
+      cells_[static_cast<size_t>(r) * gridCols_ + c].push_back(entry);
+}
+
+/**
+ * @brief Copies the entries in the cells a box covers into the neighbour
+ *        arrays. Boxes that intersect share the cell of any common point.
+ */
+void Nms::gather(const cv::Rect &box, int stamp, bool liveOnly) {
+  nx1_.clear();
+  ny1_.clear();
+  nx2_.clear();
+  ny2_.clear();
+  nArea_.clear();
+  neighbours_.clear();
+  float c[5];
+  corners(box, c);
+  const int c0 = std::min(gridCols_ - 1, std::max(0,
+  static_cast<int>((c[0] - originX_) / cellWidth_)));
+  const int c1 = std::min(gridCols_ - 1, std::max(0,
+  static_cast<int>((c[2] - originX_) / cellWidth_)));
+  const int r0 = std::min(gridRows_ - 1, std::max(0,
+  static_cast<int>((c[1] - originY_) / cellHeight_)));
+  const int r1 = std::min(gridRows_ - 1, std::max(0,
+  static_cast<int>((c[3] - originY_) / cellHeight_)));
+  for (int r = r0; r <= r1; ++r)
+    for (int col = c0; col <= c1; ++col)
+      for (int entry : cells_[static_cast<size_t>(r) * gridCols_ + col]) {
+        if (visited_[entry] == stamp || (liveOnly && !alive_[entry]))
+          continue;
+        visited_[entry] = stamp;
+        nx1_.push_back(x1_[entry]);
+        ny1_.push_back(y1_[entry]);
+        nx2_.push_back(x2_[entry]);
+        ny2_.push_back(y2_[entry]);
+        nArea_.push_back(area_[entry]);
+        neighbours_.push_back(entry);
+      }
+}
+
+/**
+ * @brief Suppresses overlapping boxes
+ */
+void Nms::run(const std::vector<cv::Rect> &boxes,
+const std::vector<float> &scores, float scoreThreshold, float nmsThreshold,
+std::vector<int> &indices) {
+  indices.clear();
+  keptScores_.clear();
+  x1_.clear();
+  y1_.clear();
+  x2_.clear();
+  y2_.clear();
+  area_.clear();
+  entries_.clear();
+  // Same candidates and order as NMSBoxes, ties keep the input order
+  order_.clear();
+  for (size_t i = 0; i < scores.size() && i < boxes.size(); ++i)
+    if (scores[i] > scoreThreshold)
+      order_.emplace_back(scores[i], static_cast<int>(i));
+  std::stable_sort(order_.begin(), order_.end(),
+  [](const std::pair<float, int> &a, const std::pair<float, int> &b) {
+    return a.first > b.first;
+  });
+  if (order_.empty())
+    return;
+  visited_.assign(order_.size(), -1);
+  if (options_.method == NmsMethod::SOFT_LINEAR ||
+  options_.method == NmsMethod::SOFT_GAUSSIAN)
+    runSoft(boxes, scoreThreshold, nmsThreshold, indices);
+  else
+    runGreedy(boxes, nmsThreshold, indices);
+}
+
+/**
+ * @brief Greedy suppression, by IoU or DIoU
+ */
+void Nms::runGreedy(const std::vector<cv::Rect> &boxes, float nmsThreshold,
+std::vector<int> &indices) {
+  const bool diou = options_.method == NmsMethod::DIOU;
+  // Empty boxes overlap everything in NMSBoxes, a negative threshold
+  // suppresses disjoint boxes and huge coordinates are not exact in float.
+  // Those compare every pair exactly.
+  bool exact = nmsThreshold < 0;
+  for (size_t c = 0; c < order_.size() && !exact; ++c) {
+    const cv::Rect &box = boxes[order_[c].second];
+    exact = box.width <= 0 || box.height <= 0 ||
+    std::abs(box.x) > kExactFloatLimit || std::abs(box.y) > kExactFloatLimit ||
+    box.width > kExactFloatLimit || box.height > kExactFloatLimit;
+  }
+  const bool useGrid = !exact &&
+  static_cast<int>(order_.size()) >= kGridMinCandidates;
+  if (useGrid)
+    buildGrid(boxes);
+  // DIoU never exceeds IoU, so the same IoU filter applies
+  const float floor = nmsThreshold - kIouMargin;
+  float c[5];
+  for (size_t n = 0; n < order_.size(); ++n) {
+    const int idx = order_[n].second;
+    const cv::Rect &box = boxes[idx];
+    corners(box, c);
+    const float *x1 = x1_.data(), *y1 = y1_.data(), *x2 = x2_.data(),
+    *y2 = y2_.data(), *area = area_.data();
+    const int *ids = nullptr;
+    int count = static_cast<int>(entries_.size());
+    if (useGrid) {
+      gather(box, static_cast<int>(n), false);
+      x1 = nx1_.data();
+      y1 = ny1_.data();
+      x2 = nx2_.data();
+      y2 = ny2_.data();
+      area = nArea_.data();
+      ids = neighbours_.data();
+      count = static_cast<int>(neighbours_.size());
+    }
+    bool keep = true;
+    int k = exact ? 0 : nextOverlap(x1, y1, x2, y2, area, 0, count, c, floor);
+    while (k < count) {
+      const cv::Rect &other = boxes[entries_[ids ? ids[k] : k]];
+      float overlap = diou ? distanceOverlap(box, other) :
+      exactOverlap(box, other);
+      if (overlap > nmsThreshold) {
+        keep = false;
+        break;
+      }
+      k = exact ? k + 1 :
+      nextOverlap(x1, y1, x2, y2, area, k + 1, count, c, floor);
+    }
+    if (!keep)
+      continue;
+    indices.push_back(idx);
+    keptScores_.push_back(order_[n].first);
+    addEntry(box, idx);
+    if (useGrid)
+      insert(static_cast<int>(entries_.size()) - 1);
+    if (options_.maxDetections > 0 &&
+    static_cast<int>(indices.size()) >= options_.maxDetections)
+      break;
+  }
+}
+
+/**
+ * @brief Soft suppression. The best live box is kept and the scores of the
+ *        boxes it overlaps decay; boxes that fall to the threshold are dropped.
+ */
+void Nms::runSoft(const std::vector<cv::Rect> &boxes, float scoreThreshold,
+float nmsThreshold, std::vector<int> &indices) {
+  const bool linear = options_.method == NmsMethod::SOFT_LINEAR;
+  const int n = static_cast<int>(order_.size());
+  scores_.resize(n);
+  alive_.assign(n, 1);
+  for (int pos = 0; pos < n; ++pos) {
+    addEntry(boxes[order_[pos].second], order_[pos].second);
+    scores_[pos] = order_[pos].first;
+  }
+  const bool useGrid = n >= kGridMinCandidates;
+  if (useGrid) {
+    buildGrid(boxes);
+    for (int pos = 0; pos < n; ++pos)
+      insert(pos);
+  }
+  // Highest score first, the earlier candidate on ties
+  auto lower = [](const std::pair<float, int> &a,
+  const std::pair<float, int> &b) {
+    return a.first < b.first || (a.first == b.first && a.second > b.second);
+  };
+  heap_.clear();
+  for (int pos = 0; pos < n; ++pos)
+    heap_.emplace_back(scores_[pos], pos);
+  std::make_heap(heap_.begin(), heap_.end(), lower);
+  // Linear decay only touches boxes above the threshold, Gaussian any overlap
+  const float floor = linear ? std::max(0.f, nmsThreshold - kIouMargin) : 0.f;
+  float c[5];
+  while (!heap_.empty()) {
+    std::pop_heap(heap_.begin(), heap_.end(), lower);
+    const std::pair<float, int> top = heap_.back();
+    heap_.pop_back();
+    const int pos = top.second;
+    // Entries left behind by a decay are stale
+    if (!alive_[pos] || scores_[pos] != top.first)
+      continue;
+    alive_[pos] = 0;
+    const cv::Rect &box = boxes[entries_[pos]];
+    indices.push_back(entries_[pos]);
+    keptScores_.push_back(scores_[pos]);
+    if (options_.maxDetections > 0 &&
+    static_cast<int>(indices.size()) >= options_.maxDetections)
+      break;
+    corners(box, c);
+    const float *x1 = x1_.data(), *y1 = y1_.data(), *x2 = x2_.data(),
+    *y2 = y2_.data(), *area = area_.data();
+    const int *ids = nullptr;
+    int count = n;
+    if (useGrid) {
+      gather(box, pos, true);
+      x1 = nx1_.data();
+      y1 = ny1_.data();
+      x2 = nx2_.data();
+      y2 = ny2_.data();
+      area = nArea_.data();
+      ids = neighbours_.data();
+      count = static_cast<int>(neighbours_.size());
+    }
+    for (int k = nextOverlap(x1, y1, x2, y2, area, 0, count, c, floor);
+    k < count; k = nextOverlap(x1, y1, x2, y2, area, k + 1, count, c, floor)) {
+      const int other = ids ? ids[k] : k;
+      if (!alive_[other])
+        continue;
+      float iou = exactOverlap(box, boxes[entries_[other]]);
+      float weight = 1.f;
+      if (linear && iou > nmsThreshold)
+        weight = 1.f - iou;
+      else if (!linear)
+        weight = std::exp(-iou * iou / options_.sigma);
+      if (weight == 1.f)
+        continue;
+      scores_[other] *= weight;
+      if (scores_[other] <= scoreThreshold) {
+        alive_[other] = 0;
+        continue;
+      }
+      heap_.emplace_back(scores_[other], other);
+      std::push_heap(heap_.begin(), heap_.end(), lower);
+    }
+  }
+}
@@ -0,0 +1,312 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file OfflineProcessor.cpp
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief OfflineProcessor Class implementation
+ * @version 0.1
+ * @date 2020-12-08
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/videoio.hpp>
+#include "../include/OfflineProcessor.h"
+#include "../include/Detection.h"
+#include "../include/Track.h"
+
+namespace {
+/**
+ * @brief Milliseconds since start
+ */
+double elapsedMs(const std::chrono::steady_clock::time_point &start) {
+  return std::chrono::duration<double, std::milli>
+  (std::chrono::steady_clock::now() - start).count();
+}
+}  // namespace
+
+/**
+ * @brief Sets the number of worker threads
+ */
+void OfflineProcessor::setNumWorkers(int numWorkers) {
+  numWorkers_ = std::max(0, numWorkers);
+}
+
+/**
+ * @brief Sets the keyframe interval of the input
+ */
+void OfflineProcessor::setKeyframeInterval(int keyframeInterval) {
+  keyframeInterval_ = std::max(1, keyframeInterval);
+}
+
+/**
+ * @brief Sets the frames a segment is tracked before its start
+ */
+void OfflineProcessor::setOverlap(int overlap) {
+  overlap_ = std::max(0, overlap);
+}
+
+/**
+ * @brief Sets the frames between two detections
+ */
+void OfflineProcessor::setDetectionInterval(int detectionInterval) {
+  detectionInterval_ = std::max(1, detectionInterval);
+}
+
+/**
+ * @brief Sets the model and the non maximum suppression of the workers
+ */
+void OfflineProcessor::setModelConfig(ModelProfile profile,
+const NmsOptions &nmsOptions, bool letterbox) {
+  profile_ = profile;
+  nmsOptions_ = nmsOptions;
+  letterbox_ = letterbox;
+}
+
+/**
+ * @brief Cuts a video into segments aligned to the keyframe interval
+ */
+std::vector<cv::Range> OfflineProcessor::planSegments(int frameCount,
+int numWorkers, int keyframeInterval) {
+  std::vector<cv::Range> segments;
+  if (frameCount <= 0)
+    return segments;
+  keyframeInterval = std::max(1, keyframeInterval);
+  // Two segments per worker even out segments with more people in them
+  int wanted = std::max(1, 2 * numWorkers);
+  int length = (frameCount + wanted - 1) / wanted;
+  length = (length + keyframeInterval - 1) / keyframeInterval *
+  keyframeInterval;
+  for (int start = 0; start < frameCount; start += length)
+    segments.emplace_back(start, std::min(frameCount, start + length));
+  return segments;
+}
+
+/**
+ * @brief Matches the tracks of a segment to the tracks of the previous one
+ */
+std::map<int, int> OfflineProcessor::stitchIds(
+const std::vector<TrackRecord> &previous,
+const std::vector<TrackRecord> &current, cv::Range overlap, double minIou) {
+  std::map<int, int> stitched;
+  // Boxes of every ID on every overlap frame
+  std::map<int, std::map<int, cv::Rect2d>> before, after;
+  for (const auto &record : previous)
+    if (record.frame >= overlap.start && record.frame < overlap.end)
+      before[record.id][record.frame] = record.box;
+  for (const auto &record : current)
+    if (record.frame >= overlap.start && record.frame < overlap.end)
+      after[record.id][record.frame] = record.box;
+  if (before.empty() || after.empty())
+    return stitched;
+
+  std::vector<int> rows, cols;
+  for (const auto &track : after)
+    rows.push_back(track.first);
+  for (const auto &track : before)
+    cols.push_back(track.first);
+  // Mean IoU over the frames either track exists, so a track that is
+  // only briefly near another one is not matched to it
+  std::vector<std::vector<double>> cost(rows.size(),
+  std::vector<double>(cols.size(), 1.0));
+  for (size_t r = 0; r < rows.size(); ++r) {
+    const auto &mine = after[rows[r]];
+    for (size_t c = 0; c < cols.size(); ++c) {
+      const auto &theirs = before[cols[c]];
+      double sum = 0;
+      size_t frames = theirs.size();
+      for (const auto &box : mine) {
+        auto other = theirs.find(box.first);
+        if (other == theirs.end())
+          ++frames;
+        else
+          sum += Track::iou(box.second, other->second);
+      }
+      cost[r][c] = 1.0 - sum / frames;
+    }
+  }
+  std::vector<int> assignment = Track::solveAssignment(cost);
+  for (size_t r = 0; r < rows.size(); ++r)
+    if (assignment[r] >= 0 && 1.0 - cost[r][assignment[r]] >= minIou)
+      stitched[rows[r]] = cols[assignment[r]];
+  return stitched;
+}
+
+/**
+ * @brief Detects and tracks one segment, starting the tracker early
+ */
+std::vector<TrackRecord> OfflineProcessor::trackSegment(Detection &detection,
+const std::string &video, cv::Range segment, bool last) {
+  std::vector<TrackRecord> records;
+  cv::VideoCapture capture(video);
+  if (!capture.isOpened())
+    return records;
+  const int first = std::max(0, segment.start - overlap_);
+  // Seek to the keyframe at or before the overlap and skip up to it
+  // without decoding into a frame or tracking
+  const int keyframe = first / keyframeInterval_ * keyframeInterval_;
+  if (keyframe > 0)
+    capture.set(cv::CAP_PROP_POS_FRAMES, keyframe);
+  for (int index = keyframe; index < first; ++index)
+    if (!capture.grab())
+      return records;
+  Track tracker;
+  tracker.setTrackerMode(TrackerMode::SORT);
+  tracker.initializeTracker();
+  cv::Mat frame;
+  for (int index = first; last || index < segment.end; ++index) {
+    if (!capture.read(frame))
+      break;
+    tracker.setFrame(frame);
+    // The first frame of the overlap is detected so tracks exist at once
+    if (index == first || index % detectionInterval_ == 0) {
+      detection.setFrame(frame);
+      tracker.runTrackerAlgorithm(detection.processFrameforHuman());
+    } else {
+      tracker.updateTracker();
+    }
+    std::vector<cv::Rect2d> boxes = tracker.getTrackedBoxes();
+    std::vector<int> ids = tracker.getTrackIds();
+    for (size_t i = 0; i < boxes.size(); ++i)
+      records.push_back({index, ids[i], boxes[i]});
+  }
+  return records;
+}
+
+/**
+ * @brief Processes a video and writes the annotated video and the log
+ */
+bool OfflineProcessor::process(const std::string &video,
+const std::string &outputVideo, const std::string &logFile) {
+  stats_ = OfflineStats();
+  cv::VideoCapture capture(video);
+  if (!capture.isOpened()) {
+    std::cout << "Could not open the input video " << video << std::endl;
+    return false;
+  }
+  const int frameCount = static_cast<int>(
+  capture.get(cv::CAP_PROP_FRAME_COUNT));
+  const cv::Size frameSize(
+  static_cast<int>(capture.get(cv::CAP_PROP_FRAME_WIDTH)),
+  static_cast<int>(capture.get(cv::CAP_PROP_FRAME_HEIGHT)));
+  capture.release();
+  int workers = numWorkers_ > 0 ? numWorkers_ :
+  static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+  std::vector<cv::Range> segments = planSegments(std::max(1, frameCount),
+  workers, keyframeInterval_);
+  workers = std::min(workers, static_cast<int>(segments.size()));
+  stats_.segments = static_cast<int>(segments.size());
+  stats_.workers = workers;
+
+  // Every worker runs its own network on one core, OpenCV's own threads
+  // would only compete with the other workers
+  auto start = std::chrono::steady_clock::now();
+  const int openCvThreads = cv::getNumThreads();
+  cv::setNumThreads(1);
+  std::vector<std::vector<TrackRecord>> results(segments.size());
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> threads;
+  for (int w = 0; w < workers; ++w) {
+    threads.emplace_back([&]() {
+      // The network is loaded once per worker, not once per segment
+      Detection detection;
+      if (profile_ != ModelProfile::YOLOV4)
+        detection.setModelProfile(profile_);
+      detection.setLetterbox(letterbox_);
+      detection.setNmsOptions(nmsOptions_);
+      for (size_t s = next++; s < segments.size(); s = next++)
+        results[s] = trackSegment(detection, video, segments[s],
+        s + 1 == segments.size());
+    });
+  }
+  for (auto &thread : threads)
+    thread.join();
+  cv::setNumThreads(openCvThreads);
+  stats_.trackingMs = elapsedMs(start);
+
+  // Stitch segment by segment, keeping only the frames a segment owns
+  start = std::chrono::steady_clock::now();
+  std::vector<TrackRecord> merged;
+  std::vector<TrackRecord> previous;
+  int nextId = 1;
+  for (size_t s = 0; s < segments.size(); ++s) {
+    cv::Range overlap(std::max(0, segments[s].start - overlap_),
+    segments[s].start);
+    std::map<int, int> ids = stitchIds(previous, results[s], overlap,
+    stitchIou_);
+    std::vector<TrackRecord> owned;
+    for (auto record : results[s]) {
+      if (record.frame < segments[s].start)
+        continue;
+      auto id = ids.find(record.id);
+      if (id == ids.end())
+        id = ids.emplace(record.id, nextId++).first;
+      record.id = id->second;
+      owned.push_back(record);
+    }
+    merged.insert(merged.end(), owned.begin(), owned.end());
+    previous.swap(owned);
+  }
+  stats_.tracks = nextId - 1;
+  stats_.stitchingMs = elapsedMs(start);
+
+  // Writing one video is sequential, so it is done once at the end
+  start = std::chrono::steady_clock::now();
+  std::ofstream log(logFile);
+  log << "frame,id,x,y,width,height\n";
+  for (const auto &record : merged)
+    log << record.frame << "," << record.id << "," << record.box.x << ","
+    << record.box.y << "," << record.box.width << "," << record.box.height
+    << "\n";
+  capture.open(video);
+  cv::VideoWriter writer(outputVideo,
+  cv::VideoWriter::fourcc('M', 'J', 'P', 'G'), 28, frameSize);
+  cv::Mat frame;
+  size_t record = 0;
+  for (int index = 0; capture.read(frame); ++index) {
+    for (; record < merged.size() && merged[record].frame == index; ++record) {
+      const TrackRecord &track = merged[record];
+      cv::rectangle(frame, track.box, cv::Scalar(255, 0, 0), 2, 8);
+      cv::putText(frame, "ID " + std::to_string(track.id),
+      cv::Point(track.box.x, track.box.y), cv::FONT_HERSHEY_SIMPLEX, 0.75,
+      cv::Scalar(0, 0, 0), 1);
+    }
+    writer.write(frame);
+    stats_.frames++;
+  }
+  stats_.renderingMs = elapsedMs(start);
+  std::cout << "Output file is stored as " << outputVideo
+  << ", detection log as " << logFile << std::endl;
+  return true;
+}
+
+/**
+ * @brief Gets the counters of the last run
+ */
+OfflineStats OfflineProcessor::getStats() {
+  return stats_;
+}
+
+/**
+ * @brief Prints the counters of the last run
+ */
+void OfflineProcessor::printStats() {
+  double totalMs = stats_.trackingMs + stats_.stitchingMs +
+  stats_.renderingMs;
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "Offline run: " << stats_.frames << " frames in "
+  << stats_.segments << " segments on " << stats_.workers << " workers, "
+  << stats_.tracks << " tracks" << std::endl;
+  std::cout << "  tracking " << stats_.trackingMs << " ms, stitching "
+  << stats_.stitchingMs << " ms, rendering " << stats_.renderingMs
+  << " ms, " << (totalMs > 0 ? stats_.frames * 1000.0 / totalMs : 0)
+  << " fps" << std::endl;
+}
@@ -0,0 +1,434 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file Pipeline.cpp
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Pipeline Class implementation
+ * @version 0.1
+ * @date 2020-11-20
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include "../include/Pipeline.h"
+#include "../include/Profiler.h"
+
+namespace {
+/**
+ * @brief Milliseconds elapsed since start
+ */
+double elapsedMs(const std::chrono::steady_clock::time_point &start) {
+  return std::chrono::duration<double, std::milli>
+  (std::chrono::steady_clock::now() - start).count();
+}
+}  // namespace
+
+/**
+ * @brief Pipeline constructor.
+ */
+Pipeline::Pipeline(Detection &detection, Track &tracker,
+size_t queueCapacity) : detection_(detection), tracker_(tracker),
+queueCapacity_(queueCapacity) {
+}
+
+/**
+ * @brief Sets the number of frames between two detection passes
+ */
+void Pipeline::setDetectionInterval(int interval) {
+  detectionInterval_ = interval > 0 ? interval : 1;
+}
+
+/**
+ * @brief Lets an adaptive policy decide which frames get a detection pass
+ */
+void Pipeline::setDetectionPolicy(DetectionPolicy *policy) {
+  policy_ = policy;
+}
+
+/**
+ * @brief Feeds the last inference time to the policy and asks it about this frame
+ */
+bool Pipeline::policyWantsDetection(const cv::Mat &frame) {
+  double inferenceMs = inferenceMs_.exchange(0);
+  if (inferenceMs > 0)
+    policy_->recordDetection(inferenceMs);
+  return policy_->shouldDetect(frame, activeTracks_, lostTracks_);
+}
+
+/**
+ * @brief Reads frames and dispatches them to the tracker and inference queues
+ */
+void Pipeline::decodeStage(cv::VideoCapture &capture, FramePool &pool,
+BoundedQueue<PipelineFrame> &trackQueue,
+BoundedQueue<PipelineFrame> &inferQueue, StageStats &stats) {
+  auto start = std::chrono::steady_clock::now();
+  int frameNumber = 1;
+  while (true) {
+    // A recycled buffer per frame, later stages still own the previous ones
+    PipelineFrame item;
+    item.buffer = pool.acquire();
+    auto busyStart = std::chrono::steady_clock::now();
+    {
+      ScopedTimer timer(Stage::DECODE);
+      capture >> item.buffer.mat();
+    }
+    if (item.buffer.mat().empty())
+      break;
+    item.frame = item.buffer.mat();
+    frameNumber++;
+    item.frameNumber = frameNumber;
+    item.runDetection = policy_ ? policyWantsDetection(item.frame) :
+    frameNumber % detectionInterval_ == 0;
+    stats.busyMs += elapsedMs(busyStart);
+    stats.frames++;
+    // Inference is dispatched first so it runs ahead of the tracker
+    if (item.runDetection && !inferQueue.push(item))
+      break;
+    if (!trackQueue.push(item))
+      break;
+  }
+  inferQueue.close();
+  trackQueue.close();
+  stats.wallMs = elapsedMs(start);
+}
+
+/**
+ * @brief Runs YOLO on every frame it receives
+ */
+void Pipeline::inferenceStage(BoundedQueue<PipelineFrame> &inferQueue,
+BoundedQueue<PipelineResult> &resultQueue, StageStats &stats) {
+  auto start = std::chrono::steady_clock::now();
+  PipelineFrame item;
+  while (inferQueue.pop(item)) {
+    auto busyStart = std::chrono::steady_clock::now();
+    PipelineResult result;
+    result.frameNumber = item.frameNumber;
+    detection_.setFrame(item.frame);
+    result.detections = detection_.processFrameforHuman();
+    inferenceMs_ = elapsedMs(busyStart);
+    stats.busyMs += elapsedMs(busyStart);
+    stats.frames++;
+    if (!resultQueue.push(result))
+      break;
+  }
+  inferQueue.close();
+  resultQueue.close();
+  stats.wallMs = elapsedMs(start);
+}
+
+/**
+ * @brief Updates the tracker on every frame and merges detections back in frame order
+ */
+void Pipeline::trackStage(BoundedQueue<PipelineFrame> &trackQueue,
+BoundedQueue<PipelineResult> &resultQueue,
+BoundedQueue<PipelineFrame> &encodeQueue, StageStats &stats) {
+  auto start = std::chrono::steady_clock::now();
+  PipelineFrame item;
+  while (trackQueue.pop(item)) {
+    PipelineResult result;
+    // Results arrive in the same order as the detection frames,
+    // so the head of the queue always belongs to this frame
+    bool hasResult = item.runDetection && resultQueue.pop(result);
+    auto busyStart = std::chrono::steady_clock::now();
+    tracker_.setFrame(item.frame);
+    if (hasResult)
+      tracker_.runTrackerAlgorithm(result.detections);
+    else
+      tracker_.updateTracker();
+    activeTracks_ = static_cast<int>(tracker_.getTrackTable().size());
+    lostTracks_ = tracker_.getLostCount();
+    item.frame = tracker_.drawGreenBoundingBox();
+    stats.busyMs += elapsedMs(busyStart);
+    stats.frames++;
+    if (!encodeQueue.push(item))
+      break;
+  }
+  trackQueue.close();
+  resultQueue.close();
+  encodeQueue.close();
+  stats.wallMs = elapsedMs(start);
+}
+
+/**
+ * @brief Hands annotated frames to the output sink
+ */
+void Pipeline::encodeStage(BoundedQueue<PipelineFrame> &encodeQueue,
+const std::function<void(const cv::Mat &)> &sink, StageStats &stats) {
+  auto start = std::chrono::steady_clock::now();
+  PipelineFrame item;
+  cv::Mat finalFrame;
+  while (encodeQueue.pop(item)) {
+    auto busyStart = std::chrono::steady_clock::now();
+    if (item.frame.depth() != CV_8U) {
+      item.frame.convertTo(finalFrame, CV_8U);
+      sink(finalFrame);
+    } else {
+      sink(item.frame);
+    }
+    stats.busyMs += elapsedMs(busyStart);
+    stats.frames++;
+  }
+  encodeQueue.close();
+  stats.wallMs = elapsedMs(start);
+}
+
+/**
+ * @brief Processes the whole stream on four threads
+ */
+int Pipeline::run(cv::VideoCapture &capture,
+const std::function<void(const cv::Mat &)> &sink) {
+  tracker_.initializeTracker();
+  activeTracks_ = 0;
+  lostTracks_ = 0;
+  inferenceMs_ = 0;
+  // Enough buffers for full frame queues and one frame in every stage
+  FramePool pool(2 * queueCapacity_ + 8);
+  BoundedQueue<PipelineFrame> trackQueue(queueCapacity_);
+  BoundedQueue<PipelineFrame> inferQueue(2);
+  BoundedQueue<PipelineResult> resultQueue(2);
+  BoundedQueue<PipelineFrame> encodeQueue(queueCapacity_);
+
+  stageStats_.assign(4, StageStats());
+  stageStats_[0].name = "decode";
+  stageStats_[1].name = "inference";
+  stageStats_[2].name = "track";
+  stageStats_[3].name = "encode";
+
+  std::thread decoder(&Pipeline::decodeStage, this, std::ref(capture),
+  std::ref(pool), std::ref(trackQueue), std::ref(inferQueue),
+  std::ref(stageStats_[0]));
+  std::thread inference(&Pipeline::inferenceStage, this,
+  std::ref(inferQueue), std::ref(resultQueue), std::ref(stageStats_[1]));
+  std::thread trackerThread(&Pipeline::trackStage, this,
+  std::ref(trackQueue), std::ref(resultQueue), std::ref(encodeQueue),
+  std::ref(stageStats_[2]));
+  std::thread encoder(&Pipeline::encodeStage, this, std::ref(encodeQueue),
+  std::cref(sink), std::ref(stageStats_[3]));
+  decoder.join();
+  inference.join();
+  trackerThread.join();
+  encoder.join();
+
+  queueStats_.clear();
+  const BoundedQueue<PipelineFrame> *frameQueues[] =
+  {&trackQueue, &inferQueue, &encodeQueue};
+  const char *frameQueueNames[] = {"decode->track", "decode->inference",
+  "track->encode"};
+  for (int i = 0; i < 3; ++i) {
+    QueueStats queue;
+    queue.name = frameQueueNames[i];
+    queue.capacity = frameQueues[i]->getCapacity();
+    queue.maxDepth = frameQueues[i]->getMaxDepth();
+    queue.averageDepth = frameQueues[i]->getAverageDepth();
+    queueStats_.push_back(queue);
+  }
+  QueueStats results;
+  results.name = "inference->track";
+  results.capacity = resultQueue.getCapacity();
+  results.maxDepth = resultQueue.getMaxDepth();
+  results.averageDepth = resultQueue.getAverageDepth();
+  queueStats_.push_back(results);
+
+  return static_cast<int>(stageStats_[3].frames);
+}
+
+/**
+ * @brief Processes a live stream under a latency budget, always on the newest frame
+ */
+int Pipeline::runRealtime(cv::VideoCapture &capture,
+const std::function<void(const cv::Mat &)> &sink, double latencyBudgetMs) {
+  tracker_.initializeTracker();
+  activeTracks_ = 0;
+  lostTracks_ = 0;
+  inferenceMs_ = 0;
+  realtimeStats_ = RealtimeStats();
+  realtimeStats_.latencyBudgetMs = latencyBudgetMs;
+  FramePool pool(8);
+  LatestSlot<PipelineFrame> frameSlot;
+  LatestSlot<PipelineFrame> requestSlot;
+  LatestSlot<PipelineResult> resultSlot;
+  std::atomic<bool> inferenceBusy(false);
+  std::atomic<size_t> captured(0);
+  std::atomic<size_t> dropped(0);
+
+  std::thread grabber([&] {
+    double fps = capture.get(cv::CAP_PROP_FPS);
+    auto start = std::chrono::steady_clock::now();
+    int frameNumber = 1;
+    while (true) {
+      PipelineFrame item;
+      item.buffer = pool.acquire();
+      {
+        ScopedTimer timer(Stage::DECODE);
+        capture >> item.buffer.mat();
+      }
+      if (item.buffer.mat().empty())
+        break;
+      item.frame = item.buffer.mat();
+      frameNumber++;
+      item.frameNumber = frameNumber;
+      // Recorded files are paced to their frame rate, a camera blocks in read anyway
+      if (fps > 0)
+        std::this_thread::sleep_until(start +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>
+        (std::chrono::duration<double>((frameNumber - 1) / fps)));
+      item.captureTime = std::chrono::steady_clock::now();
+      captured++;
+      if (frameSlot.put(item))
+        dropped++;
+    }
+    frameSlot.close();
+  });
+
+  std::thread inference([&] {
+    PipelineFrame item;
+    while (requestSlot.take(item)) {
+      PipelineResult result;
+      result.frameNumber = item.frameNumber;
+      auto inferenceStart = std::chrono::steady_clock::now();
+      detection_.setFrame(item.frame);
+      result.detections = detection_.processFrameforHuman();
+      inferenceMs_ = elapsedMs(inferenceStart);
+      resultSlot.put(result);
+      inferenceBusy = false;
+    }
+  });
+
+  bool detectionPending = true;
+  int framesSinceDetection = 0;
+  double latencySum = 0;
+  cv::Mat finalFrame;
+  PipelineFrame item;
+  while (frameSlot.take(item)) {
+    if (elapsedMs(item.captureTime) > latencyBudgetMs) {
+      realtimeStats_.stale++;
+      continue;
+    }
+    tracker_.setFrame(item.frame);
+    PipelineResult result;
+    if (resultSlot.tryTake(result)) {
+      // The detections belong to an older frame, they re-seed the
+      // tracker on the newest one
+      tracker_.runTrackerAlgorithm(result.detections);
+    } else {
+      tracker_.updateTracker();
+    }
+    activeTracks_ = static_cast<int>(tracker_.getTrackTable().size());
+    lostTracks_ = tracker_.getLostCount();
+    bool due = policy_ ? policyWantsDetection(item.frame) :
+    ++framesSinceDetection >= detectionInterval_;
+    if (due) {
+      if (detectionPending)
+        realtimeStats_.coalesced++;
+      detectionPending = true;
+      framesSinceDetection = 0;
+    }
+    if (detectionPending && !inferenceBusy) {
+      inferenceBusy = true;
+      PipelineFrame request;
+      request.frameNumber = item.frameNumber;
+      // Detection draws on its frame, keep it away from the output frame
+      request.buffer = pool.acquire();
+      item.frame.copyTo(request.buffer.mat());
+      request.frame = request.buffer.mat();
+      requestSlot.put(request);
+      detectionPending = false;
+      realtimeStats_.detections++;
+    }
+    cv::Mat annotated = tracker_.drawGreenBoundingBox();
+    if (annotated.depth() != CV_8U) {
+      annotated.convertTo(finalFrame, CV_8U);
+      sink(finalFrame);
+    } else {
+      sink(annotated);
+    }
+    double latencyMs = elapsedMs(item.captureTime);
+    latencySum += latencyMs;
+    if (latencyMs > realtimeStats_.maxLatencyMs)
+      realtimeStats_.maxLatencyMs = latencyMs;
+    if (latencyMs > latencyBudgetMs)
+      realtimeStats_.overBudget++;
+    realtimeStats_.processed++;
+  }
+  requestSlot.close();
+  inference.join();
+  grabber.join();
+
+  realtimeStats_.captured = captured;
+  realtimeStats_.dropped = dropped;
+  if (realtimeStats_.processed)
+    realtimeStats_.averageLatencyMs = latencySum / realtimeStats_.processed;
+  return static_cast<int>(realtimeStats_.processed);
+}
+
+/**
+ * @brief Gets the counters of the last real-time run
+ */
+RealtimeStats Pipeline::getRealtimeStats() {
+  return realtimeStats_;
+}
+
+/**
+ * @brief Prints the counters of the last real-time run
+ */
+void Pipeline::printRealtimeStats() {
+  const RealtimeStats &stats = realtimeStats_;
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "Real-time mode, latency budget " << stats.latencyBudgetMs
+  << " ms" << std::endl;
+  std::cout << "  captured " << stats.captured << ", processed "
+  << stats.processed << ", dropped " << stats.dropped << ", stale "
+  << stats.stale << std::endl;
+  std::cout << "  detections run " << stats.detections << ", coalesced "
+  << stats.coalesced << std::endl;
+  std::cout << "  latency avg " << stats.averageLatencyMs << " ms, max "
+  << stats.maxLatencyMs << " ms, over budget " << stats.overBudget
+  << std::endl;
+  std::cout << std::defaultfloat;
+}
+
+/**
+ * @brief Gets the stage counters of the last run
+ */
+std::vector<StageStats> Pipeline::getStageStats() {
+  return stageStats_;
+}
+
+/**
+ * @brief Gets the queue counters of the last run
+ */
+std::vector<QueueStats> Pipeline::getQueueStats() {
+  return queueStats_;
+}
+
+/**
+ * @brief Prints per-stage throughput and queue depth of the last run
+ */
+void Pipeline::printStats() {
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "Stage        frames      fps   busy ms/frame   utilization"
+  << std::endl;
+  for (const auto &stage : stageStats_) {
+    double fps = stage.wallMs > 0 ? stage.frames * 1000.0 / stage.wallMs : 0;
+    double perFrame = stage.frames ? stage.busyMs / stage.frames : 0;
+    double utilization = stage.wallMs > 0 ? 100.0 * stage.busyMs / stage.wallMs
+    : 0;
+    std::cout << std::left << std::setw(12) << stage.name << std::right
+    << std::setw(7) << stage.frames << std::setw(9) << fps
+    << std::setw(16) << perFrame << std::setw(13) << utilization << "%"
+    << std::endl;
+  }
+  std::cout << "Queue               capacity   max depth   avg depth"
+  << std::endl;
+  for (const auto &queue : queueStats_) {
+    std::cout << std::left << std::setw(20) << queue.name << std::right
+    << std::setw(8) << queue.capacity << std::setw(12) << queue.maxDepth
+    << std::setw(12) << queue.averageDepth << std::endl;
+  }
+  std::cout << std::defaultfloat;
+}
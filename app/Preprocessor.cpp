@@ -0,0 +1,201 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file Preprocessor.cpp
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Preprocessor Class implementation
+ * @version 0.1
+ * @date 2020-12-06
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+#include <algorithm>
+#include <cmath>
+#include <opencv2/core/hal/intrin.hpp>
+#include "../include/Preprocessor.h"
+
+namespace {
+/** @brief Value of the letterbox border, the gray darknet pads with */
+const float kPadValue = 0.5f;
+
+/** @brief Frames with at least this many pixels are split into bands */
+const int kParallelPixels = 1280 * 720;
+
+/**
+ * @brief Source sample positions of a bilinear resize along one axis, with
+ *        pixel centers aligned like cv::resize
+ */
+void axisTable(int source, int target, std::vector<int> &first,
+std::vector<int> &second, std::vector<float> &weight) {
+  first.resize(target);
+  second.resize(target);
+  weight.resize(target);
+  const double ratio = static_cast<double>(source) / target;
+  for (int i = 0; i < target; ++i) {
+    double position = (i + 0.5) * ratio - 0.5;
+    int index = static_cast<int>(std::floor(position));
+    float w = static_cast<float>(position - index);
+    if (index < 0) {
+      index = 0;
+      w = 0;
+    }
+    if (index >= source - 1) {
+      index = source - 1;
+      w = 0;
+    }
+    first[i] = index;
+    second[i] = std::min(index + 1, source - 1);
+    weight[i] = w;
+  }
+}
+}  // namespace
+
+/**
+ * @brief Sets the network input size
+ */
+void Preprocessor::setInputSize(cv::Size inputSize) {
+  if (inputSize == inputSize_)
+    return;
+  inputSize_ = inputSize;
+  frameSize_ = cv::Size();
+}
+
+/**
+ * @brief Sets the number of threads used on large frames
+ */
+void Preprocessor::setNumThreads(int numThreads) {
+  numThreads_ = numThreads > 1 ? numThreads : 1;
+  if (pool_ && pool_->getNumThreads() != numThreads_ - 1)
+    pool_.reset();
+  frameSize_ = cv::Size();
+}
+
+/**
+ * @brief Builds the interpolation tables for a frame size
+ */
+void Preprocessor::buildTables(cv::Size frameSize) {
+  frameSize_ = frameSize;
+  info_.active = true;
+  info_.input = inputSize_;
+  info_.scale = std::min(static_cast<float>(inputSize_.width) /
+  frameSize.width, static_cast<float>(inputSize_.height) / frameSize.height);
+  info_.content = cv::Size(
+  std::max(1, std::min(inputSize_.width,
+  cvRound(frameSize.width * info_.scale))),
+  std::max(1, std::min(inputSize_.height,
+  cvRound(frameSize.height * info_.scale))));
+  info_.padX = (inputSize_.width - info_.content.width) / 2;
+  info_.padY = (inputSize_.height - info_.content.height) / 2;
+
+  axisTable(frameSize.width, info_.content.width, xLeft_, xRight_, xWeight_);
+  axisTable(frameSize.height, info_.content.height, yTop_, yBottom_,
+  yWeight_);
+  // Column offsets point at the blue sample of a pixel in a BGR row
+  for (size_t i = 0; i < xLeft_.size(); ++i) {
+    xLeft_[i] *= 3;
+    xRight_[i] *= 3;
+  }
+  rowBuffers_.assign(numThreads_, std::vector<float>(frameSize.width * 3));
+}
+
+/**
+ * @brief Writes the output rows [firstRow, lastRow) of the blob
+ */
+void Preprocessor::processRows(const cv::Mat &frame, float *blob,
+int firstRow, int lastRow, float *rowBuffer) {
+  const int width = inputSize_.width;
+  const size_t planeSize = static_cast<size_t>(width) * inputSize_.height;
+  const int rowLength = frame.cols * 3;
+  const int contentWidth = info_.content.width;
+  for (int y = firstRow; y < lastRow; ++y) {
+    int sourceRow = y - info_.padY;
+    if (sourceRow < 0 || sourceRow >= info_.content.height) {
+      for (int c = 0; c < 3; ++c)
+        std::fill(blob + c * planeSize + static_cast<size_t>(y) * width,
+        blob + c * planeSize + static_cast<size_t>(y + 1) * width,
+        kPadValue);
+      continue;
+    }
+    // Vertical pass: blend the two source rows and scale to [0, 1]
+    const uchar *top = frame.ptr<uchar>(yTop_[sourceRow]);
+    const uchar *bottom = frame.ptr<uchar>(yBottom_[sourceRow]);
+    const float bottomWeight = yWeight_[sourceRow] / 255.f;
+    const float topWeight = (1.f - yWeight_[sourceRow]) / 255.f;
+    int k = 0;
+#if CV_SIMD
+    const int lanes = cv::v_float32::nlanes;
+    const cv::v_float32 vTop = cv::vx_setall_f32(topWeight);
+    const cv::v_float32 vBottom = cv::vx_setall_f32(bottomWeight);
+    for (; k <= rowLength - lanes; k += lanes) {
+      cv::v_float32 t = cv::v_cvt_f32(cv::v_reinterpret_as_s32(
+      cv::vx_load_expand_q(top + k)));
+      cv::v_float32 b = cv::v_cvt_f32(cv::v_reinterpret_as_s32(
+      cv::vx_load_expand_q(bottom + k)));
+      cv::v_store(rowBuffer + k, cv::v_muladd(b, vBottom, t * vTop));
+    }
+#endif
+    for (; k < rowLength; ++k)
+      rowBuffer[k] = top[k] * topWeight + bottom[k] * bottomWeight;
+
+    // Horizontal pass: gather both neighbours of every output pixel, blend
+    // them and write blue, green and red into the B, G, R planes reversed
+    for (int c = 0; c < 3; ++c) {
+      float *out = blob + (2 - c) * planeSize +
+      static_cast<size_t>(y) * width;
+      std::fill(out, out + info_.padX, kPadValue);
+      std::fill(out + info_.padX + contentWidth, out + width, kPadValue);
+      out += info_.padX;
+      const float *channel = rowBuffer + c;
+      int x = 0;
+#if CV_SIMD
+      for (; x <= contentWidth - lanes; x += lanes) {
+        cv::v_float32 left = cv::v_lut(channel, xLeft_.data() + x);
+        cv::v_float32 right = cv::v_lut(channel, xRight_.data() + x);
+        cv::v_float32 w = cv::vx_load(xWeight_.data() + x);
+        cv::v_store(out + x, cv::v_muladd(right - left, w, left));
+      }
+#endif
+      for (; x < contentWidth; ++x) {
+        float left = channel[xLeft_[x]];
+        float right = channel[xRight_[x]];
+        out[x] = left + (right - left) * xWeight_[x];
+      }
+    }
+  }
+}
+
+/**
+ * @brief Writes the letterboxed blob of a frame
+ */
+const LetterboxInfo &Preprocessor::run(const cv::Mat &frame, float *blob) {
+  CV_Assert(frame.type() == CV_8UC3);
+  if (frame.size() != frameSize_)
+    buildTables(frame.size());
+  const int rows = inputSize_.height;
+  if (numThreads_ <= 1 || frame.total() < static_cast<size_t>(kParallelPixels)) {
+    processRows(frame, blob, 0, rows, rowBuffers_[0].data());
+    return info_;
+  }
+  // The calling thread takes part, so the pool needs one thread less
+  if (!pool_)
+    pool_ = std::make_shared<ThreadPool>(numThreads_ - 1);
+  const int bands = numThreads_;
+  pool_->parallelFor(bands, [&](size_t band) {
+    int first = static_cast<int>(rows * band / bands);
+    int last = static_cast<int>(rows * (band + 1) / bands);
+    processRows(frame, blob, first, last, rowBuffers_[band].data());
+  });
+  return info_;
+}
+
+/**
+ * @brief Maps a box in network input pixels back to frame pixels
+ */
+cv::Rect Preprocessor::undo(const cv::Rect &box, const LetterboxInfo &info) {
+  if (!info.active || info.scale <= 0)
+    return box;
+  return cv::Rect(cvRound((box.x - info.padX) / info.scale),
+  cvRound((box.y - info.padY) / info.scale),
+  cvRound(box.width / info.scale), cvRound(box.height / info.scale));
+}
@@ -0,0 +1,308 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file Profiler.cpp
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Profiler, ScopedTimer and ProfilerSession Class implementation
+ * @version 0.1
+ * @date 2020-12-10
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include "../include/Profiler.h"
+
+std::atomic<bool> Profiler::enabled_(false);
+std::atomic<bool> Profiler::tracing_(false);
+
+namespace {
+const int kStages = static_cast<int>(Stage::COUNT);
+
+/**
+ * @brief One complete interval for the Chrome trace
+ */
+struct TraceEvent {
+  Stage stage;
+  int64_t startNs;
+  int64_t durationNs;
+};
+
+/**
+ * @brief Histograms and trace events of one thread. Only the owning thread
+ *        writes the counters, so relaxed loads and stores are enough.
+ */
+struct ThreadData {
+  int threadId = 0;
+  std::atomic<uint64_t> counts[kStages][Profiler::kBuckets];
+  std::atomic<uint64_t> maxNs[kStages];
+  std::mutex traceMutex;
+  std::vector<TraceEvent> trace;
+
+  ThreadData() {
+    for (auto &stage : counts)
+      for (auto &count : stage)
+        count.store(0, std::memory_order_relaxed);
+    for (auto &value : maxNs)
+      value.store(0, std::memory_order_relaxed);
+  }
+};
+
+/**
+ * @brief Every thread that ever recorded. Entries outlive their threads so
+ *        the stages of finished pipeline threads are still reported.
+ */
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadData>> threads;
+};
+
+Registry &registry() {
+  static Registry instance;
+  return instance;
+}
+
+/**
+ * @brief Data of the calling thread, registered on its first record
+ */
+ThreadData &threadData() {
+  thread_local ThreadData *data = nullptr;
+  if (!data) {
+    Registry &all = registry();
+    std::lock_guard<std::mutex> lock(all.mutex);
+    all.threads.push_back(std::make_unique<ThreadData>());
+    data = all.threads.back().get();
+    data->threadId = static_cast<int>(all.threads.size());
+  }
+  return *data;
+}
+
+/**
+ * @brief Nanoseconds of a steady clock time point
+ */
+int64_t toNs(std::chrono::steady_clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+  time.time_since_epoch()).count();
+}
+}  // namespace
+
+/**
+ * @brief Switches the recording on or off
+ */
+void Profiler::setEnabled(bool enabled) {
+  registry();
+  enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Switches the recording of trace events on or off
+ */
+void Profiler::setTracing(bool tracing) {
+  tracing_.store(tracing, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Maps a duration to its histogram bucket
+ */
+int Profiler::bucketOf(uint64_t nanoseconds) {
+  if (nanoseconds < static_cast<uint64_t>(kSubBuckets))
+    return static_cast<int>(nanoseconds);
+  int msb = 63 - __builtin_clzll(nanoseconds);
+  int sub = static_cast<int>((nanoseconds >> (msb - 4)) & (kSubBuckets - 1));
+  return (msb - 3) * kSubBuckets + sub;
+}
+
+/**
+ * @brief Gets the largest duration of a bucket
+ */
+uint64_t Profiler::bucketUpperBound(int bucket) {
+  if (bucket < kSubBuckets)
+    return static_cast<uint64_t>(bucket);
+  int msb = bucket / kSubBuckets + 3;
+  uint64_t sub = static_cast<uint64_t>(bucket % kSubBuckets);
+  uint64_t width = 1ull << (msb - 4);
+  return ((kSubBuckets + sub) << (msb - 4)) + width - 1;
+}
+
+/**
+ * @brief Records one timed interval of a stage
+ */
+void Profiler::record(Stage stage, std::chrono::steady_clock::time_point start,
+std::chrono::steady_clock::time_point end) {
+  ThreadData &data = threadData();
+  const int s = static_cast<int>(stage);
+  int64_t durationNs = std::max<int64_t>(0, toNs(end) - toNs(start));
+  uint64_t ns = static_cast<uint64_t>(durationNs);
+  auto &count = data.counts[s][bucketOf(ns)];
+  count.store(count.load(std::memory_order_relaxed) + 1,
+  std::memory_order_relaxed);
+  if (ns > data.maxNs[s].load(std::memory_order_relaxed))
+    data.maxNs[s].store(ns, std::memory_order_relaxed);
+  if (tracing_.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock(data.traceMutex);
+    data.trace.push_back({stage, toNs(start), durationNs});
+  }
+}
+
+/**
+ * @brief Merges the histograms of all threads
+ */
+std::vector<StageSummary> Profiler::summarize() {
+  std::vector<uint64_t> merged(kBuckets);
+  std::vector<StageSummary> summaries;
+  Registry &all = registry();
+  std::lock_guard<std::mutex> lock(all.mutex);
+  for (int s = 0; s < kStages; ++s) {
+    std::fill(merged.begin(), merged.end(), 0);
+    StageSummary summary;
+    summary.stage = static_cast<Stage>(s);
+    uint64_t maxNs = 0;
+    for (const auto &data : all.threads) {
+      for (int b = 0; b < kBuckets; ++b)
+        merged[b] += data->counts[s][b].load(std::memory_order_relaxed);
+      maxNs = std::max(maxNs, data->maxNs[s].load(std::memory_order_relaxed));
+    }
+    for (uint64_t count : merged)
+      summary.count += count;
+    if (summary.count == 0)
+      continue;
+    // Nearest rank percentiles, reported as the bucket's upper bound but
+    // never above the exact maximum
+    const double ranks[] = {0.50, 0.95, 0.99};
+    double *fields[] = {&summary.p50, &summary.p95, &summary.p99};
+    for (int p = 0; p < 3; ++p) {
+      uint64_t rank = static_cast<uint64_t>(ranks[p] * summary.count + 0.5);
+      rank = std::max<uint64_t>(1, std::min(rank, summary.count));
+      uint64_t seen = 0;
+      for (int b = 0; b < kBuckets; ++b) {
+        seen += merged[b];
+        if (seen >= rank) {
+          *fields[p] = std::min(bucketUpperBound(b), maxNs) / 1e6;
+          break;
+        }
+      }
+    }
+    summary.max = maxNs / 1e6;
+    summaries.push_back(summary);
+  }
+  return summaries;
+}
+
+/**
+ * @brief Clears the histograms and trace events of all threads
+ */
+void Profiler::reset() {
+  Registry &all = registry();
+  std::lock_guard<std::mutex> lock(all.mutex);
+  for (auto &data : all.threads) {
+    for (auto &stage : data->counts)
+      for (auto &count : stage)
+        count.store(0, std::memory_order_relaxed);
+    for (auto &value : data->maxNs)
+      value.store(0, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> traceLock(data->traceMutex);
+    data->trace.clear();
+  }
+}
+
+/**
+ * @brief Prints p50, p95, p99 and max of every stage that ran
+ */
+void Profiler::printReport() {
+  std::vector<StageSummary> summaries = summarize();
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "Stage              count     p50 ms     p95 ms     p99 ms"
+  "     max ms" << std::endl;
+  for (const auto &summary : summaries)
+    std::cout << std::left << std::setw(16) << stageName(summary.stage)
+    << std::right << std::setw(8) << summary.count << std::setw(11)
+    << summary.p50 << std::setw(11) << summary.p95 << std::setw(11)
+    << summary.p99 << std::setw(11) << summary.max << std::endl;
+}
+
+/**
+ * @brief Writes the recorded trace events as Chrome trace-event JSON
+ */
+bool Profiler::writeTrace(const std::string &file) {
+  std::ofstream out(file);
+  if (!out)
+    return false;
+  out << "{\"traceEvents\":[";
+  bool first = true;
+  Registry &all = registry();
+  std::lock_guard<std::mutex> lock(all.mutex);
+  out << std::fixed << std::setprecision(3);
+  for (auto &data : all.threads) {
+    std::lock_guard<std::mutex> traceLock(data->traceMutex);
+    for (const auto &event : data->trace) {
+      out << (first ? "\n" : ",\n") << "{\"name\":\""
+      << stageName(event.stage) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+      << data->threadId << ",\"ts\":" << event.startNs / 1e3 << ",\"dur\":"
+      << event.durationNs / 1e3 << "}";
+      first = false;
+    }
+  }
+  out << "\n]}\n";
+  return static_cast<bool>(out);
+}
+
+/**
+ * @brief Gets the name of a stage
+ */
+const char *Profiler::stageName(Stage stage) {
+  switch (stage) {
+    case Stage::DECODE: return "decode";
+    case Stage::PREPROCESS: return "preprocess";
+    case Stage::FORWARD: return "forward";
+    case Stage::POSTPROCESS: return "postprocess";
+    case Stage::TRACK_DETECTIONS: return "track detections";
+    case Stage::TRACK_UPDATE: return "track update";
+    case Stage::DRAW: return "draw";
+    case Stage::ENCODE: return "encode";
+    default: return "unknown";
+  }
+}
+
+/**
+ * @brief Turns the profiler on and starts the periodic report
+ */
+ProfilerSession::ProfilerSession(double intervalSeconds,
+const std::string &traceFile) : intervalSeconds_(intervalSeconds),
+traceFile_(traceFile) {
+  Profiler::setTracing(!traceFile_.empty());
+  Profiler::setEnabled(true);
+  if (intervalSeconds_ <= 0)
+    return;
+  reporter_ = std::thread([this]() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto interval = std::chrono::duration<double>(intervalSeconds_);
+    while (!stop_.wait_for(lock, interval, [this] { return stopping_; }))
+      Profiler::printReport();
+  });
+}
+
+/**
+ * @brief Stops the periodic report, prints the final one and writes the trace
+ */
+ProfilerSession::~ProfilerSession() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  stop_.notify_all();
+  if (reporter_.joinable())
+    reporter_.join();
+  Profiler::setEnabled(false);
+  Profiler::setTracing(false);
+  Profiler::printReport();
+  if (!traceFile_.empty()) {
+    if (Profiler::writeTrace(traceFile_))
+      std::cout << "Trace is stored as " << traceFile_ << std::endl;
+    else
+      std::cout << "Could not write the trace " << traceFile_ << std::endl;
+  }
+}
@@ -0,0 +1,101 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file ResultWriter.cpp
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief ResultWriter Class implementation
+ * @version 0.1
+ * @date 2020-12-09
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+#include <algorithm>
+#include "../include/ResultWriter.h"
+
+namespace {
+/**
+ * @brief Appends printf style text to a line
+ */
+template <typename... Args>
+void append(std::string &line, const char *format, Args... args) {
+  char buffer[160];
+  int length = std::snprintf(buffer, sizeof(buffer), format, args...);
+  if (length > 0)
+    line.append(buffer, std::min(static_cast<size_t>(length),
+    sizeof(buffer) - 1));
+}
+}  // namespace
+
+/**
+ * @brief Opens the output
+ */
+bool ResultWriter::open(const std::string &path) {
+  close();
+  if (path == "-") {
+    out_ = stdout;
+    ownsFile_ = false;
+  } else {
+    out_ = std::fopen(path.c_str(), "w");
+    ownsFile_ = true;
+  }
+  frames_ = 0;
+  return out_ != nullptr;
+}
+
+/**
+ * @brief Formats one frame as a JSON line
+ */
+void ResultWriter::formatFrame(int frame, double timestampMs,
+const std::vector<TrackResult> &tracks, std::string &line) {
+  line.clear();
+  append(line, "{\"frame\":%d,\"t\":%.1f,\"tracks\":[", frame, timestampMs);
+  for (size_t i = 0; i < tracks.size(); ++i) {
+    const TrackResult &track = tracks[i];
+    append(line, "%s{\"id\":%d,\"box\":[%.1f,%.1f,%.1f,%.1f],\"conf\":%.3f,"
+    "\"pose\":[%.1f,%.1f]}", i ? "," : "", track.id, track.box.x, track.box.y,
+    track.box.width, track.box.height, track.confidence, track.pose.x,
+    track.pose.y);
+  }
+  line += "]}";
+}
+
+/**
+ * @brief Writes one frame
+ */
+void ResultWriter::writeFrame(int frame, double timestampMs,
+const std::vector<TrackResult> &tracks) {
+  if (!out_)
+    return;
+  formatFrame(frame, timestampMs, tracks, line_);
+  line_ += '\n';
+  std::fwrite(line_.data(), 1, line_.size(), out_);
+  frames_++;
+}
+
+/**
+ * @brief Gets the number of frames written
+ */
+size_t ResultWriter::getFrameCount() {
+  return frames_;
+}
+
+/**
+ * @brief Flushes the output and closes it if it was opened here
+ */
+void ResultWriter::close() {
+  if (!out_)
+    return;
+  if (ownsFile_)
+    std::fclose(out_);
+  else
+    std::fflush(out_);
+  out_ = nullptr;
+}
+
+/**
+ * @brief Destroy the Result Writer object
+ */
+ResultWriter::~ResultWriter() {
+  close();
+}
@@ -0,0 +1,71 @@
+/**
+ * @file    ShmConsumer.cpp
+ * @author  Sneha Nayak, Sukoon Sarin
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ * @version 0.1
+ * @date 2020-12-09
+ * @brief Test consumer of the shared memory track ring
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "../include/ShmRing.h"
+
+/**
+ * @fn main
+ * @brief Main function
+ * @detail Polls the ring, prints every frame and the publish to read latency
+ * @return Program execution status
+ */
+int main(int argc, char **argv) {
+    const char *keys =
+        "{help h usage ? | | Usage example: \n\t\t."
+        "/shm-consumer --name=/human_tracks --frames=100}"
+        "{name          | /human_tracks | shared memory name of the ring }"
+        "{frames        | 0    | frames to read, 0 to read until killed }"
+        "{quiet         |      | print only the latency summary }";
+    cv::CommandLineParser parser(argc, argv, keys);
+    if (parser.has("help")) {
+        parser.printMessage();
+        return 0;
+    }
+    const std::string name = parser.get<std::string>("name");
+    const int wanted = parser.get<int>("frames");
+    const bool quiet = parser.has("quiet");
+    ShmRingReader reader;
+    while (!reader.open(name))
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::cout << "Reading " << name << std::endl;
+
+    std::vector<double> latenciesUs;
+    ShmFrame frame;
+    while (wanted <= 0 || static_cast<int>(latenciesUs.size()) < wanted) {
+        if (!reader.tryRead(frame)) {
+            // Spinning briefly keeps the latency in microseconds
+            std::this_thread::yield();
+            continue;
+        }
+        int64_t nowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+        latenciesUs.push_back((nowNs - frame.timestampNs) / 1000.0);
+        if (quiet)
+            continue;
+        std::cout << "#" << frame.sequence << " frame " << frame.frameIndex
+        << " tracks " << frame.trackCount;
+        for (int i = 0; i < frame.trackCount; ++i)
+            std::cout << " [" << frame.tracks[i].id << " pose "
+            << frame.tracks[i].poseX << "," << frame.tracks[i].poseY << "]";
+        std::cout << " latency " << latenciesUs.back() << " us" << std::endl;
+    }
+    std::sort(latenciesUs.begin(), latenciesUs.end());
+    if (!latenciesUs.empty())
+        std::cout << "Read " << latenciesUs.size() << " frames, dropped "
+        << reader.getDropped() << ", latency p50 "
+        << latenciesUs[latenciesUs.size() / 2] << " us, max "
+        << latenciesUs.back() << " us" << std::endl;
+    return 0;
+}
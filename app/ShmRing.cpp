@@ -0,0 +1,260 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file ShmRing.cpp
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief ShmRingPublisher and ShmRingReader Class implementation
+ * @version 0.1
+ * @date 2020-12-09
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include "../include/ShmRing.h"
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+"the ring needs lock-free 64-bit atomics to be shared between processes");
+
+namespace {
+/** @brief First field of every ring */
+const uint32_t kMagic = 0x48545231;
+
+/** @brief Layout version, readers reject other versions */
+const uint32_t kVersion = 1;
+
+/**
+ * @brief Size of the shared memory object of a ring
+ */
+size_t ringSize(uint32_t capacity) {
+  return sizeof(ShmRingHeader) + capacity * sizeof(ShmSlot);
+}
+
+/**
+ * @brief Stamp of a complete entry
+ */
+uint64_t doneStamp(uint64_t sequence) {
+  return 2 * (sequence + 1);
+}
+}  // namespace
+
+/**
+ * @brief Creates the shared memory object
+ */
+bool ShmRingPublisher::create(const std::string &name, uint32_t capacity) {
+  close();
+  if (capacity == 0)
+    return false;
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0)
+    return false;
+  size_t size = ringSize(capacity);
+  if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    ::close(fd);
+    shm_unlink(name.c_str());
+    return false;
+  }
+  void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+  fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    return false;
+  }
+  name_ = name;
+  mapping_ = mapping;
+  size_ = size;
+  // ftruncate zero fills, so every stamp starts as "never written"
+  header_ = new (mapping) ShmRingHeader;
+  slots_ = reinterpret_cast<ShmSlot *>(static_cast<char *>(mapping) +
+  sizeof(ShmRingHeader));
+  header_->capacity = capacity;
+  header_->slotSize = sizeof(ShmSlot);
+  header_->version = kVersion;
+  header_->published.store(0, std::memory_order_relaxed);
+  // Readers check the magic last, after the rest of the header is set
+  std::atomic_thread_fence(std::memory_order_release);
+  header_->magic = kMagic;
+  return true;
+}
+
+/**
+ * @brief Publishes the tracks of one frame
+ */
+uint64_t ShmRingPublisher::publish(int frameIndex,
+const std::vector<TrackResult> &tracks) {
+  if (!header_)
+    return 0;
+  const uint64_t sequence = header_->published.load(std::memory_order_relaxed);
+  ShmSlot &slot = slots_[sequence % header_->capacity];
+  // Odd stamp: readers that copy the slot meanwhile discard their copy
+  slot.stamp.store(2 * sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  ShmFrame &frame = slot.frame;
+  frame.sequence = sequence;
+  frame.timestampNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+  std::chrono::steady_clock::now().time_since_epoch()).count();
+  frame.frameIndex = frameIndex;
+  frame.trackCount = static_cast<int32_t>(std::min(tracks.size(),
+  static_cast<size_t>(ShmFrame::kMaxTracks)));
+  for (int i = 0; i < frame.trackCount; ++i) {
+    const TrackResult &track = tracks[i];
+    frame.tracks[i] = {track.id, track.confidence,
+    static_cast<float>(track.box.x), static_cast<float>(track.box.y),
+    static_cast<float>(track.box.width), static_cast<float>(track.box.height),
+    track.pose.x, track.pose.y};
+  }
+
+  slot.stamp.store(doneStamp(sequence), std::memory_order_release);
+  header_->published.store(sequence + 1, std::memory_order_release);
+  return sequence;
+}
+
+/**
+ * @brief Unmaps and unlinks the shared memory object
+ */
+void ShmRingPublisher::close() {
+  if (mapping_) {
+    munmap(mapping_, size_);
+    shm_unlink(name_.c_str());
+  }
+  mapping_ = nullptr;
+  header_ = nullptr;
+  slots_ = nullptr;
+  size_ = 0;
+}
+
+/**
+ * @brief Destroy the Shm Ring Publisher object
+ */
+ShmRingPublisher::~ShmRingPublisher() {
+  close();
+}
+
+/**
+ * @brief Maps a ring and starts reading at its newest entry
+ */
+bool ShmRingReader::open(const std::string &name) {
+  close();
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+    return false;
+  struct stat info;
+  if (fstat(fd, &info) != 0 ||
+  static_cast<size_t>(info.st_size) < sizeof(ShmRingHeader)) {
+    ::close(fd);
+    return false;
+  }
+  size_t size = static_cast<size_t>(info.st_size);
+  void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED)
+    return false;
+  mapping_ = mapping;
+  size_ = size;
+  header_ = static_cast<const ShmRingHeader *>(mapping);
+  bool valid = header_->magic == kMagic;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  valid = valid && header_->version == kVersion &&
+  header_->slotSize == sizeof(ShmSlot) && header_->capacity > 0 &&
+  ringSize(header_->capacity) <= size_;
+  if (!valid) {
+    close();
+    return false;
+  }
+  slots_ = reinterpret_cast<const ShmSlot *>(
+  static_cast<const char *>(mapping) + sizeof(ShmRingHeader));
+  uint64_t published = header_->published.load(std::memory_order_acquire);
+  next_ = published > 0 ? published - 1 : 0;
+  dropped_ = 0;
+  return true;
+}
+
+/**
+ * @brief Copies one entry out of its slot
+ */
+bool ShmRingReader::copyEntry(uint64_t sequence, ShmFrame &frame) const {
+  const ShmSlot &slot = slots_[sequence % header_->capacity];
+  if (slot.stamp.load(std::memory_order_acquire) != doneStamp(sequence))
+    return false;
+  std::memcpy(&frame, &slot.frame, sizeof(ShmFrame));
+  std::atomic_thread_fence(std::memory_order_acquire);
+  // The producer may have started on the slot while it was copied
+  return slot.stamp.load(std::memory_order_relaxed) == doneStamp(sequence);
+}
+
+/**
+ * @brief Reads the next entry in order
+ */
+bool ShmRingReader::tryRead(ShmFrame &frame) {
+  if (!header_)
+    return false;
+  while (true) {
+    uint64_t published = header_->published.load(std::memory_order_acquire);
+    if (next_ >= published)
+      return false;
+    // Entries a full ring behind are gone, continue with the oldest left
+    if (published - next_ > header_->capacity) {
+      dropped_ += published - header_->capacity - next_;
+      next_ = published - header_->capacity;
+    }
+    if (copyEntry(next_, frame)) {
+      next_++;
+      return true;
+    }
+    // Overwritten while copying, the loop moves past it
+    if (header_->published.load(std::memory_order_acquire) - next_ <
+    header_->capacity)
+      return false;
+  }
+}
+
+/**
+ * @brief Reads the newest entry and continues after it
+ */
+bool ShmRingReader::readLatest(ShmFrame &frame) {
+  if (!header_)
+    return false;
+  uint64_t published = header_->published.load(std::memory_order_acquire);
+  if (published == 0 || !copyEntry(published - 1, frame))
+    return false;
+  if (published - 1 > next_)
+    dropped_ += published - 1 - next_;
+  next_ = published;
+  return true;
+}
+
+/**
+ * @brief Gets the number of entries lost to overruns
+ */
+uint64_t ShmRingReader::getDropped() {
+  return dropped_;
+}
+
+/**
+ * @brief Unmaps the ring
+ */
+void ShmRingReader::close() {
+  if (mapping_)
+    munmap(const_cast<void *>(mapping_), size_);
+  mapping_ = nullptr;
+  header_ = nullptr;
+  slots_ = nullptr;
+  size_ = 0;
+}
+
+/**
+ * @brief Destroy the Shm Ring Reader object
+ */
+ShmRingReader::~ShmRingReader() {
+  close();
+}
@@ -0,0 +1,104 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file ThreadPool.cpp
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief ThreadPool Class implementation
+ * @version 0.1
+ * @date 2020-12-01
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include "../include/ThreadPool.h"
+
+/**
+ * @brief ThreadPool constructor, starts the workers.
+ */
+ThreadPool::ThreadPool(int numThreads) {
+  if (numThreads < 1)
+    numThreads = 1;
+  for (int i = 0; i < numThreads; ++i)
+    workers_.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+/**
+ * @brief Runs tasks until the pool shuts down
+ */
+void ThreadPool::workerLoop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      hasTask_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty())
+        return;
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+/**
+ * @brief Runs body(i) for every i in [0, n) and waits for all of them
+ */
+void ThreadPool::parallelFor(size_t n,
+const std::function<void(size_t)> &body) {
+  if (n == 0)
+    return;
+  if (n == 1) {
+    body(0);
+    return;
+  }
+  // Iterations are handed out through a shared counter, so the split
+  // between threads does not matter as long as body(i) only writes slot i
+  struct Job {
+    std::atomic<size_t> next{0};
+    size_t pending;
+    std::mutex mutex;
+    std::condition_variable done;
+  };
+  auto job = std::make_shared<Job>();
+  const size_t helpers = std::min(n - 1, workers_.size());
+  job->pending = helpers + 1;
+  auto run = [job, n, &body] {
+    for (size_t i = job->next++; i < n; i = job->next++)
+      body(i);
+    std::lock_guard<std::mutex> lock(job->mutex);
+    if (--job->pending == 0)
+      job->done.notify_all();
+  };
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < helpers; ++i)
+      tasks_.push_back(run);
+  }
+  hasTask_.notify_all();
+  run();
+  std::unique_lock<std::mutex> lock(job->mutex);
+  job->done.wait(lock, [&job] { return job->pending == 0; });
+}
+
+/**
+ * @brief Gets the number of worker threads
+ */
+int ThreadPool::getNumThreads() {
+  return static_cast<int>(workers_.size());
+}
+
+/**
+ * @brief ThreadPool destructor, finishes queued tasks and joins the workers.
+ */
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  hasTask_.notify_all();
+  for (auto &worker : workers_)
+    worker.join();
+}
@@ -10,8 +10,23 @@
  * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
  * 
  */
+#include <algorithm>
+#include <limits>
+#include <string>
+#include "../include/Profiler.h"
 #include "../include/Track.h"
 
+namespace {
+/**
+ * @brief Kalman filter noise of the SORT mode, in pixels squared
+ */
+const float kPositionNoise = 1.0f;
+const float kVelocityNoise = 0.1f;
+const float kMeasurementNoise = 10.0f;
+const float kInitialPositionVariance = 10.0f;
+const float kInitialVelocityVariance = 1000.0f;
+}  // namespace
+
 /**
  * @brief Detection constructor.
  */
@@ -21,70 +36,465 @@ Track::Track() {
  * @brief Initializes  the network for the tracker
  */
 void Track::initializeTracker() {
-  multiTracker = cv::MultiTracker::create();
+  table_.clear();
+  kcfTrackers_.clear();
+  filters_.clear();
+  nextTrackId_ = 1;
+  lostCount_ = 0;
+}
+
+/**
+ * @brief Selects the tracking algorithm
+ */
+void Track::setTrackerMode(TrackerMode mode) {
+  // The modes keep their per-slot state in different arrays, so tracks of
+  // one mode cannot be carried over to the other
+  if (mode != mode_)
+    initializeTracker();
+  mode_ = mode;
+}
+
+/**
+ * @brief Sets the number of threads that update the per-object trackers
+ */
+void Track::setNumThreads(int numThreads) {
+  numThreads_ = numThreads > 1 ? numThreads : 1;
+  if (pool_ && pool_->getNumThreads() != numThreads_ - 1)
+    pool_.reset();
+}
+
+/**
+ * @brief Runs body(i) for i in [0, n) on the worker pool
+ */
+void Track::forEachObject(size_t n,
+const std::function<void(size_t)> &body) {
+  if (numThreads_ <= 1 || n < 2) {
+    for (size_t i = 0; i < n; ++i)
+      body(i);
+    return;
+  }
+  // The calling thread takes part, so the pool needs one thread less
+  if (!pool_)
+    pool_ = std::make_shared<ThreadPool>(numThreads_ - 1);
+  pool_->parallelFor(n, body);
+}
+
+/**
+ * @brief Enables KCF as an appearance fallback for unmatched SORT tracks
+ */
+void Track::setAppearanceFallback(bool enabled) {
+  appearanceFallback_ = enabled;
+}
+
+/**
+ * @brief Sets how much of a detection resizeBoxes keeps
+ */
+void Track::setBoxShrink(double width, double height) {
+  shrinkWidth_ = width;
+  shrinkHeight_ = height;
+  cutLeft_ = (1 - width) / 2;
+  cutTop_ = (1 - height) * 0.3;
 }
 
 /**
  * @brief Runs the tracking algo by taking in detections and conidence scores
  */
 void Track::runTrackerAlgorithm(std::vector<cv::Rect> detections) {
-  cv::Ptr<cv::MultiTracker> multiTrackerTemp = cv::MultiTracker::create();
-  multiTracker = multiTrackerTemp;
-  for (auto &detection : detections) {
-    resizeBoxes(detection);
-    multiTracker->add(cv::TrackerKCF::create(), frame_, detection);
+  ScopedTimer timer(Stage::TRACK_DETECTIONS);
+  if (mode_ == TrackerMode::SORT) {
+    std::vector<cv::Rect2d> boxes;
+    for (auto &detection : detections) {
+      resizeBoxes(detection);
+      boxes.push_back(detection);
+    }
+    const std::vector<int> &slots = table_.getSlots();
+    for (int slot : slots)
+      predictTrack(slot);
+
+    // Associate predicted tracks to detections on IoU
+    std::vector<std::vector<double>> cost(slots.size(),
+    std::vector<double>(boxes.size()));
+    for (size_t i = 0; i < slots.size(); ++i) {
+      cv::Rect2d predicted = trackBox(filters_[slots[i]]);
+      for (size_t j = 0; j < boxes.size(); ++j)
+        cost[i][j] = 1.0 - iou(predicted, boxes[j]);
+    }
+    std::vector<int> assignment = solveAssignment(cost);
+    std::vector<bool> matched(boxes.size(), false);
+    for (size_t i = 0; i < slots.size(); ++i) {
+      MotionTrack &track = filters_[slots[i]];
+      int j = assignment[i];
+      if (j >= 0 && 1.0 - cost[i][j] >= iouThreshold_) {
+        correctTrack(slots[i], boxes[j]);
+        table_.addHit(slots[i]);
+        track.fallback = cv::Ptr<cv::Tracker>();
+        matched[j] = true;
+        continue;
+      }
+      table_.addMiss(slots[i]);
+      if (appearanceFallback_ && table_.getMisses(slots[i]) <= maxMisses_) {
+        // Follow the lost track on appearance until it is matched again
+        try {
+          track.fallback = cv::TrackerKCF::create();
+          track.fallback->init(frame_, trackBox(track));
+        }
+        catch (...) {
+          track.fallback = cv::Ptr<cv::Tracker>();
+        }
+      }
+    }
+    // Ending a track only shifts the slots after it
+    for (size_t i = slots.size(); i-- > 0;)
+      if (table_.getMisses(slots[i]) > maxMisses_)
+        endTrack(slots[i]);
+    for (size_t j = 0; j < boxes.size(); ++j)
+      if (!matched[j])
+        createTrack(boxes[j]);
+    return;
   }
+  // Every pass starts the KCF tracks over, in slots 0 to n - 1
+  table_.clear();
+  for (size_t i = 0; i < detections.size(); ++i) {
+    resizeBoxes(detections[i]);
+    int slot = table_.acquire(static_cast<int>(i) + 1);
+    table_.setBox(slot, detections[i]);
+    table_.addHit(slot);
+  }
+  kcfTrackers_.assign(detections.size(), cv::Ptr<cv::Tracker>());
+  forEachObject(detections.size(), [&](size_t i) {
+    try {
+      kcfTrackers_[i] = cv::TrackerKCF::create();
+      kcfTrackers_[i]->init(frame_, cv::Rect2d(detections[i]));
+    }
+    catch (...) {
+      // A box KCF cannot train on stays where it was detected
+      kcfTrackers_[i] = cv::Ptr<cv::Tracker>();
+    }
+  });
 }
 /**
  * @brief Sets current frame
  */
 
-void Track::setFrame(cv::Mat frame) {
+void Track::setFrame(const cv::Mat &frame) {
   frame_ = frame;
 }
 /**
  * @brief Draws green bounding box around the tracked human
  */
 cv::Mat Track::drawGreenBoundingBox() {
-  for (const auto &object : multiTracker->getObjects()) {
-    cv::rectangle(frame_, object, cv::Scalar(255, 0, 0), 2, 8);
-    std::vector<float> coordinates = {static_cast<float>(object.x),
-    static_cast<float>(object.width), static_cast<float>(object.y),
-    static_cast<float>(object.height)};
-    std::vector<float> pose = getCoordinatesInCameraFrame(coordinates);
-    std::string label = cv::format("%.2f", pose[0]);
-    label = "Pose: ("+label + ","+cv::format("%.2f", pose[1])+")";
+  ScopedTimer timer(Stage::DRAW);
+  TrackView tracks = table_.view();
+  for (size_t i = 0; i < tracks.count; ++i) {
+    int slot = tracks.slots[i];
+    cv::rectangle(frame_, table_.getBox(slot), cv::Scalar(255, 0, 0), 2, 8);
+    std::string label = cv::format("Pose: (%.2f,%.2f)", tracks.poseX[slot],
+    tracks.poseY[slot]);
+    if (mode_ == TrackerMode::SORT)
+      label = "ID " + std::to_string(tracks.id[slot]) + " " + label;
     // int baseLine;
     // cv::Size labelSize = cv::getTextSize(label,
     // cv::FONT_HERSHEY_SIMPLEX, 0.5, 1, &baseLine);
-    cv::putText(frame_, label, cv::Point(coordinates[0], coordinates[2]),
+    cv::putText(frame_, label, cv::Point(tracks.x[slot], tracks.y[slot]),
     cv::FONT_HERSHEY_SIMPLEX, 0.75, cv::Scalar(0, 0, 0), 1);
   }
   return frame_;
 }
+/**
+ * @brief Resizes bounding boxes
+ */
+void Track::resizeBoxes(cv::Rect &box) {
+  box.x += cvRound(box.width * cutLeft_);
+  box.width = cvRound(box.width * shrinkWidth_);
+  box.y += cvRound(box.height * cutTop_);
+  box.height = cvRound(box.height * shrinkHeight_);
+}
+/**
+ * @brief Updates tracker
+ */
+void Track::updateTracker() {
+  ScopedTimer timer(Stage::TRACK_UPDATE);
+  if (mode_ == TrackerMode::SORT) {
+    const std::vector<int> &slots = table_.getSlots();
+    lostSlots_.clear();
+    for (int slot : slots) {
+      predictTrack(slot);
+      if (filters_[slot].fallback)
+        lostSlots_.push_back(slot);
+    }
+    // Appearance updates run in parallel, corrections in track order
+    lostBoxes_.resize(lostSlots_.size());
+    found_.assign(lostSlots_.size(), 0);
+    forEachObject(lostSlots_.size(), [this](size_t k) {
+      try {
+        found_[k] = filters_[lostSlots_[k]].fallback->update(frame_,
+        lostBoxes_[k]);
+      }
+      catch (...) {
+        found_[k] = 0;
+      }
+    });
+    for (size_t k = 0; k < lostSlots_.size(); ++k) {
+      if (found_[k])
+        correctTrack(lostSlots_[k], lostBoxes_[k]);
+      else
+        filters_[lostSlots_[k]].fallback = cv::Ptr<cv::Tracker>();
+    }
+    // Unmatched tracks without an appearance tracker only coast
+    lostCount_ = static_cast<int>(std::count_if(slots.begin(), slots.end(),
+    [this](int slot) {
+      return table_.getMisses(slot) > 0 && !filters_[slot].fallback;
+    }));
+    return;
+  }
+  // Every tracker only writes its own slot, so the result does not
+  // depend on the number of threads
+  const std::vector<int> &slots = table_.getSlots();
+  forEachObject(slots.size(), [&](size_t i) {
+    int slot = slots[i];
+    cv::Rect2d before = table_.getBox(slot);
+    cv::Rect2d box = before;
+    table_.addAge(slot);
+    try {
+      if (kcfTrackers_[slot] && kcfTrackers_[slot]->update(frame_, box)) {
+        table_.setBox(slot, box);
+        table_.setVelocity(slot, static_cast<float>((box.x + box.width / 2) -
+        (before.x + before.width / 2)), static_cast<float>((box.y +
+        box.height / 2) - (before.y + before.height / 2)));
+        table_.addHit(slot);
+        return;
+      }
+    }
+    catch (...) {
+      kcfTrackers_[slot] = cv::Ptr<cv::Tracker>();
+    }
+    table_.addMiss(slot);
+  });
+  // A KCF track is lost when its last update failed
+  lostCount_ = static_cast<int>(std::count_if(slots.begin(), slots.end(),
+  [this](int slot) { return table_.getMisses(slot) > 0; }));
+}
 
 /**
- * @brief Gets the Poses from the bounding boxes in the UAV's Camera Frame.
+ * @brief Gets the number of tracks lost on the last update
  */
-std::vector<float> Track::getCoordinatesInCameraFrame
-(std::vector<float> coordinates) {
-  std::vector<float> v1(2);
-  v1 = {coordinates[0]+(coordinates[1]/2), coordinates[2]+(coordinates[3]/2)};
+int Track::getLostCount() {
+  return lostCount_;
+}
 
-  return v1;
+/**
+ * @brief Gets the boxes of all current tracks
+ */
+std::vector<cv::Rect2d> Track::getTrackedBoxes() {
+  std::vector<cv::Rect2d> boxes;
+  boxes.reserve(table_.size());
+  for (int slot : table_.getSlots())
+    boxes.push_back(table_.getBox(slot));
+  return boxes;
 }
+
 /**
- * @brief Resizes bounding boxes
+ * @brief Gets the IDs of all current tracks
  */
-void Track::resizeBoxes(cv::Rect &box) {
-  box.x += cvRound(box.width * 0.1);
-  box.width = cvRound(box.width * 0.8);
-  box.y += cvRound(box.height * 0.06);
-  box.height = cvRound(box.height * 0.8);
+std::vector<int> Track::getTrackIds() {
+  std::vector<int> ids;
+  ids.reserve(table_.size());
+  for (int slot : table_.getSlots())
+    ids.push_back(table_.getId(slot));
+  return ids;
 }
+
 /**
- * @brief Updates tracker
+ * @brief Gets the camera frame pose of all current tracks
  */
-void Track::updateTracker() {
-  multiTracker->update(frame_);
+std::vector<cv::Point2f> Track::getTrackedPoses() {
+  TrackView tracks = table_.view();
+  std::vector<cv::Point2f> poses;
+  poses.reserve(tracks.count);
+  for (size_t i = 0; i < tracks.count; ++i)
+    poses.emplace_back(tracks.poseX[tracks.slots[i]],
+    tracks.poseY[tracks.slots[i]]);
+  return poses;
+}
+
+/**
+ * @brief Gets the table of the current tracks
+ */
+const TrackTable &Track::getTrackTable() {
+  return table_;
+}
+
+/**
+ * @brief Starts a SORT track at a detection
+ */
+void Track::createTrack(const cv::Rect2d &box) {
+  int slot = table_.acquire(nextTrackId_++);
+  if (filters_.size() <= static_cast<size_t>(slot))
+    filters_.resize(table_.capacity());
+  MotionTrack &track = filters_[slot];
+  const float measurement[4] = {static_cast<float>(box.x + box.width / 2),
+  static_cast<float>(box.y + box.height / 2),
+  static_cast<float>(box.width), static_cast<float>(box.height)};
+  for (int k = 0; k < 4; ++k) {
+    track.state[k][0] = measurement[k];
+    track.state[k][1] = 0;
+    track.covariance[k][0] = kInitialPositionVariance;
+    track.covariance[k][1] = 0;
+    track.covariance[k][2] = kInitialVelocityVariance;
+  }
+  track.fallback = cv::Ptr<cv::Tracker>();
+  table_.addHit(slot);
+  storeTrack(slot);
+}
+
+/**
+ * @brief Ends the track in a slot
+ */
+void Track::endTrack(int slot) {
+  filters_[slot].fallback = cv::Ptr<cv::Tracker>();
+  table_.release(slot);
+}
+
+/**
+ * @brief Advances the Kalman filters of a track by one frame
+ */
+void Track::predictTrack(int slot) {
+  MotionTrack &track = filters_[slot];
+  // x' = F x and P' = F P F^T + Q with F = [1 1; 0 1], per coordinate
+  for (int k = 0; k < 4; ++k) {
+    float *x = track.state[k];
+    float *p = track.covariance[k];
+    x[0] += x[1];
+    p[0] += 2 * p[1] + p[2] + kPositionNoise;
+    p[1] += p[2];
+    p[2] += kVelocityNoise;
+  }
+  // Width and height may not collapse
+  track.state[2][0] = std::max(track.state[2][0], 1.0f);
+  track.state[3][0] = std::max(track.state[3][0], 1.0f);
+  table_.addAge(slot);
+  storeTrack(slot);
+}
+
+/**
+ * @brief Corrects the Kalman filters of a track with a measured box
+ */
+void Track::correctTrack(int slot, const cv::Rect2d &box) {
+  MotionTrack &track = filters_[slot];
+  const float measurement[4] = {static_cast<float>(box.x + box.width / 2),
+  static_cast<float>(box.y + box.height / 2),
+  static_cast<float>(box.width), static_cast<float>(box.height)};
+  // Measurement H = [1 0], gain K = P H^T / (H P H^T + R)
+  for (int k = 0; k < 4; ++k) {
+    float *x = track.state[k];
+    float *p = track.covariance[k];
+    float innovation = measurement[k] - x[0];
+    float s = p[0] + kMeasurementNoise;
+    float k0 = p[0] / s;
+    float k1 = p[1] / s;
+    x[0] += k0 * innovation;
+    x[1] += k1 * innovation;
+    p[2] -= k1 * p[1];
+    p[1] -= k0 * p[1];
+    p[0] -= k0 * p[0];
+  }
+  storeTrack(slot);
+}
+
+/**
+ * @brief Copies the box and velocity of the filters of a track into the table
+ */
+void Track::storeTrack(int slot) {
+  const MotionTrack &track = filters_[slot];
+  table_.setBox(slot, trackBox(track));
+  table_.setVelocity(slot, track.state[0][1], track.state[1][1]);
+}
+
+/**
+ * @brief Gets the current box of a SORT track
+ */
+cv::Rect2d Track::trackBox(const MotionTrack &track) {
+  double width = std::max(track.state[2][0], 1.0f);
+  double height = std::max(track.state[3][0], 1.0f);
+  return cv::Rect2d(track.state[0][0] - width / 2,
+  track.state[1][0] - height / 2, width, height);
+}
+
+/**
+ * @brief Intersection over union of two boxes
+ */
+double Track::iou(const cv::Rect2d &a, const cv::Rect2d &b) {
+  double intersection = (a & b).area();
+  double unionArea = a.area() + b.area() - intersection;
+  return unionArea > 0 ? intersection / unionArea : 0;
+}
+
+/**
+ * @brief Solves the rectangular assignment problem with the Hungarian algorithm
+ */
+std::vector<int> Track::solveAssignment(
+const std::vector<std::vector<double>> &cost) {
+  const int rows = static_cast<int>(cost.size());
+  const int cols = rows ? static_cast<int>(cost[0].size()) : 0;
+  std::vector<int> assignment(rows, -1);
+  if (rows == 0 || cols == 0)
+    return assignment;
+  // The algorithm below needs n <= m, solve the transpose otherwise
+  const bool transposed = rows > cols;
+  const int n = transposed ? cols : rows;
+  const int m = transposed ? rows : cols;
+  auto at = [&](int i, int j) {
+    return transposed ? cost[j][i] : cost[i][j];
+  };
+  const double inf = std::numeric_limits<double>::infinity();
+  std::vector<double> u(n + 1, 0), v(m + 1, 0);
+  std::vector<int> p(m + 1, 0), way(m + 1, 0);
+  for (int i = 1; i <= n; ++i) {
+    p[0] = i;
+    int j0 = 0;
+    std::vector<double> minv(m + 1, inf);
+    std::vector<bool> used(m + 1, false);
+    do {
+      used[j0] = true;
+      int i0 = p[j0];
+      int j1 = 0;
+      double delta = inf;
+      for (int j = 1; j <= m; ++j) {
+        if (used[j])
+          continue;
+        double current = at(i0 - 1, j - 1) - u[i0] - v[j];
+        if (current < minv[j]) {
+          minv[j] = current;
+          way[j] = j0;
+        }
+        if (minv[j] < delta) {
+          delta = minv[j];
+          j1 = j;
+        }
+      }
+      for (int j = 0; j <= m; ++j) {
+        if (used[j]) {
+          u[p[j]] += delta;
+          v[j] -= delta;
+        } else {
+          minv[j] -= delta;
+        }
+      }
+      j0 = j1;
+    } while (p[j0] != 0);
+    do {
+      int j1 = way[j0];
+      p[j0] = p[j1];
+      j0 = j1;
+    } while (j0);
+  }
+  for (int j = 1; j <= m; ++j) {
+    if (!p[j])
+      continue;
+    if (transposed)
+      assignment[j - 1] = p[j] - 1;
+    else
+      assignment[p[j] - 1] = j - 1;
+  }
+  return assignment;
 }
@@ -0,0 +1,205 @@
+/**
+ * @file    TrackTable.cpp
+ * @author  Sneha Nayak, Sukoon Sarin
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ * @version 0.1
+ * @date 2020-12-14
+ * @brief Implementation of the table of tracked persons
+ */
+
+#include <algorithm>
+#include "../include/TrackTable.h"
+
+namespace {
+/**
+ * @brief Tracks the table has room for before it first grows
+ */
+const size_t kInitialCapacity = 256;
+}  // namespace
+
+/**
+ * @brief TrackTable constructor.
+ */
+TrackTable::TrackTable() {
+  reserve(kInitialCapacity);
+}
+
+/**
+ * @brief Makes room for a number of tracks
+ */
+void TrackTable::reserve(size_t capacity) {
+  if (capacity <= x_.capacity())
+    return;
+  for (auto *column : {&x_, &y_, &width_, &height_, &velocityX_, &velocityY_,
+  &poseX_, &poseY_})
+    column->reserve(capacity);
+  for (auto *column : {&age_, &hits_, &misses_, &id_, &slots_, &free_})
+    column->reserve(capacity);
+}
+
+/**
+ * @brief Ends all tracks
+ */
+void TrackTable::clear() {
+  for (auto *column : {&x_, &y_, &width_, &height_, &velocityX_, &velocityY_,
+  &poseX_, &poseY_})
+    column->clear();
+  for (auto *column : {&age_, &hits_, &misses_, &id_, &slots_, &free_})
+    column->clear();
+}
+
+/**
+ * @brief Starts a track
+ */
+int TrackTable::acquire(int id) {
+  int slot;
+  if (!free_.empty()) {
+    slot = free_.back();
+    free_.pop_back();
+  } else {
+    // All columns grow together, and only past the largest crowd seen so far
+    if (x_.size() == x_.capacity())
+      reserve(2 * x_.capacity());
+    slot = static_cast<int>(x_.size());
+    for (auto *column : {&x_, &y_, &width_, &height_, &velocityX_, &velocityY_,
+    &poseX_, &poseY_})
+      column->push_back(0);
+    for (auto *column : {&age_, &hits_, &misses_, &id_})
+      column->push_back(0);
+  }
+  x_[slot] = y_[slot] = width_[slot] = height_[slot] = 0;
+  velocityX_[slot] = velocityY_[slot] = 0;
+  poseX_[slot] = poseY_[slot] = 0;
+  age_[slot] = hits_[slot] = misses_[slot] = 0;
+  id_[slot] = id;
+  slots_.push_back(slot);
+  return slot;
+}
+
+/**
+ * @brief Ends the track in a slot
+ */
+void TrackTable::release(int slot) {
+  auto live = std::find(slots_.begin(), slots_.end(), slot);
+  if (live == slots_.end())
+    return;
+  slots_.erase(live);
+  free_.push_back(slot);
+}
+
+/**
+ * @brief Sets the box of a slot and its pose in the camera frame
+ */
+void TrackTable::setBox(int slot, const cv::Rect2d &box) {
+  x_[slot] = static_cast<float>(box.x);
+  y_[slot] = static_cast<float>(box.y);
+  width_[slot] = static_cast<float>(box.width);
+  height_[slot] = static_cast<float>(box.height);
+  // The pose is the center of the box
+  poseX_[slot] = x_[slot] + width_[slot] / 2;
+  poseY_[slot] = y_[slot] + height_[slot] / 2;
+}
+
+/**
+ * @brief Sets the velocity of the box center of a slot
+ */
+void TrackTable::setVelocity(int slot, float velocityX, float velocityY) {
+  velocityX_[slot] = velocityX;
+  velocityY_[slot] = velocityY;
+}
+
+/**
+ * @brief Counts a match of a slot
+ */
+void TrackTable::addHit(int slot) {
+  hits_[slot]++;
+  misses_[slot] = 0;
+}
+
+/**
+ * @brief Counts a miss of a slot
+ */
+void TrackTable::addMiss(int slot) {
+  misses_[slot]++;
+}
+
+/**
+ * @brief Ages a slot by one frame
+ */
+void TrackTable::addAge(int slot) {
+  age_[slot]++;
+}
+
+/**
+ * @brief Gets the box of a slot
+ */
+cv::Rect2d TrackTable::getBox(int slot) const {
+  return cv::Rect2d(x_[slot], y_[slot], width_[slot], height_[slot]);
+}
+
+/**
+ * @brief Gets the ID of a slot
+ */
+int TrackTable::getId(int slot) const {
+  return id_[slot];
+}
+
+/**
+ * @brief Gets the misses in a row of a slot
+ */
+int TrackTable::getMisses(int slot) const {
+  return misses_[slot];
+}
+
+/**
+ * @brief Gets the slot of a live track
+ */
+int TrackTable::findSlot(int id) const {
+  for (int slot : slots_)
+    if (id_[slot] == id)
+      return slot;
+  return -1;
+}
+
+/**
+ * @brief Gets the slots of the live tracks
+ */
+const std::vector<int> &TrackTable::getSlots() const {
+  return slots_;
+}
+
+/**
+ * @brief Gets the number of live tracks
+ */
+size_t TrackTable::size() const {
+  return slots_.size();
+}
+
+/**
+ * @brief Gets the number of tracks the table holds without allocating
+ */
+size_t TrackTable::capacity() const {
+  return x_.capacity();
+}
+
+/**
+ * @brief Gets a view of the live tracks
+ */
+TrackView TrackTable::view() const {
+  TrackView view;
+  view.slots = slots_.data();
+  view.count = slots_.size();
+  view.x = x_.data();
+  view.y = y_.data();
+  view.width = width_.data();
+  view.height = height_.data();
+  view.velocityX = velocityX_.data();
+  view.velocityY = velocityY_.data();
+  view.age = age_.data();
+  view.hits = hits_.data();
+  view.misses = misses_.data();
+  view.id = id_.data();
+  view.poseX = poseX_.data();
+  view.poseY = poseY_.data();
+  return view;
+}
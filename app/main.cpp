@@ -9,8 +9,18 @@
 
 #include <iostream>
 #include <fstream>
+#include <memory>
 #include <sstream>
 #include "../include/DataLoader.h"
+#include "../include/OfflineProcessor.h"
+#include "../include/ImageBatchProcessor.h"
+#include "../include/Profiler.h"
+
+namespace {
+/** @brief Taken during static initialization, before main and any model loading */
+const std::chrono::steady_clock::time_point kLaunchTime =
+std::chrono::steady_clock::now();
+}  // namespace
 
 /**
  * @fn main
@@ -26,7 +36,69 @@ int main(int argc, char **argv) {
         "/object_detection_yolo.out --image=dog.jpg \n\t\t."
         "/object_detection_yolo.out --video=run_sm.mp4}"
         "{image i        |<none>| input image   }"
-        "{video v       |<none>| input video   }";
+        "{video v       |<none>| input video   }"
+        "{pipeline      |      | run decode, inference, tracking and encode"
+        " on separate threads }"
+        "{realtime      |      | work on the newest frame and drop stale ones }"
+        "{latency       | 200  | end-to-end latency budget in ms for --realtime }"
+        "{streams       |      | comma separated videos or camera indices"
+        " processed concurrently }"
+        "{sort          |      | track with Kalman filters and IoU matching"
+        " instead of KCF }"
+        "{tracker-threads | 1  | threads updating the per-person trackers }"
+        "{adaptive      |      | run detection when tracking degrades or the"
+        " scene moves instead of every 45th frame }"
+        "{cpu-budget    | 0.5  | fraction of time --adaptive may spend"
+        " in detection }"
+        "{roi           |      | detect only around tracked people between"
+        " full-frame passes }"
+        "{full-frame-every | 4 | detection passes per full-frame pass"
+        " for --roi }"
+        "{tiles         |      | detect on overlapping native resolution"
+        " tiles }"
+        "{tile-size     | 416  | tile side in pixels for --tiles }"
+        "{tile-overlap  | 0.2  | overlap of neighbouring tiles for --tiles }"
+        "{tile-batch    | 16   | tiles per forward pass for --tiles, 0 for"
+        " all changed tiles in one pass }"
+        "{motion-gate   |      | skip detection and tracking while the scene"
+        " does not change }"
+        "{gate-threshold | 12  | gray level change of a changed block"
+        " for --motion-gate }"
+        "{stretch       |      | stretch frames to the network input like"
+        " blobFromImage instead of letterboxing them }"
+        "{preprocess-threads | 1 | threads letterboxing large frames }"
+        "{profile       | yolov4 | model: yolov4, yolov4-320, yolov4-tiny,"
+        " onnx-fp16 or onnx-int8 }"
+        "{compare-profiles |   | measure latency and agreement with yolov4"
+        " of every profile on --video }"
+        "{compare-frames | 100 | frames used by --compare-profiles }"
+        "{offline       |      | process --video by segment on all cores"
+        " and stitch the track IDs }"
+        "{segment-workers | 0  | worker threads for --offline, 0 for one"
+        " per core }"
+        "{keyframe-interval | 250 | keyframe interval of --video in frames }"
+        "{segment-overlap | 45 | frames tracked twice to stitch segments }"
+        "{images        |      | directory or glob of still images"
+        " detected in batches without tracking }"
+        "{output-dir    |      | directory of the annotated --images }"
+        "{results       | results.csv | results file of --images }"
+        "{batch-size    | 4    | images per forward pass for --images }"
+        "{fresh         |      | start --images over instead of resuming }"
+        "{headless      |      | no drawing, display or encoding, write"
+        " the tracks of every frame as JSON lines }"
+        "{headless-output | -  | results file of --headless, - for stdout }"
+        "{shm           |      | publish the tracks of every frame to this"
+        " shared memory ring, like /human_tracks }"
+        "{shm-capacity  | 64   | frames the --shm ring holds }"
+        "{stages        |      | time every stage and print p50/p95/p99/max"
+        " latencies at exit }"
+        "{stages-interval | 0  | also print the --stages report every"
+        " this many seconds }"
+        "{trace         |      | write a Chrome trace of every --stages"
+        " interval to this file }"
+        "{nms-method    | greedy | greedy, diou, soft-linear or soft-gaussian"
+        " suppression of overlapping boxes }"
+        "{max-detections | 0   | most people kept per frame, 0 for no limit }";
     // takes as input commandline arguments
     cv::CommandLineParser parser(argc, argv, keys);
     parser.about("Use this script to run Human detection"
@@ -35,6 +107,84 @@ int main(int argc, char **argv) {
         parser.printMessage();
         return 0;
     }
+    // Headless results on stdout must not mix with the progress messages
+    bool resultsOnStdout = parser.has("headless") &&
+    parser.get<std::string>("headless-output") == "-";
+    if (resultsOnStdout)
+        std::cout.rdbuf(std::cerr.rdbuf());
+    DataLoader::sharedDetection().setLaunchTime(kLaunchTime);
+    // Reports when main returns, so every mode below is covered
+    std::unique_ptr<ProfilerSession> stages;
+    if (parser.has("stages") || parser.has("trace"))
+        stages.reset(new ProfilerSession(parser.get<double>("stages-interval"),
+        parser.has("trace") ? parser.get<std::string>("trace") : ""));
+    if (parser.has("compare-profiles")) {
+        std::string clip = parser.has("video") ?
+        parser.get<std::string>("video") : std::string("../run.mp4");
+        ModelProfiles::printComparison(ModelProfiles::compare(clip,
+        parser.get<int>("compare-frames")));
+        return 0;
+    }
+    // The model, preprocessing and NMS settings apply to every mode below
+    ModelProfile profile = ModelProfile::YOLOV4;
+    if (!ModelProfiles::parse(parser.get<std::string>("profile"), profile)) {
+        std::cout << "Unknown model profile "
+        << parser.get<std::string>("profile") << std::endl;
+        return 1;
+    }
+    if (profile != ModelProfile::YOLOV4)
+        DataLoader::sharedDetection().setModelProfile(profile);
+    if (parser.has("stretch"))
+        DataLoader::sharedDetection().setLetterbox(false);
+    DataLoader::sharedDetection().setPreprocessThreads(
+    parser.get<int>("preprocess-threads"));
+    NmsOptions nmsOptions;
+    if (!Nms::parseMethod(parser.get<std::string>("nms-method"),
+    nmsOptions.method)) {
+        std::cout << "Unknown NMS method "
+        << parser.get<std::string>("nms-method") << std::endl;
+        return 1;
+    }
+    nmsOptions.maxDetections = parser.get<int>("max-detections");
+    DataLoader::sharedDetection().setNmsOptions(nmsOptions);
+    if (parser.has("offline") && parser.has("video")) {
+        std::string video = parser.get<std::string>("video");
+        std::string stem = video.substr(0, video.find_last_of('.'));
+        OfflineProcessor offline;
+        offline.setNumWorkers(parser.get<int>("segment-workers"));
+        offline.setKeyframeInterval(parser.get<int>("keyframe-interval"));
+        offline.setOverlap(parser.get<int>("segment-overlap"));
+        offline.setModelConfig(profile, nmsOptions, !parser.has("stretch"));
+        if (!offline.process(video, stem + "_YOLOv4_output_cpp.avi",
+        stem + "_detections.csv"))
+            return 1;
+        offline.printStats();
+        return 0;
+    }
+    if (parser.has("images")) {
+        ImageBatchProcessor batch;
+        if (parser.has("output-dir"))
+            batch.setOutputDirectory(parser.get<std::string>("output-dir"));
+        batch.setResultsFile(parser.get<std::string>("results"));
+        batch.setResume(!parser.has("fresh"));
+        Detection &detection = DataLoader::sharedDetection();
+        detection.setBatchSize(parser.get<int>("batch-size"));
+        if (!batch.process(detection, parser.get<std::string>("images")))
+            return 1;
+        batch.printStats();
+        return 0;
+    }
+    if (parser.has("streams")) {
+        std::vector<std::string> inputs;
+        std::stringstream streams(parser.get<std::string>("streams"));
+        std::string input;
+        while (std::getline(streams, input, ','))
+            if (!input.empty())
+                inputs.push_back(input);
+        DataLoader::processStreams(inputs, parser.has("sort") ?
+        TrackerMode::SORT : TrackerMode::KCF, parser.has("adaptive"));
+        return 0;
+    }
     int input_type = data.checkParser(parser);
     // If no command line argument provided, takes default values of Constructor
     if (input_type == -1) {
@@ -42,6 +192,29 @@ int main(int argc, char **argv) {
         std::cout << "Data input method is : " <<
         data.getInputStreamMethod() << std::endl;
     }
+    if (parser.has("sort"))
+        data.setTrackerMode(TrackerMode::SORT);
+    data.setTrackerThreads(parser.get<int>("tracker-threads"));
+    if (parser.has("adaptive")) {
+        data.setAdaptiveDetection(true);
+        data.getDetectionPolicy().setCpuBudget(parser.get<double>("cpu-budget"));
+    }
+    if (parser.has("roi"))
+        data.setRoiDetection(true, parser.get<int>("full-frame-every"));
+    if (parser.has("tiles"))
+        data.setTiledDetection(true, parser.get<int>("tile-size"),
+        parser.get<double>("tile-overlap"), parser.get<int>("tile-batch"));
+    if (parser.has("motion-gate"))
+        data.setMotionGate(true, parser.get<double>("gate-threshold"));
+    if (parser.has("shm") && !data.setShmPublisher(true,
+    parser.get<std::string>("shm"), parser.get<int>("shm-capacity")))
+        return 1;
+    if (parser.has("headless"))
+        data.setHeadless(true, parser.get<std::string>("headless-output"));
+    if (parser.has("pipeline"))
+        data.setPipelined(true);
+    if (parser.has("realtime"))
+        data.setRealtime(true, parser.get<double>("latency"));
     data.processInput(parser);
 
     return 0;
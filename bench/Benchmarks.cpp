@@ -0,0 +1,364 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file Benchmarks.cpp
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Google Benchmark suite of the detection, NMS, tracking and preprocessing hot paths,
+ * and of end-to-end throughput on the sample video and image
+ * @version 0.1
+ * @date 2020-12-11
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+#include <benchmark/benchmark.h>
+#include <fstream>
+#include <random>
+#include <vector>
+#include <opencv2/dnn.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/videoio.hpp>
+#include "../include/Detection.h"
+#include "../include/Nms.h"
+#include "../include/Preprocessor.h"
+#include "../include/Track.h"
+
+namespace {
+const char *kVideo = "../run.mp4";
+const char *kImage = "../person.jpg";
+const char *kConfig = "../yolov4.cfg";
+const char *kWeights = "../yolov4.weights";
+// Frames of run.mp4 one end-to-end iteration covers, two detection passes
+const int kVideoFrames = 90;
+// Detection cadence of the sequential loop in DataLoader
+const int kDetectionInterval = 45;
+
+/**
+ * @brief Detector shared by all benchmarks, the model is loaded once
+ */
+Detection &sharedDetection() {
+  static Detection detection;
+  return detection;
+}
+
+/**
+ * @brief The sample image, or a gray 1080p frame when it is missing
+ */
+const cv::Mat &sampleImage() {
+  static cv::Mat image = [] {
+    cv::Mat loaded = cv::imread(kImage);
+    return loaded.empty() ? cv::Mat(1080, 1920, CV_8UC3,
+    cv::Scalar::all(127)) : loaded;
+  }();
+  return image;
+}
+
+/**
+ * @brief Random person boxes in clusters of heavily overlapping candidates,
+ *        the way YOLO reports a crowd, with scores above the threshold
+ */
+void clusteredBoxes(int count, cv::Size frameSize, std::mt19937 &rng,
+std::vector<cv::Rect> &boxes, std::vector<float> &scores) {
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  std::normal_distribution<float> jitter(0.f, 6.f);
+  boxes.clear();
+  scores.clear();
+  cv::Rect person;
+  for (int i = 0; i < count; ++i) {
+    if (i % 8 == 0) {
+      int height = 60 + static_cast<int>(unit(rng) * 240);
+      int width = height * 2 / 5;
+      person = cv::Rect(static_cast<int>(unit(rng) * (frameSize.width - width)),
+      static_cast<int>(unit(rng) * (frameSize.height - height)), width,
+      height);
+    }
+    boxes.emplace_back(person.x + static_cast<int>(jitter(rng)),
+    person.y + static_cast<int>(jitter(rng)),
+    person.width + static_cast<int>(jitter(rng)),
+    person.height + static_cast<int>(jitter(rng)));
+    scores.push_back(0.5f + 0.5f * unit(rng));
+  }
+}
+
+/**
+ * @brief Synthetic outputs of the three YOLOv4 heads at 416x416 input, with
+ *        clusters of confident person rows over low scores
+ */
+std::vector<cv::Mat> syntheticOutputs() {
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  const int rows[] = {507, 2028, 8112};
+  std::vector<cv::Mat> outs;
+  for (int count : rows) {
+    cv::Mat out(count, 85, CV_32F, cv::Scalar(0));
+    for (int j = 0; j < count; ++j) {
+      float *row = out.ptr<float>(j);
+      row[0] = unit(rng);
+      row[1] = unit(rng);
+      row[2] = 0.02f + 0.1f * unit(rng);
+      row[3] = 0.05f + 0.3f * unit(rng);
+      row[4] = 0.05f * unit(rng);
+      if (unit(rng) < 0.01f)
+        row[4] = row[5] = 0.5f + 0.5f * unit(rng);
+    }
+    outs.push_back(out);
+  }
+  return outs;
+}
+
+/**
+ * @brief Network outputs recorded from YOLOv4 on the sample image with a
+ *        stretched input, or synthetic ones when the model is missing
+ */
+const std::vector<cv::Mat> &recordedOutputs() {
+  static std::vector<cv::Mat> outs = [] {
+    if (!std::ifstream(kConfig) || !std::ifstream(kWeights))
+      return syntheticOutputs();
+    cv::dnn::Net net = cv::dnn::readNetFromDarknet(kConfig, kWeights);
+    net.setInput(cv::dnn::blobFromImage(sampleImage(), 1 / 255.0,
+    cv::Size(416, 416), cv::Scalar(), true, false));
+    std::vector<cv::Mat> recorded;
+    net.forward(recorded, net.getUnconnectedOutLayersNames());
+    return recorded;
+  }();
+  return outs;
+}
+}  // namespace
+
+/**
+ * @brief Decoding and NMS of one frame of recorded network outputs
+ */
+static void BM_PostProcess(benchmark::State &state) {
+  Detection &detection = sharedDetection();
+  const std::vector<cv::Mat> &outs = recordedOutputs();
+  cv::Mat frame = sampleImage().clone();
+  detection.setDrawBoxes(false);
+  detection.setFrame(frame);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(detection.processOutputs(outs).data());
+  detection.setDrawBoxes(true);
+}
+BENCHMARK(BM_PostProcess)->Unit(benchmark::kMicrosecond);
+
+/**
+ * @brief OpenCV NMS on clustered candidates at the thresholds of Detection
+ */
+static void BM_NMSBoxes(benchmark::State &state) {
+  std::mt19937 rng(42);
+  std::vector<cv::Rect> boxes;
+  std::vector<float> scores;
+  clusteredBoxes(static_cast<int>(state.range(0)), cv::Size(1920, 1080), rng,
+  boxes, scores);
+  std::vector<int> indices;
+  for (auto _ : state) {
+    cv::dnn::NMSBoxes(boxes, scores, 0.5f, 0.4f, indices);
+    benchmark::DoNotOptimize(indices.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_NMSBoxes)->Arg(100)->Arg(1000)->Arg(10000)
+->Unit(benchmark::kMicrosecond);
+
+/**
+ * @brief Grid and SIMD NMS on the same candidates, by method
+ */
+static void BM_Nms(benchmark::State &state) {
+  std::mt19937 rng(42);
+  std::vector<cv::Rect> boxes;
+  std::vector<float> scores;
+  clusteredBoxes(static_cast<int>(state.range(0)), cv::Size(1920, 1080), rng,
+  boxes, scores);
+  NmsOptions options;
+  options.method = static_cast<NmsMethod>(state.range(1));
+  Nms nms;
+  nms.setOptions(options);
+  std::vector<int> indices;
+  for (auto _ : state) {
+    nms.run(boxes, scores, 0.5f, 0.4f, indices);
+    benchmark::DoNotOptimize(indices.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Nms)->ArgNames({"boxes", "method"})
+->ArgsProduct({{100, 1000, 10000}, {0, 1, 2, 3}})
+->Unit(benchmark::kMicrosecond);
+
+/**
+ * @brief Shrinking detections to the tracked body
+ */
+static void BM_ResizeBoxes(benchmark::State &state) {
+  std::mt19937 rng(42);
+  std::vector<cv::Rect> boxes;
+  std::vector<float> scores;
+  clusteredBoxes(static_cast<int>(state.range(0)), cv::Size(1920, 1080), rng,
+  boxes, scores);
+  Track track;
+  std::vector<cv::Rect> resized;
+  for (auto _ : state) {
+    resized = boxes;
+    for (auto &box : resized)
+      track.resizeBoxes(box);
+    benchmark::DoNotOptimize(resized.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ResizeBoxes)->Arg(16)->Arg(256);
+
+/**
+ * @brief Camera frame poses of all SORT tracks
+ */
+static void BM_TrackedPoses(benchmark::State &state) {
+  std::mt19937 rng(42);
+  std::vector<cv::Rect> boxes;
+  std::vector<float> scores;
+  clusteredBoxes(static_cast<int>(state.range(0)) * 8, cv::Size(1920, 1080),
+  rng, boxes, scores);
+  std::vector<cv::Rect> people;
+  for (size_t i = 0; i < boxes.size(); i += 8)
+    people.push_back(boxes[i]);
+  cv::Mat frame(1080, 1920, CV_8UC3, cv::Scalar::all(127));
+  Track track;
+  track.setTrackerMode(TrackerMode::SORT);
+  track.initializeTracker();
+  track.setFrame(frame);
+  track.runTrackerAlgorithm(people);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(track.getTrackedPoses().data());
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TrackedPoses)->Arg(10)->Arg(100);
+
+/**
+ * @brief Camera frame poses of all SORT tracks, read in place from the track table
+ */
+static void BM_TrackView(benchmark::State &state) {
+  std::mt19937 rng(42);
+  std::vector<cv::Rect> boxes;
+  std::vector<float> scores;
+  clusteredBoxes(static_cast<int>(state.range(0)) * 8, cv::Size(1920, 1080),
+  rng, boxes, scores);
+  std::vector<cv::Rect> people;
+  for (size_t i = 0; i < boxes.size(); i += 8)
+    people.push_back(boxes[i]);
+  cv::Mat frame(1080, 1920, CV_8UC3, cv::Scalar::all(127));
+  Track track;
+  track.setTrackerMode(TrackerMode::SORT);
+  track.initializeTracker();
+  track.setFrame(frame);
+  track.runTrackerAlgorithm(people);
+  for (auto _ : state) {
+    TrackView view = track.getTrackTable().view();
+    float sum = 0;
+    for (size_t i = 0; i < view.count; ++i)
+      sum += view.poseX[view.slots[i]] + view.poseY[view.slots[i]];
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TrackView)->Arg(10)->Arg(100)->Arg(1000);
+
+/**
+ * @brief SORT prediction and assignment of one detection pass
+ */
+static void BM_SortTrackDetections(benchmark::State &state) {
+  std::mt19937 rng(42);
+  std::vector<cv::Rect> boxes;
+  std::vector<float> scores;
+  clusteredBoxes(static_cast<int>(state.range(0)) * 8, cv::Size(1920, 1080),
+  rng, boxes, scores);
+  std::vector<cv::Rect> people;
+  for (size_t i = 0; i < boxes.size(); i += 8)
+    people.push_back(boxes[i]);
+  cv::Mat frame(1080, 1920, CV_8UC3, cv::Scalar::all(127));
+  Track track;
+  track.setTrackerMode(TrackerMode::SORT);
+  track.initializeTracker();
+  track.setFrame(frame);
+  for (auto _ : state)
+    track.runTrackerAlgorithm(people);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SortTrackDetections)->Arg(10)->Arg(100)
+->Unit(benchmark::kMicrosecond);
+
+/**
+ * @brief Fused letterbox preprocessing of a 1080p frame against blobFromImage
+ */
+static void BM_Preprocess(benchmark::State &state) {
+  cv::Mat frame(1080, 1920, CV_8UC3);
+  cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+  const cv::Size inputSize(416, 416);
+  Preprocessor preprocessor;
+  preprocessor.setInputSize(inputSize);
+  cv::Mat blob(std::vector<int>{1, 3, inputSize.height, inputSize.width},
+  CV_32F);
+  const bool fused = state.range(0) != 0;
+  for (auto _ : state) {
+    if (fused)
+      preprocessor.run(frame, blob.ptr<float>());
+    else
+      blob = cv::dnn::blobFromImage(frame, 1 / 255.0, inputSize,
+      cv::Scalar(), true, false);
+    benchmark::DoNotOptimize(blob.data);
+  }
+}
+BENCHMARK(BM_Preprocess)->ArgName("fused")->Arg(0)->Arg(1)
+->Unit(benchmark::kMicrosecond);
+
+/**
+ * @brief Detection of the sample image, end to end
+ */
+static void BM_EndToEndImage(benchmark::State &state) {
+  Detection &detection = sharedDetection();
+  if (!detection.isModelLoaded()) {
+    state.SkipWithError("model files not found");
+    return;
+  }
+  cv::Mat frame;
+  for (auto _ : state) {
+    frame = sampleImage().clone();
+    detection.setFrame(frame);
+    benchmark::DoNotOptimize(detection.processFrameforHuman().data());
+  }
+  state.counters["fps"] = benchmark::Counter(
+  static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_EndToEndImage)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/**
+ * @brief Decode, detection every 45th frame, KCF tracking and drawing of the
+ *        start of the sample video, like the sequential loop
+ */
+static void BM_EndToEndVideo(benchmark::State &state) {
+  Detection &detection = sharedDetection();
+  if (!detection.isModelLoaded()) {
+    state.SkipWithError("model files not found");
+    return;
+  }
+  int64_t frames = 0;
+  for (auto _ : state) {
+    cv::VideoCapture capture(kVideo);
+    if (!capture.isOpened()) {
+      state.SkipWithError("sample video not found");
+      return;
+    }
+    Track track;
+    track.initializeTracker();
+    cv::Mat frame;
+    for (int i = 0; i < kVideoFrames && capture.read(frame); ++i, ++frames) {
+      detection.setFrame(frame);
+      track.setFrame(frame);
+      if (i % kDetectionInterval == 0)
+        track.runTrackerAlgorithm(detection.processFrameforHuman());
+      else
+        track.updateTracker();
+      benchmark::DoNotOptimize(track.drawGreenBoundingBox().data);
+    }
+  }
+  state.counters["fps"] = benchmark::Counter(static_cast<double>(frames),
+  benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_EndToEndVideo)->Unit(benchmark::kMillisecond)->UseRealTime()
+->Iterations(3);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,107 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file DecodeBench.cpp
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Micro-benchmark of the person-only and full-class YOLO output decoders
+ * @version 0.1
+ * @date 2020-11-24
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "../include/Detection.h"
+
+/**
+ * @brief Builds a synthetic YOLO output with a few confident rows, like a real frame
+ * @param rows number of candidate rows
+ * @param rng random generator
+ * @return cv::Mat rows x 85 float output
+ */
+cv::Mat makeOutput(int rows, std::mt19937 &rng) {
+  std::uniform_real_distribution<float> low(0.f, 0.1f);
+  std::uniform_real_distribution<float> high(0.5f, 1.f);
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  cv::Mat out(rows, 85, CV_32F);
+  for (int j = 0; j < rows; ++j) {
+    float *row = out.ptr<float>(j);
+    for (int c = 0; c < 4; ++c)
+      row[c] = unit(rng);
+    for (int c = 4; c < 85; ++c)
+      row[c] = low(rng);
+    // About one row in two hundred is a confident detection,
+    // a quarter of those belong to another class
+    if (unit(rng) < 0.005f) {
+      int cls = unit(rng) < 0.75f ? 0 : 1 + static_cast<int>(unit(rng) * 79);
+      row[4] = high(rng);
+      row[5 + cls] = row[4];
+    }
+  }
+  return out;
+}
+
+/**
+ * @brief Runs fn repeatedly and returns the mean time per call in microseconds
+ */
+template <typename Fn>
+double timeUs(Fn fn, int iterations) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i)
+    fn();
+  return std::chrono::duration<double, std::micro>
+  (std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+/**
+ * @brief Main function of the decoder benchmark
+ * @return int : Exit code 1 if the decoders disagree
+ */
+int main() {
+  std::mt19937 rng(42);
+  const cv::Size frameSize(1920, 1080);
+  const float confThreshold = 0.5f;
+  const int iterations = 200;
+  // Candidate rows of YOLOv4 at 416x416 and 608x608 input
+  const int candidateCounts[] = {10647, 22743};
+  int status = 0;
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "rows     full-class us   person-only us   speedup" << std::endl;
+  for (int rows : candidateCounts) {
+    cv::Mat out = makeOutput(rows, rng);
+    std::vector<int> ids;
+    std::vector<cv::Rect> fullBoxes, personBoxes;
+    std::vector<float> fullConf, personConf;
+    double fullUs = timeUs([&] {
+      ids.clear();
+      fullBoxes.clear();
+      fullConf.clear();
+      Detection::decodeAllClassRows(out, confThreshold, frameSize, ids,
+      fullBoxes, fullConf);
+    }, iterations);
+    double personUs = timeUs([&] {
+      personBoxes.clear();
+      personConf.clear();
+      Detection::decodePersonRows(out, 0, confThreshold, frameSize,
+      personBoxes, personConf);
+    }, iterations);
+
+    std::vector<cv::Rect> expected;
+    for (size_t i = 0; i < ids.size(); ++i)
+      if (ids[i] == 0)
+        expected.push_back(fullBoxes[i]);
+    if (expected != personBoxes) {
+      std::cout << "person-only decoder disagrees with full-class decoder"
+      << std::endl;
+      status = 1;
+    }
+    std::cout << std::setw(6) << rows << std::setw(16) << fullUs
+    << std::setw(17) << personUs << std::setw(9) << fullUs / personUs
+    << "x" << std::endl;
+  }
+  return status;
+}
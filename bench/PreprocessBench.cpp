@@ -0,0 +1,100 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file PreprocessBench.cpp
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Micro-benchmark of blobFromImage against the fused letterbox kernel
+ * @version 0.1
+ * @date 2020-12-06
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <opencv2/dnn.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "../include/Preprocessor.h"
+
+/**
+ * @brief Runs fn repeatedly and returns the mean time per call in microseconds
+ */
+template <typename Fn>
+double timeUs(Fn fn, int iterations) {
+  fn();
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i)
+    fn();
+  return std::chrono::duration<double, std::micro>
+  (std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+/**
+ * @brief Builds the letterboxed reference blob with separate OpenCV calls
+ */
+cv::Mat referenceBlob(const cv::Mat &frame, const LetterboxInfo &info,
+cv::Size inputSize) {
+  cv::Mat resized, padded;
+  cv::resize(frame, resized, info.content, 0, 0, cv::INTER_LINEAR);
+  cv::copyMakeBorder(resized, padded, info.padY,
+  inputSize.height - info.content.height - info.padY, info.padX,
+  inputSize.width - info.content.width - info.padX, cv::BORDER_CONSTANT,
+  cv::Scalar::all(127.5));
+  return cv::dnn::blobFromImage(padded, 1 / 255.0, cv::Size(), cv::Scalar(),
+  true, false);
+}
+
+/**
+ * @brief Main function of the preprocessing benchmark
+ * @return int : Exit code 1 if the kernel disagrees with the reference
+ */
+int main() {
+  const cv::Size inputSize(416, 416);
+  const cv::Size frameSizes[] = {cv::Size(640, 480), cv::Size(1920, 1080),
+  cv::Size(3840, 2160)};
+  const int iterations = 100;
+  const int threads = std::max(1u, std::thread::hardware_concurrency());
+  int status = 0;
+  Preprocessor single, multi;
+  single.setInputSize(inputSize);
+  multi.setInputSize(inputSize);
+  multi.setNumThreads(threads);
+  cv::Mat blob(std::vector<int>{1, 3, inputSize.height, inputSize.width},
+  CV_32F);
+  std::cout << std::fixed << std::setprecision(1);
+  std::cout << "frame        blobFromImage us   fused us   fused x"
+  << threads << " us   max error" << std::endl;
+  for (const cv::Size &size : frameSizes) {
+    cv::Mat frame(size, CV_8UC3);
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::Mat stretched;
+    double blobUs = timeUs([&] {
+      stretched = cv::dnn::blobFromImage(frame, 1 / 255.0, inputSize,
+      cv::Scalar(), true, false);
+    }, iterations);
+    double fusedUs = timeUs([&] {
+      single.run(frame, blob.ptr<float>());
+    }, iterations);
+    double multiUs = timeUs([&] {
+      multi.run(frame, blob.ptr<float>());
+    }, iterations);
+
+    LetterboxInfo info = single.run(frame, blob.ptr<float>());
+    double error = cv::norm(blob, referenceBlob(frame, info, inputSize),
+    cv::NORM_INF);
+    if (error > 2 / 255.0) {
+      std::cout << "fused kernel disagrees with resize and copyMakeBorder"
+      << std::endl;
+      status = 1;
+    }
+    std::cout << std::setw(4) << size.width << "x" << std::left
+    << std::setw(8) << size.height << std::right << std::setw(16) << blobUs
+    << std::setw(11) << fusedUs << std::setw(14) << multiUs
+    << std::setprecision(4) << std::setw(12) << error
+    << std::setprecision(1) << std::endl;
+  }
+  return status;
+}
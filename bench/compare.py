@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+#
+# Copyright 2020 Sneha Nayak, Sukoon Sarin
+#
+# Compares a Google Benchmark JSON result of ./bench/bench against a stored
+# baseline and exits with 1 when any benchmark got slower than the threshold.
+#
+# Usage:
+#   ./bench/bench --benchmark_out=bench.json --benchmark_out_format=json
+#   python3 ../bench/compare.py bench.json                  # against the baseline
+#   python3 ../bench/compare.py bench.json --update         # store a new baseline
+#
+import argparse
+import json
+import os
+import shutil
+import sys
+
+DEFAULT_BASELINE = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                "baseline.json")
+
+
+def load_times(path, metric):
+    """Maps benchmark name to its time in nanoseconds, using the mean of
+    repetitions when the run had any and skipping errored benchmarks."""
+    with open(path) as f:
+        report = json.load(f)
+    scale = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+    times = {}
+    for bench in report.get("benchmarks", []):
+        if bench.get("error_occurred"):
+            continue
+        kind = bench.get("run_type", "iteration")
+        if kind == "aggregate" and bench.get("aggregate_name") != "mean":
+            continue
+        name = bench.get("run_name", bench["name"])
+        if kind == "iteration" and name in times:
+            continue
+        times[name] = bench[metric] * scale[bench.get("time_unit", "ns")]
+    return times
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Flags benchmarks slower than a stored baseline")
+    parser.add_argument("current", help="JSON output of ./bench/bench")
+    parser.add_argument("--baseline", default=DEFAULT_BASELINE,
+                        help="stored baseline JSON")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="percent slowdown flagged as a regression")
+    parser.add_argument("--metric", choices=["real_time", "cpu_time"],
+                        default="real_time")
+    parser.add_argument("--update", action="store_true",
+                        help="store the current result as the baseline")
+    args = parser.parse_args()
+
+    if args.update:
+        shutil.copyfile(args.current, args.baseline)
+        print("Baseline is stored as " + args.baseline)
+        return 0
+    if not os.path.exists(args.baseline):
+        print("No baseline at " + args.baseline + ", store one with --update")
+        return 1
+
+    baseline = load_times(args.baseline, args.metric)
+    current = load_times(args.current, args.metric)
+    regressions = 0
+    print("%-40s %14s %14s %9s" % ("benchmark", "baseline", "current",
+                                   "change"))
+    for name in sorted(set(baseline) | set(current)):
+        if name not in current:
+            print("%-40s %14.0f %14s %9s" % (name, baseline[name], "-",
+                                             "missing"))
+            continue
+        if name not in baseline:
+            print("%-40s %14s %14.0f %9s" % (name, "-", current[name], "new"))
+            continue
+        change = 100.0 * (current[name] - baseline[name]) / baseline[name]
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print("%-40s %14.0f %14.0f %+8.1f%%%s" % (name, baseline[name],
+                                                current[name], change, flag))
+    print("Times in ns, %d regression(s) above %.1f%%" % (regressions,
+                                                        args.threshold))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,162 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file BoundedQueue.h
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Header only blocking queue with a fixed capacity, used to connect pipeline stages.
+ * @version 0.1
+ * @date 2020-11-20
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+
+#ifndef INCLUDE_BOUNDEDQUEUE_H_
+#define INCLUDE_BOUNDEDQUEUE_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+/**
+ * @brief Thread safe FIFO queue that blocks producers when full and consumers when empty.
+ *
+ * @tparam T type of the queued items
+ */
+template <typename T>
+class BoundedQueue
+{
+
+private:
+    /**
+     * @brief Private variable for the queued items
+     *
+     */
+    std::deque<T> items_;
+
+    /**
+     * @brief Private variable for the maximum number of queued items
+     *
+     */
+    size_t capacity_;
+
+    /**
+     * @brief Private variable set once the producer side is finished
+     *
+     */
+    bool closed_ = false;
+
+    /**
+     * @brief Private variable for the deepest the queue has been
+     *
+     */
+    size_t maxDepth_ = 0;
+
+    /**
+     * @brief Private variables used to compute the average depth seen by producers
+     *
+     */
+    size_t depthSum_ = 0;
+    size_t pushCount_ = 0;
+
+    mutable std::mutex mutex_;
+    std::condition_variable notFull_;
+    std::condition_variable notEmpty_;
+
+public:
+    /**
+     * @brief Construct a new Bounded Queue object
+     * @param capacity maximum number of queued items, at least 1
+     */
+    explicit BoundedQueue(size_t capacity) : capacity_(capacity ? capacity : 1) {}
+
+    /**
+     * @brief Pushes an item, blocking while the queue is full
+     * @param item type : T
+     * @return bool - false if the queue was closed and the item was dropped
+     */
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notFull_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+        if (closed_)
+            return false;
+        items_.push_back(std::move(item));
+        depthSum_ += items_.size();
+        pushCount_++;
+        if (items_.size() > maxDepth_)
+            maxDepth_ = items_.size();
+        notEmpty_.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Pops the oldest item, blocking while the queue is empty
+     * @param item type : T& receives the popped item
+     * @return bool - false once the queue is closed and drained
+     */
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+        if (items_.empty())
+            return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        notFull_.notify_one();
+        return true;
+    }
+
+    /**
+     * @brief Closes the queue. Consumers drain the remaining items, producers are released.
+     * @param void
+     * @return void
+     */
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        notFull_.notify_all();
+        notEmpty_.notify_all();
+    }
+
+    /**
+     * @brief Gets the current number of queued items
+     * @param void
+     * @return size_t
+     */
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return items_.size();
+    }
+
+    /**
+     * @brief Gets the deepest the queue has been since construction
+     * @param void
+     * @return size_t
+     */
+    size_t getMaxDepth() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return maxDepth_;
+    }
+
+    /**
+     * @brief Gets the average depth right after each push
+     * @param void
+     * @return double
+     */
+    double getAverageDepth() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pushCount_ ? static_cast<double>(depthSum_) / pushCount_ : 0;
+    }
+
+    /**
+     * @brief Gets the capacity of the queue
+     * @param void
+     * @return size_t
+     */
+    size_t getCapacity() const {
+        return capacity_;
+    }
+};
+
+#endif  // INCLUDE_BOUNDEDQUEUE_H_
@@ -11,12 +11,38 @@
  * 
  */
 
+#ifndef INCLUDE_DATALOADER_H_
+#define INCLUDE_DATALOADER_H_
+
 #include <iostream>
+#include <map>
+#include <memory>
 #include <vector>
 #include <numeric>
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/highgui/highgui.hpp>
+#include "Detection.h"
+#include "DetectionPolicy.h"
+#include "InferenceScheduler.h"
+#include "MotionGate.h"
+#include "ResultWriter.h"
+#include "ShmRing.h"
+#include "Track.h"
+
+/**
+ * @brief Per-stream counters of the multi-stream mode
+ * 
+ */
+struct StreamStats {
+    std::string input;
+    size_t frames = 0;
+    size_t detections = 0;
+    double wallMs = 0;
+    double latencySumMs = 0;
+    double maxLatencyMs = 0;
+    double detectionSumMs = 0;
+};
 
 /**
  * @brief Data loader class
@@ -49,6 +75,143 @@ private:
      */
     std::string outputFile="";
 
+    /**
+     * @brief Private variable to run decode, inference, tracking and encode on separate threads
+     * 
+     */
+    bool pipelined_ = false;
+
+    /**
+     * @brief Private variable for the tracker of this stream. Every loader has its own.
+     * 
+     */
+    Track tracker_;
+
+    /**
+     * @brief Private variable for the counters of the last processStream call
+     * 
+     */
+    StreamStats streamStats_;
+
+    /**
+     * @brief Private variable to always work on the newest frame under a latency budget
+     * 
+     */
+    bool realtime_ = false;
+
+    /**
+     * @brief Private variable for the end-to-end latency budget of the real-time mode in milliseconds
+     * 
+     */
+    double latencyBudgetMs_ = 200;
+
+    /**
+     * @brief Private variable to let the detection policy decide when YOLO runs
+     * 
+     */
+    bool adaptive_ = false;
+
+    /**
+     * @brief Private variable for the adaptive detection policy of this loader
+     * 
+     */
+    DetectionPolicy policy_;
+
+    /**
+     * @brief Private variable to detect only around the tracked people between full-frame passes
+     * 
+     */
+    bool roiDetection_ = false;
+
+    /**
+     * @brief Private variable for the detection passes per full-frame pass in the ROI mode
+     * 
+     */
+    int fullFrameEvery_ = 4;
+
+    /**
+     * @brief Private variables counting the region and full-frame passes of the ROI mode
+     * 
+     */
+    size_t regionPasses_ = 0;
+    size_t fullFramePasses_ = 0;
+
+    /**
+     * @brief Private variable to run full-frame detection on native resolution tiles
+     * 
+     */
+    bool tiled_ = false;
+
+    /**
+     * @brief Private variables for the tile side in pixels, the overlap of neighbouring tiles and
+     *        the tiles per forward pass
+     * 
+     */
+    int tileSize_ = 416;
+    double tileOverlap_ = 0.2;
+    int tileBatch_ = 16;
+
+    /**
+     * @brief Private variable to skip detection and tracker updates on unchanged frames
+     * 
+     */
+    bool motionGated_ = false;
+
+    /**
+     * @brief Private variable for the change detector of the motion gated mode
+     * 
+     */
+    MotionGate gate_;
+
+    /**
+     * @brief Private variables to skip drawing, display and encoding and where the headless
+     *        results go, "-" for stdout
+     * 
+     */
+    bool headless_ = false;
+    std::string headlessOutput_ = "-";
+
+    /**
+     * @brief Runs detection and tracking without drawing, display or encoding and writes the
+     *        tracks of every frame with a ResultWriter
+     * @param void
+     * @return void
+     */
+    void processHeadless();
+
+    /**
+     * @brief Private variables for the ring the tracks are published to, null when off, and
+     *        the confidence of the detection each track last matched
+     * 
+     */
+    std::shared_ptr<ShmRingPublisher> publisher_;
+    std::map<int, float> trackConfidences_;
+
+    /**
+     * @brief Gathers ID, box, detection confidence and camera frame pose of the current tracks
+     * @param detection type : Detection& detector of the current frame
+     * @param detected type : bool whether the detector ran on the current frame
+     * @param results type : std::vector<TrackResult>& one entry per track
+     * @return void
+     */
+    void collectTracks(Detection &detection, bool detected,
+    std::vector<TrackResult> &results);
+
+    /**
+     * @brief Runs detection on the current frame, on regions around the tracks in the ROI mode
+     * @param detection type : Detection& detector holding the current frame
+     * @return const std::vector<cv::Rect>& detections in frame coordinates, owned by detection
+     */
+    const std::vector<cv::Rect> &detectFrame(Detection &detection);
+
+    /**
+     * @brief Decides whether a frame gets a detection pass, every 45th frame unless adaptive
+     * @param frameNumber type : int
+     * @param frame type : const cv::Mat&
+     * @return bool
+     */
+    bool detectionDue(int frameNumber, const cv::Mat &frame);
+
 public:
     /**
      * @brief Construct a new Data Loader object
@@ -76,6 +239,103 @@ public:
      */
     void setPath(std::string path);
 
+    /**
+     * @brief Enables the staged multi-threaded pipeline for processInput
+     * @param pipelined type : bool
+     * @return void
+     */
+    void setPipelined(bool pipelined);
+
+    /**
+     * @brief Enables the latency bounded real-time mode for processInput. Stale frames are
+     *        skipped and the tracker coasts while a detection is running.
+     * @param realtime type : bool
+     * @param latencyBudgetMs type : double end-to-end latency budget in milliseconds
+     * @return void
+     */
+    void setRealtime(bool realtime, double latencyBudgetMs);
+
+    /**
+     * @brief Selects the tracking algorithm of this loader
+     * @param mode type : TrackerMode
+     * @return void
+     */
+    void setTrackerMode(TrackerMode mode);
+
+    /**
+     * @brief Sets the number of threads that update the per-person trackers of this loader
+     * @param numThreads type : int
+     * @return void
+     */
+    void setTrackerThreads(int numThreads);
+
+    /**
+     * @brief Replaces the fixed detection interval by the adaptive detection policy
+     * @param adaptive type : bool
+     * @return void
+     */
+    void setAdaptiveDetection(bool adaptive);
+
+    /**
+     * @brief Gets the detection policy of this loader, to configure it or read its counters
+     * @param void
+     * @return DetectionPolicy&
+     */
+    DetectionPolicy &getDetectionPolicy();
+
+    /**
+     * @brief Runs detection only on crops around the tracked people, with a full-frame pass
+     *        every fullFrameEvery passes and whenever nothing is tracked to find new people.
+     *        Used by the sequential mode of processInput.
+     * @param enabled type : bool
+     * @param fullFrameEvery type : int detection passes per full-frame pass
+     * @return void
+     */
+    void setRoiDetection(bool enabled, int fullFrameEvery = 4);
+
+    /**
+     * @brief Runs full-frame detection on overlapping native resolution tiles, for small people
+     *        in high resolution footage. Used by the sequential mode of processInput.
+     * @param enabled type : bool
+     * @param tileSize type : int tile side in pixels
+     * @param overlap type : double overlap of neighbouring tiles as a fraction of the tile
+     * @param tileBatch type : int tiles per forward pass, 0 for all changed tiles in one pass
+     * @return void
+     */
+    void setTiledDetection(bool enabled, int tileSize = 416,
+    double overlap = 0.2, int tileBatch = 16);
+
+    /**
+     * @brief Skips scheduled detections and tracker updates while the scene does not change, and
+     *        limits detection to the tracks and the changed blocks between full-frame passes.
+     *        Used by the sequential mode of processInput.
+     * @param enabled type : bool
+     * @param threshold type : double mean gray level change that marks a block as changed
+     * @return void
+     */
+    void setMotionGate(bool enabled, double threshold = 12.0);
+
+    /**
+     * @brief Makes processInput skip the window event loop, all drawing and the video encoder,
+     *        and write frame index, timestamp, track ID, box, detection confidence and camera
+     *        frame pose of every frame as JSON lines instead
+     * @param enabled type : bool
+     * @param output type : const std::string& results file, "-" for stdout
+     * @return void
+     */
+    void setHeadless(bool enabled, const std::string &output = "-");
+
+    /**
+     * @brief Publishes the tracks and poses of every frame of the sequential and headless modes
+     *        to a lock-free ring in POSIX shared memory, read with ShmRingReader
+     * @param enabled type : bool
+     * @param name type : const std::string& shared memory name
+     * @param capacity type : uint32_t number of frames the ring holds
+     * @return bool false if the ring could not be created
+     */
+    bool setShmPublisher(bool enabled, const std::string &name = "/human_tracks",
+    uint32_t capacity = 64);
+
     /**
      * @brief Get the Input Stream Method object. Fetches input method 
      * @param void
@@ -97,9 +357,47 @@ public:
    */
     int checkParser(cv::CommandLineParser parser);
 
+    /**
+     * @brief Gets the detector shared by all loaders of the process. The YOLO network is
+     *        loaded once, on first use.
+     * @param void
+     * @return Detection& shared detector
+     */
+    static Detection &sharedDetection();
+
+    /**
+     * @brief Processes the video file or camera index in path_ as one of several concurrent
+     *        streams. Detection frames go through the shared scheduler, tracking uses the
+     *        tracker of this loader.
+     * @param scheduler type : InferenceScheduler& scheduler shared by all streams
+     * @param streamId type : int index of this stream in the scheduler
+     * @return void
+     */
+    void processStream(InferenceScheduler &scheduler, int streamId);
+
+    /**
+     * @brief Gets the counters of the last processStream call
+     * @param void
+     * @return StreamStats
+     */
+    StreamStats getStreamStats();
+
+    /**
+     * @brief Processes several videos or cameras concurrently, one thread and one tracker per
+     *        stream and one shared network, then prints per-stream FPS and latency
+     * @param inputs type : std::vector<std::string> video paths or camera indices
+     * @param mode type : TrackerMode tracking algorithm of every stream
+     * @param adaptive type : bool use the adaptive detection policy on every stream
+     * @return void
+     */
+    static void processStreams(const std::vector<std::string> &inputs,
+    TrackerMode mode = TrackerMode::KCF, bool adaptive = false);
+
     /**
      * @brief Destroy the Data Loader object
      * 
      */
     ~DataLoader() {}
-};
\ No newline at end of file
+};
+
+#endif  // INCLUDE_DATALOADER_H_
@@ -10,17 +10,36 @@
  * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
  * 
  */
+
+#ifndef INCLUDE_DETECTION_H_
+#define INCLUDE_DETECTION_H_
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <vector>
 #include <numeric>
 #include <algorithm>
+#include <chrono>
 #include <opencv2/core/core.hpp>
 #include <opencv2/dnn.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <map>
+#include "Preprocessor.h"
+#include "ModelProfile.h"
+#include "Nms.h"
+
+/**
+ * @brief Detections and a small gray copy of one tile, reused while the tile does not change
+ *
+ */
+struct TileCache {
+    cv::Rect tile;
+    cv::Mat thumbnail;
+    std::vector<cv::Rect> boxes;
+    std::vector<float> confidences;
+    int age = 0;
+};
 
 /**
  * @brief Detection class responsible for running Human detection using YOLOv4 on image or video.
@@ -84,7 +103,144 @@ private:
     std::vector<std::string> classes;
 
     /**
-     * @brief Private variable to store all detections in the current frame
+     * @brief Private variable for the YOLOv4 network, loaded once and reused for every frame
+     * 
+     */
+    cv::dnn::Net net_;
+
+    /**
+     * @brief Private variable for the names of the unconnected output layers of net_
+     * 
+     */
+    std::vector<cv::String> outNames_;
+
+    /**
+     * @brief Private variable for the time taken to load the model in milliseconds
+     * 
+     */
+    double loadTimeMs_ = 0;
+
+    /**
+     * @brief Private variable for the time taken by the warm-up pass in milliseconds
+     * 
+     */
+    double warmUpTimeMs_ = 0;
+
+    /**
+     * @brief Private variables for the launch time of the process, whether the first detection
+     *        after it is still to be reported and the measured launch to first detection time
+     * 
+     */
+    std::chrono::steady_clock::time_point launchTime_;
+    bool reportStartup_ = false;
+    double startupMs_ = 0;
+
+    /**
+     * @brief Private variable for the index of "person" in classes, -1 if the label is missing
+     * 
+     */
+    int personClassId_ = -1;
+
+    /**
+     * @brief Private variable to decode network outputs with the person-only fast path
+     * 
+     */
+    bool personOnly_ = true;
+
+    /**
+     * @brief Private variable for the maximum number of frames per forward pass in processBatch
+     * 
+     */
+    int batchSize_ = 4;
+
+    /**
+     * @brief Private variables for the tile side in pixels and the overlap fraction of neighbouring tiles
+     * 
+     */
+    int tileSize_ = 416;
+    double tileOverlap_ = 0.2;
+
+    /**
+     * @brief Private variable for the mean gray level change below which a tile reuses its detections
+     * 
+     */
+    double tileChangeThreshold_ = 2.0;
+
+    /**
+     * @brief Private variable for the maximum number of tiles per forward pass, 0 for all changed
+     *        tiles in one pass
+     * 
+     */
+    int tileBatchSize_ = 16;
+
+    /**
+     * @brief Private variable for the cached detections of every tile
+     * 
+     */
+    std::vector<TileCache> tileCache_;
+
+    /**
+     * @brief Private variables counting the tiles run through the network and the tiles skipped
+     * 
+     */
+    size_t tilesRun_ = 0;
+    size_t tilesSkipped_ = 0;
+
+    /**
+     * @brief Private variable to draw the kept detections in postProcess
+     * 
+     */
+    bool drawBoxes_ = true;
+
+    /**
+     * @brief Private variable to suppress overlapping boxes in postProcess, off while
+     *        processTiles gathers the boxes of its tiles
+     * 
+     */
+    bool suppress_ = true;
+
+    /**
+     * @brief Private variables for the network input and outputs, reused from frame to frame
+     * 
+     */
+    cv::Mat blob_;
+    std::vector<cv::Mat> outs_;
+
+    /**
+     * @brief Private variables for the resized and scaled frame and the blob planes of preprocess
+     * 
+     */
+    cv::Mat resized_;
+    cv::Mat scaled_;
+    cv::Mat planes_[3];
+
+    /**
+     * @brief Private variables for the fused letterbox kernel, whether preprocess letterboxes and
+     *        the placement of the last letterboxed frame
+     * 
+     */
+    Preprocessor preprocessor_;
+    bool letterbox_ = true;
+    LetterboxInfo letterboxInfo_;
+
+    /**
+     * @brief Private variable for the suppression of overlapping boxes, greedy like NMSBoxes
+     *        unless set otherwise
+     * 
+     */
+    Nms nms_;
+
+    /**
+     * @brief Private variables for the decoded rows of postProcess, reused from frame to frame
+     * 
+     */
+    std::vector<int> classIds_;
+    std::vector<float> confidences_;
+    std::vector<cv::Rect> boxes_;
+    std::vector<int> indices_;
+
+    /**
+     * @brief Private variable to store the detections kept by NMS in the current frame
      * 
      */
     std::vector<cv::Rect> detections;
@@ -112,9 +268,16 @@ private:
     /**
      * @brief Gets correct detections and bounding boxes are reduced
      * @param outs std::vector<cv::Mat>  output of last layer
-     * @return std::vector<cv::Rect> return detected humans in a frame
+     * @return const std::vector<cv::Rect>& return detected humans in a frame, valid until the next call
+     */
+    const std::vector<cv::Rect> &postProcess(const std::vector<cv::Mat> &outs);
+
+    /**
+     * @brief Records and prints the time from launch to the first detection, once
+     * @param void
+     * @return void
      */
-    std::vector<cv::Rect> postProcess(const std::vector<cv::Mat> &outs);
+    void reportStartup();
 
 public:
     /**
@@ -134,20 +297,155 @@ public:
     void initializeParams(float confThreshold, float nmsThreshold, float inpWidth, float inpHeight);
 
     /**
-     * @brief Sets path to model weights file, model config file and model class files
+     * @brief Sets path to model weights file, model config file and model class files, then
+     *        builds the network, its output layer names and the label table once.
      * @param modelWeightsFile type : std::string 
      * @param modelConfigFile type : std::string 
      * @param modelClassFile type : std::string 
      * @return void
      */
     void loadModelandLabelClasses(std::string modelWeightsFile, std::string modelConfigFile, std::string modelClassFile);
+
+    /**
+     * @brief Builds the network, its output layer names and the label table from a model bundle.
+     *        The config and weights are parsed straight from the mapping, and the output names
+     *        are taken from the bundle instead of being looked up in the network.
+     * @param bundleFile type : const std::string& bundle written by model-bundle
+     * @return bool true if the bundle was valid and the network was built
+     */
+    bool loadModelBundle(const std::string &bundleFile);
+
+    /**
+     * @brief Sets the launch time of the process. The time from it to the first detection is
+     *        measured and printed once.
+     * @param launchTime type : std::chrono::steady_clock::time_point
+     * @return void
+     */
+    void setLaunchTime(std::chrono::steady_clock::time_point launchTime);
+
+    /**
+     * @brief Gets the time from launch to the first detection
+     * @param void
+     * @return double - milliseconds, 0 until the first detection after setLaunchTime
+     */
+    double getStartupTime();
+
+    /**
+     * @brief Runs one forward pass on a blank input so that the first real frame
+     *        does not pay for lazy layer allocation
+     * @param void
+     * @return void
+     */
+    void warmUp();
+
+    /**
+     * @brief Checks whether the network was loaded successfully
+     * @param void
+     * @return bool - true if the network is ready for inference
+     */
+    bool isModelLoaded();
+
+    /**
+     * @brief Gets the time taken by the last model load
+     * @param void
+     * @return double - load time in milliseconds
+     */
+    double getLoadTime();
+
+    /**
+     * @brief Gets the time taken by the last warm-up pass
+     * @param void
+     * @return double - warm-up time in milliseconds, 0 if the loaded model is not warmed up yet
+     */
+    double getWarmUpTime();
+
+    /**
+     * @brief Selects between the vectorized person-only decoder and the full-class argmax decoder
+     * @param personOnly type : bool
+     * @return void
+     */
+    void setPersonOnlyDecoding(bool personOnly);
+
+    /**
+     * @brief Loads the model of a profile and sets its network input size. ONNX profiles are
+     *        read with readNetFromONNX, the others with readNetFromDarknet.
+     * @param profile type : ModelProfile
+     * @return void
+     */
+    void setModelProfile(ModelProfile profile);
+
+    /**
+     * @brief Gets the network input size
+     * @param void
+     * @return cv::Size
+     */
+    cv::Size getInputSize();
+
+    /**
+     * @brief Selects whether the kept detections are drawn on the frame, off in headless runs
+     * @param drawBoxes type : bool
+     * @return void
+     */
+    void setDrawBoxes(bool drawBoxes);
+
+    /**
+     * @brief Selects between the letterboxed input of the fused kernel and the stretched input
+     *        of blobFromImage
+     * @param letterbox type : bool
+     * @return void
+     */
+    void setLetterbox(bool letterbox);
+
+    /**
+     * @brief Sets the number of threads the fused kernel uses on large frames
+     * @param numThreads type : int
+     * @return void
+     */
+    void setPreprocessThreads(int numThreads);
+
+    /**
+     * @brief Sets the suppression method and the cap on detections per frame
+     * @param options type : const NmsOptions&
+     * @return void
+     */
+    void setNmsOptions(const NmsOptions &options);
+
+    /**
+     * @brief Decodes one YOLO output, keeping only rows whose best class is the person class.
+     *        Rows are rejected on the person score with SIMD before any per-row work, so the
+     *        accepted rows give the same result as decodeAllClassRows filtered to persons.
+     * @param out type : const cv::Mat& YOLO output, one row per candidate
+     * @param personClassId type : int index of the person class
+     * @param confThreshold type : float minimum person score
+     * @param frameSize type : cv::Size size of the frame the boxes are scaled to
+     * @param boxes type : std::vector<cv::Rect>& accepted boxes are appended here
+     * @param confidences type : std::vector<float>& person scores of the accepted boxes
+     * @return void
+     */
+    static void decodePersonRows(const cv::Mat &out, int personClassId,
+    float confThreshold, cv::Size frameSize, std::vector<cv::Rect> &boxes,
+    std::vector<float> &confidences);
+
+    /**
+     * @brief Decodes one YOLO output with a full argmax over all class scores of every row
+     * @param out type : const cv::Mat& YOLO output, one row per candidate
+     * @param confThreshold type : float minimum best class score
+     * @param frameSize type : cv::Size size of the frame the boxes are scaled to
+     * @param classIds type : std::vector<int>& best class of the accepted boxes
+     * @param boxes type : std::vector<cv::Rect>& accepted boxes are appended here
+     * @param confidences type : std::vector<float>& best class scores of the accepted boxes
+     * @return void
+     */
+    static void decodeAllClassRows(const cv::Mat &out, float confThreshold,
+    cv::Size frameSize, std::vector<int> &classIds,
+    std::vector<cv::Rect> &boxes, std::vector<float> &confidences);
 /**
      * @brief Sets current frame
-     * @param frame type: cv::Mat
+     * @param frame type: const cv::Mat& shares the buffer, detections are drawn on it
      * @return void
      */
 
-    void setFrame(cv::Mat frame);
+    void setFrame(const cv::Mat &frame);
     /**
      * @brief Fetches all bounding boxes of detected humans in a single frame
      * @param void
@@ -159,9 +457,133 @@ public:
      * @brief RUns YOLOv4 algo and detects humans. 
      * 
      * @param void
-     * @return std::vector<cv::Rect> return detections in the frame
+     * @return const std::vector<cv::Rect>& return detections in the frame, valid until the next call
+     */
+    const std::vector<cv::Rect> &processFrameforHuman();
+
+    /**
+     * @brief Runs the post-processing of processFrameforHuman on recorded network outputs of
+     *        a stretched input, so decoding and NMS can be replayed and measured without a model
+     * @param outs type : const std::vector<cv::Mat>& outputs of the network's output layers
+     * @return const std::vector<cv::Rect>& detections in the current frame, valid until the next call
+     */
+    const std::vector<cv::Rect> &processOutputs(const std::vector<cv::Mat> &outs);
+
+    /**
+     * @brief Turns a frame into the network input. With letterboxing on the frame is scaled
+     *        keeping its aspect ratio and padded in one fused pass, otherwise it is stretched
+     *        like blobFromImage. The blob is reused, so frames of the same size do not allocate.
+     * @param frame type : const cv::Mat& BGR frame
+     * @return const cv::Mat& NCHW float blob
+     */
+    const cv::Mat &preprocess(const cv::Mat &frame);
+
+    /**
+     * @brief Runs YOLOv4 on several frames, which may come from different streams and have
+     *        different resolutions. Frames are packed into one NCHW blob per chunk of
+     *        batchSize frames and run with a single forward pass. Each frame is letterboxed
+     *        into its own plane like in preprocess, or stretched when letterboxing is off.
+     * @param frames type : const std::vector<cv::Mat>& input frames, detections are drawn on them
+     * @param detections type : std::vector<std::vector<cv::Rect>>& per frame detections in the
+     *        frame's own pixel coordinates
+     * @param confidences type : std::vector<std::vector<float>>& per frame confidence scores
+     * @param inputSize type : cv::Size network input size, multiples of 32. Empty for the default.
+     * @param batchSize type : int frames per forward pass, 0 for getBatchSize()
+     * @return void
+     */
+    void processBatch(const std::vector<cv::Mat> &frames,
+    std::vector<std::vector<cv::Rect>> &detections,
+    std::vector<std::vector<float>> &confidences,
+    cv::Size inputSize = cv::Size(), int batchSize = 0);
+
+    /**
+     * @brief Expands the tracked boxes by a margin, makes them square and merges overlapping ones
+     *        into regions of interest for processRegions
+     * @param boxes type : const std::vector<cv::Rect2d>& tracked boxes in frame coordinates
+     * @param frameSize type : cv::Size
+     * @param margin type : double padding on every side as a fraction of the larger box side
+     * @return std::vector<cv::Rect> non-overlapping square regions inside the frame
+     */
+    static std::vector<cv::Rect> regionsOfInterest(
+    const std::vector<cv::Rect2d> &boxes, cv::Size frameSize,
+    double margin = 1.0);
+
+    /**
+     * @brief Runs YOLOv4 only on crops of the current frame. The crops go through the network as
+     *        one batch at the smallest input size, multiple of 32, that holds the largest crop.
+     *        Falls back to processFrameforHuman when the crops would cost as much as the full frame.
+     * @param regions type : const std::vector<cv::Rect>& regions inside the frame
+     * @return const std::vector<cv::Rect>& detections in full-frame coordinates
+     */
+    const std::vector<cv::Rect> &processRegions(const std::vector<cv::Rect> &regions);
+
+    /**
+     * @brief Sets the tiles of processTiles
+     * @param tileSize type : int tile side in pixels, rounded up to a multiple of 32
+     * @param overlap type : double overlap of neighbouring tiles as a fraction of the tile, in [0, 0.9]
+     * @param changeThreshold type : double mean gray level change below which a tile is skipped
+     * @return void
+     */
+    void setTiling(int tileSize, double overlap, double changeThreshold = 2.0);
+
+    /**
+     * @brief Sets the maximum number of tiles processTiles runs in one forward pass. The memory
+     *        of a pass grows with its batch, and a 4K frame has about 84 tiles of 416 pixels,
+     *        so the changed tiles run in chunks of 16 by default.
+     * @param batchSize type : int 0 runs all changed tiles in one forward pass
+     * @return void
+     */
+    void setTileBatchSize(int batchSize);
+
+    /**
+     * @brief Splits a frame into overlapping tiles that cover it. The last tile of a row or
+     *        column is aligned with the frame border, so every tile has the full size.
+     * @param frameSize type : cv::Size
+     * @param tileSize type : int
+     * @param overlap type : double
+     * @return std::vector<cv::Rect> tiles row by row
+     */
+    static std::vector<cv::Rect> tileGrid(cv::Size frameSize, int tileSize,
+    double overlap);
+
+    /**
+     * @brief Runs YOLOv4 on overlapping tiles of the current frame at native resolution, so small
+     *        distant people keep their pixels. Changed tiles go through the network in batches of
+     *        setTileBatchSize tiles, unchanged tiles reuse their last detections, and one NMS over
+     *        all tiles merges the people cut by tile seams.
+     * @param void
+     * @return const std::vector<cv::Rect>& detections kept by the NMS, in frame coordinates
+     */
+    const std::vector<cv::Rect> &processTiles();
+
+    /**
+     * @brief Gets the number of tiles run through the network so far
+     * @param void
+     * @return size_t
      */
-    std::vector<cv::Rect> processFrameforHuman();
+    size_t getTilesRun();
+
+    /**
+     * @brief Gets the number of unchanged tiles skipped so far
+     * @param void
+     * @return size_t
+     */
+    size_t getTilesSkipped();
+
+    /**
+     * @brief Sets the maximum number of frames per forward pass. Larger batches raise
+     *        throughput, smaller batches lower the latency of each frame.
+     * @param batchSize type : int at least 1
+     * @return void
+     */
+    void setBatchSize(int batchSize);
+
+    /**
+     * @brief Gets the maximum number of frames per forward pass
+     * @param void
+     * @return int
+     */
+    int getBatchSize();
 
     /**
      * @brief Gives confidence metric for each bounding box for detected humans in a frame
@@ -176,4 +598,6 @@ public:
      */
 
     ~Detection() {}
-};
\ No newline at end of file
+};
+
+#endif  // INCLUDE_DETECTION_H_
@@ -0,0 +1,221 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file DetectionPolicy.h
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Source header file for the DetectionPolicy class that decides when YOLO runs.
+ * @version 0.1
+ * @date 2020-12-03
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+
+#ifndef INCLUDE_DETECTIONPOLICY_H_
+#define INCLUDE_DETECTIONPOLICY_H_
+
+#include <chrono>
+#include <string>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+/**
+ * @brief Reason a detection pass was triggered
+ *
+ */
+enum class DetectionReason {
+    NONE,
+    FIRST_FRAME,
+    MAX_INTERVAL,
+    TRACKER_FAILURE,
+    EMPTY_SCENE_MOTION,
+    CADENCE
+};
+
+/**
+ * @brief Counters of the detection policy
+ *
+ */
+struct PolicyStats {
+    size_t frames = 0;
+    size_t triggered = 0;
+    size_t fixedCadence = 0;
+    size_t firstFrame = 0;
+    size_t maxInterval = 0;
+    size_t trackerFailure = 0;
+    size_t emptySceneMotion = 0;
+    size_t cadence = 0;
+    size_t cpuLimited = 0;
+};
+
+/**
+ * @brief Decides on every frame whether the detector runs, from tracker failures, the number
+ *        of active tracks, scene motion and a CPU budget, bounded by a min and max interval.
+ *        Not thread safe, every caller owns its policy.
+ *
+ */
+class DetectionPolicy
+{
+
+private:
+    /**
+     * @brief Private variable for the minimum number of frames between two detections
+     *
+     */
+    int minInterval_ = 5;
+
+    /**
+     * @brief Private variable for the maximum number of frames between two detections
+     *
+     */
+    int maxInterval_ = 90;
+
+    /**
+     * @brief Private variable for the fixed cadence the policy is compared against
+     *
+     */
+    int fixedInterval_ = 45;
+
+    /**
+     * @brief Private variable for the fraction of wall time detection may use
+     *
+     */
+    double cpuBudget_ = 0.5;
+
+    /**
+     * @brief Private variable for the mean gray level change that counts as strong motion
+     *
+     */
+    double motionThreshold_ = 6.0;
+
+    /**
+     * @brief Private variable for the frames since the last detection, -1 before the first
+     *
+     */
+    int framesSinceDetection_ = -1;
+
+    /**
+     * @brief Private variables for the smoothed detection time and frame period in milliseconds
+     *
+     */
+    double detectionMs_ = 0;
+    double framePeriodMs_ = 0;
+
+    /**
+     * @brief Private variable for the motion of the last frame
+     *
+     */
+    double motion_ = 0;
+
+    /**
+     * @brief Private variable for the time of the previous frame
+     *
+     */
+    std::chrono::steady_clock::time_point lastFrame_;
+
+    /**
+     * @brief Private variable for the small gray copy of the previous frame
+     *
+     */
+    cv::Mat previousGray_;
+
+    /**
+     * @brief Private variable for a scratch gray image
+     *
+     */
+    cv::Mat gray_;
+
+    /**
+     * @brief Private variable for the reason of the last decision
+     *
+     */
+    DetectionReason lastReason_ = DetectionReason::NONE;
+
+    /**
+     * @brief Private variable for the policy counters
+     *
+     */
+    PolicyStats stats_;
+
+public:
+    /**
+     * @brief Construct a new Detection Policy object with the default bounds
+     *
+     */
+    DetectionPolicy() {}
+
+    /**
+     * @brief Sets the interval bounds and the fixed cadence used for comparison
+     * @param minInterval type : int minimum frames between detections
+     * @param maxInterval type : int maximum frames between detections
+     * @param fixedInterval type : int cadence of the fixed rule
+     * @return void
+     */
+    void setIntervals(int minInterval, int maxInterval, int fixedInterval);
+
+    /**
+     * @brief Sets the fraction of wall time detection may use
+     * @param cpuBudget type : double in (0, 1]
+     * @return void
+     */
+    void setCpuBudget(double cpuBudget);
+
+    /**
+     * @brief Sets the mean gray level change that counts as strong motion
+     * @param motionThreshold type : double
+     * @return void
+     */
+    void setMotionThreshold(double motionThreshold);
+
+    /**
+     * @brief Measures the motion of a frame against the previous one on a small gray copy
+     * @param frame type : const cv::Mat& BGR frame
+     * @return double - mean absolute gray level change
+     */
+    double measureMotion(const cv::Mat &frame);
+
+    /**
+     * @brief Decides whether the detector runs on this frame. Call once per frame.
+     * @param frame type : const cv::Mat& current frame, used for the motion signal
+     * @param activeTracks type : int number of tracks the tracker holds
+     * @param lostTracks type : int number of tracks the tracker lost on the last update
+     * @return bool - true if detection should run
+     */
+    bool shouldDetect(const cv::Mat &frame, int activeTracks, int lostTracks);
+
+    /**
+     * @brief Records how long a detection pass took, feeds the CPU budget
+     * @param detectionMs type : double
+     * @return void
+     */
+    void recordDetection(double detectionMs);
+
+    /**
+     * @brief Gets the reason of the last decision
+     * @param void
+     * @return DetectionReason
+     */
+    DetectionReason getLastReason();
+
+    /**
+     * @brief Gets the policy counters
+     * @param void
+     * @return PolicyStats
+     */
+    PolicyStats getStats();
+
+    /**
+     * @brief Prints how many detections the policy triggered and saved compared with the fixed cadence
+     * @param void
+     * @return void
+     */
+    void printStats();
+
+    /**
+     * @brief Destroy the Detection Policy object
+     *
+     */
+    ~DetectionPolicy() {}
+};
+
+#endif  // INCLUDE_DETECTIONPOLICY_H_
@@ -0,0 +1,309 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file Evaluation.h
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Source header file for the accuracy and throughput evaluation on annotated sequences
+ * @version 0.1
+ * @date 2020-12-12
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+
+#ifndef INCLUDE_EVALUATION_H_
+#define INCLUDE_EVALUATION_H_
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "Detection.h"
+#include "Track.h"
+
+/**
+ * @brief One box of one identity on one frame
+ *
+ */
+struct MotBox {
+    int id = 0;
+    cv::Rect2d box;
+};
+
+/**
+ * @brief Boxes of every frame of a sequence, by frame number from 1
+ *
+ */
+typedef std::map<int, std::vector<MotBox>> MotSequence;
+
+/**
+ * @brief Detector and tracker settings of one evaluation run
+ *
+ */
+struct EvalParams {
+    float confThreshold = 0.5f;
+    float nmsThreshold = 0.4f;
+    int detectionInterval = 45;
+    double shrinkWidth = 0.8;
+    double shrinkHeight = 0.8;
+};
+
+/**
+ * @brief CLEAR MOT and identity metrics of a sequence
+ *
+ */
+struct MotMetrics {
+    int frames = 0;
+    int groundTruth = 0;
+    int hypotheses = 0;
+    int truePositives = 0;
+    int falsePositives = 0;
+    int misses = 0;
+    int idSwitches = 0;
+    int idTruePositives = 0;
+    double precision = 0;
+    double recall = 0;
+    double mota = 0;
+    double idf1 = 0;
+};
+
+/**
+ * @brief Accuracy and cost of one evaluation run
+ *
+ */
+struct EvalResult {
+    EvalParams params;
+    MotMetrics metrics;
+    double fps = 0;
+    double cpuSecondsPerFrame = 0;
+    bool pareto = false;
+};
+
+/**
+ * @brief Accumulates MOTChallenge metrics frame by frame. A hypothesis matches a ground truth
+ *        box at an IoU of at least minIou. Matches of the previous frame are kept while they
+ *        hold, the rest are assigned by the Hungarian algorithm, and a ground truth identity
+ *        matched to another hypothesis than before counts as an ID switch (CLEAR MOT). IDF1
+ *        matches whole identities, by the frames each ground truth and hypothesis pair overlap.
+ *
+ */
+class MotAccumulator
+{
+
+private:
+    /**
+     * @brief Private variable for the minimum IoU of a match
+     *
+     */
+    double minIou_;
+
+    /**
+     * @brief Private variable for the hypothesis each ground truth identity was last matched to
+     *
+     */
+    std::map<int, int> lastMatch_;
+
+    /**
+     * @brief Private variable for the frames every ground truth and hypothesis pair overlaps
+     *
+     */
+    std::map<std::pair<int, int>, int> overlaps_;
+
+    /**
+     * @brief Private variables for the boxes of every ground truth and hypothesis identity
+     *
+     */
+    std::map<int, int> truthBoxes_;
+    std::map<int, int> hypothesisBoxes_;
+
+    /**
+     * @brief Private variable for the counters so far
+     *
+     */
+    MotMetrics metrics_;
+
+public:
+    /**
+     * @brief Construct a new Mot Accumulator object
+     * @param minIou type : double
+     */
+    explicit MotAccumulator(double minIou = 0.5) : minIou_(minIou) {}
+
+    /**
+     * @brief Adds one frame
+     * @param truth type : const std::vector<MotBox>& ground truth boxes
+     * @param hypotheses type : const std::vector<MotBox>& tracked boxes
+     * @return void
+     */
+    void update(const std::vector<MotBox> &truth,
+    const std::vector<MotBox> &hypotheses);
+
+    /**
+     * @brief Computes the metrics of all frames added so far
+     * @param void
+     * @return MotMetrics
+     */
+    MotMetrics finish() const;
+};
+
+/**
+ * @brief Runs the detector and tracker over an annotated sequence in the MOTChallenge layout,
+ *        a directory with the frames in img1/ and the ground truth in gt/gt.txt, and reports
+ *        accuracy next to throughput. Parameter grids are evaluated in parallel, every worker
+ *        with its own detector on one core.
+ *
+ */
+class Evaluator
+{
+
+private:
+    /**
+     * @brief Private variables for the frames and the ground truth of the sequence
+     *
+     */
+    std::vector<cv::String> frames_;
+    MotSequence truth_;
+
+    /**
+     * @brief Private variable for the number of worker threads of a sweep, 0 for one per core
+     *
+     */
+    int numWorkers_ = 0;
+
+    /**
+     * @brief Private variable to track with SORT instead of KCF
+     *
+     */
+    bool sort_ = false;
+
+    /**
+     * @brief Private variable for the minimum IoU of a match
+     *
+     */
+    double minIou_ = 0.5;
+
+    /**
+     * @brief Runs one setting over the sequence
+     * @param params type : const EvalParams&
+     * @param detection type : Detection& detector of the calling worker, set to the params here
+     * @param threadCpu type : bool measure CPU time of the calling thread instead of the process
+     * @return EvalResult
+     */
+    EvalResult evaluate(const EvalParams &params, Detection &detection,
+    bool threadCpu) const;
+
+public:
+    /**
+     * @brief Construct a new Evaluator object
+     *
+     */
+    Evaluator() {}
+
+    /**
+     * @brief Loads a MOTChallenge sequence directory
+     * @param directory type : const std::string&
+     * @return bool false if it has no frames or no ground truth
+     */
+    bool setSequence(const std::string &directory);
+
+    /**
+     * @brief Sets the number of worker threads of a sweep
+     * @param numWorkers type : int 0 for one per core
+     * @return void
+     */
+    void setNumWorkers(int numWorkers);
+
+    /**
+     * @brief Selects SORT instead of KCF tracking
+     * @param sort type : bool
+     * @return void
+     */
+    void setSortTracker(bool sort);
+
+    /**
+     * @brief Sets the minimum IoU of a match
+     * @param minIou type : double
+     * @return void
+     */
+    void setMinIou(double minIou);
+
+    /**
+     * @brief Evaluates every setting of a grid, in parallel
+     * @param grid type : const std::vector<EvalParams>&
+     * @return std::vector<EvalResult> in the order of the grid, Pareto optimal ones marked
+     */
+    std::vector<EvalResult> sweep(const std::vector<EvalParams> &grid) const;
+
+    /**
+     * @brief Sets a detector and a fresh tracker to a setting. The detector keeps its network,
+     *        so a worker loads it once for all the settings it runs.
+     * @param params type : const EvalParams&
+     * @param detection type : Detection&
+     * @param tracker type : Track&
+     * @return void
+     */
+    void configure(const EvalParams &params, Detection &detection,
+    Track &tracker) const;
+
+    /**
+     * @brief Gets the current tracks as the hypotheses of a frame
+     * @param tracker type : Track&
+     * @param hypotheses type : std::vector<MotBox>& replaced
+     * @return void
+     */
+    static void collectHypotheses(Track &tracker,
+    std::vector<MotBox> &hypotheses);
+
+    /**
+     * @brief Reads MOTChallenge ground truth, frame,id,x,y,w,h,conf,class,visibility. Rows
+     *        marked to ignore (conf 0) and classes other than pedestrian are skipped.
+     * @param file type : const std::string&
+     * @param sequence type : MotSequence& boxes by frame, in 0 based pixels
+     * @return bool false if the file could not be read
+     */
+    static bool loadGroundTruth(const std::string &file, MotSequence &sequence);
+
+    /**
+     * @brief Builds the cartesian product of parameter lists
+     * @param confThresholds type : const std::vector<float>&
+     * @param nmsThresholds type : const std::vector<float>&
+     * @param intervals type : const std::vector<int>& frames between detections
+     * @param shrinks type : const std::vector<double>& tracked fraction of width and height
+     * @return std::vector<EvalParams>
+     */
+    static std::vector<EvalParams> grid(const std::vector<float> &confThresholds,
+    const std::vector<float> &nmsThresholds, const std::vector<int> &intervals,
+    const std::vector<double> &shrinks);
+
+    /**
+     * @brief Marks the results no other result beats on both MOTA and CPU time per frame
+     * @param results type : std::vector<EvalResult>&
+     * @return void
+     */
+    static void markPareto(std::vector<EvalResult> &results);
+
+    /**
+     * @brief Prints the results sorted by CPU time per frame, Pareto optimal ones starred
+     * @param results type : const std::vector<EvalResult>&
+     * @return void
+     */
+    static void printTable(const std::vector<EvalResult> &results);
+
+    /**
+     * @brief Writes the results as CSV
+     * @param file type : const std::string&
+     * @param results type : const std::vector<EvalResult>&
+     * @return bool false if the file could not be written
+     */
+    static bool writeCsv(const std::string &file,
+    const std::vector<EvalResult> &results);
+
+    /**
+     * @brief Destroy the Evaluator object
+     *
+     */
+    ~Evaluator() {}
+};
+
+#endif  // INCLUDE_EVALUATION_H_
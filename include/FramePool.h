@@ -0,0 +1,234 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file FramePool.h
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Source header file for the FramePool class that recycles frame buffers.
+ * @version 0.1
+ * @date 2020-12-05
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+
+#ifndef INCLUDE_FRAMEPOOL_H_
+#define INCLUDE_FRAMEPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+class FramePool;
+
+/**
+ * @brief Reference counted handle to a frame buffer of a FramePool. Copies share the buffer,
+ *        and the buffer goes back to the pool when the last copy is destroyed. Copying a
+ *        handle does not allocate.
+ *
+ */
+class FrameHandle
+{
+
+private:
+    /**
+     * @brief Private variable for the pool that owns the buffer, nullptr for an empty handle
+     *
+     */
+    FramePool *pool_ = nullptr;
+
+    /**
+     * @brief Private variable for the slot of the buffer in the pool
+     *
+     */
+    size_t slot_ = 0;
+
+    /**
+     * @brief Drops this handle's reference
+     * @param void
+     * @return void
+     */
+    void reset();
+
+public:
+    /**
+     * @brief Construct an empty Frame Handle object
+     *
+     */
+    FrameHandle() {}
+
+    /**
+     * @brief Construct a Frame Handle object for a slot that already holds one reference
+     * @param pool type : FramePool*
+     * @param slot type : size_t
+     */
+    FrameHandle(FramePool *pool, size_t slot);
+
+    FrameHandle(const FrameHandle &other);
+    FrameHandle(FrameHandle &&other) noexcept;
+    FrameHandle &operator=(const FrameHandle &other);
+    FrameHandle &operator=(FrameHandle &&other) noexcept;
+
+    /**
+     * @brief Gets the frame buffer. Reading a frame of the same size into it reuses its memory.
+     * @param void
+     * @return cv::Mat&
+     */
+    cv::Mat &mat() const;
+
+    /**
+     * @brief Checks whether the handle refers to a buffer
+     * @param void
+     * @return bool
+     */
+    explicit operator bool() const { return pool_ != nullptr; }
+
+    /**
+     * @brief Gets the number of handles sharing the buffer
+     * @param void
+     * @return int
+     */
+    int useCount() const;
+
+    /**
+     * @brief Destroy the Frame Handle object, returns the buffer when it was the last handle
+     *
+     */
+    ~FrameHandle() { reset(); }
+};
+
+/**
+ * @brief Fixed set of frame buffers handed out as FrameHandles. The stages of a frame loop pass
+ *        handles along instead of copying or reallocating frames, so once every buffer has held
+ *        a frame the loop needs no new frame memory.
+ *
+ */
+class FramePool
+{
+
+private:
+    /**
+     * @brief Private variable for the frame buffers
+     *
+     */
+    std::vector<cv::Mat> frames_;
+
+    /**
+     * @brief Private variable for the number of handles of every buffer
+     *
+     */
+    std::unique_ptr<std::atomic<int>[]> refs_;
+
+    /**
+     * @brief Private variable for the free slots, its capacity is reserved up front
+     *
+     */
+    std::vector<size_t> free_;
+
+    std::mutex mutex_;
+    std::condition_variable hasFree_;
+
+    /**
+     * @brief Returns a slot whose last handle was destroyed
+     * @param slot type : size_t
+     * @return void
+     */
+    void release(size_t slot);
+
+    friend class FrameHandle;
+
+public:
+    /**
+     * @brief Construct a new Frame Pool object
+     * @param capacity type : size_t number of buffers, at least the frames in flight at once
+     */
+    explicit FramePool(size_t capacity);
+
+    /**
+     * @brief Takes a free buffer, waits until a handle is destroyed if none is free
+     * @param void
+     * @return FrameHandle
+     */
+    FrameHandle acquire();
+
+    /**
+     * @brief Gets the number of free buffers
+     * @param void
+     * @return size_t
+     */
+    size_t available();
+
+    /**
+     * @brief Gets the number of buffers
+     * @param void
+     * @return size_t
+     */
+    size_t capacity();
+
+    /**
+     * @brief Destroy the Frame Pool object. All handles must be destroyed first.
+     *
+     */
+    ~FramePool() {}
+};
+
+/**
+ * @brief Counts the cv::Mat buffers allocated while it is installed as OpenCV's default
+ *        allocator. Allocation is forwarded to OpenCV's standard allocator.
+ *
+ */
+class MatAllocationCounter : public cv::MatAllocator
+{
+
+private:
+    /**
+     * @brief Private variable for the number of buffers allocated since install
+     *
+     */
+    mutable std::atomic<size_t> count_{0};
+
+    /**
+     * @brief Private variable for the allocator that was the default before install
+     *
+     */
+    cv::MatAllocator *previous_ = nullptr;
+
+public:
+    cv::UMatData *allocate(int dims, const int *sizes, int type, void *data,
+    size_t *step, cv::AccessFlag flags,
+    cv::UMatUsageFlags usageFlags) const override;
+    bool allocate(cv::UMatData *data, cv::AccessFlag accessFlags,
+    cv::UMatUsageFlags usageFlags) const override;
+    void deallocate(cv::UMatData *data) const override;
+
+    /**
+     * @brief Makes this counter the default allocator of new cv::Mat buffers and resets the count
+     * @param void
+     * @return void
+     */
+    void install();
+
+    /**
+     * @brief Restores the previous default allocator
+     * @param void
+     * @return void
+     */
+    void uninstall();
+
+    /**
+     * @brief Gets the number of buffers allocated since install
+     * @param void
+     * @return size_t
+     */
+    size_t getCount() const;
+
+    /**
+     * @brief Destroy the Mat Allocation Counter object, uninstalls it if needed
+     *
+     */
+    ~MatAllocationCounter() { uninstall(); }
+};
+
+#endif  // INCLUDE_FRAMEPOOL_H_
@@ -0,0 +1,157 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file ImageBatchProcessor.h
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Source header file for the ImageBatchProcessor class that detects people on many stills.
+ * @version 0.1
+ * @date 2020-12-08
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+
+#ifndef INCLUDE_IMAGEBATCHPROCESSOR_H_
+#define INCLUDE_IMAGEBATCHPROCESSOR_H_
+
+#include <set>
+#include <string>
+#include <vector>
+#include "Detection.h"
+
+/**
+ * @brief Counters of the last batch image run
+ *
+ */
+struct ImageBatchStats {
+    size_t images = 0;
+    size_t resumed = 0;
+    size_t unreadable = 0;
+    size_t detections = 0;
+    double wallMs = 0;
+};
+
+/**
+ * @brief Detects people on every image of a directory or glob without the tracker. Images
+ *        are decoded on a thread pool while the previous batch is in the network, run in
+ *        batches of Detection::getBatchSize() and written back on the pool. The lines of an
+ *        image are written at once and closed by a line with done as the confidence, or
+ *        unreadable for an image that could not be decoded. A resumed run first drops the
+ *        lines of images without that line and a last line cut short, then redoes those
+ *        images. Names with a comma are quoted.
+ *
+ */
+class ImageBatchProcessor
+{
+
+private:
+    /**
+     * @brief Private variable for the number of decode and encode threads, 0 for one per core
+     *
+     */
+    int numThreads_ = 0;
+
+    /**
+     * @brief Private variable for the directory of the annotated images, empty to write none
+     *
+     */
+    std::string outputDirectory_;
+
+    /**
+     * @brief Private variable for the results file, a CSV of image, x, y, width, height, confidence
+     *
+     */
+    std::string resultsFile_ = "results.csv";
+
+    /**
+     * @brief Private variable to skip the images already in the results file
+     *
+     */
+    bool resume_ = true;
+
+    /**
+     * @brief Private variable for the counters of the last run
+     *
+     */
+    ImageBatchStats stats_;
+
+public:
+    /**
+     * @brief Construct a new Image Batch Processor object
+     *
+     */
+    ImageBatchProcessor() {}
+
+    /**
+     * @brief Sets the number of decode and encode threads
+     * @param numThreads type : int 0 for one per core
+     * @return void
+     */
+    void setNumThreads(int numThreads);
+
+    /**
+     * @brief Sets the directory of the annotated images
+     * @param outputDirectory type : const std::string& created if missing, empty to write none
+     * @return void
+     */
+    void setOutputDirectory(const std::string &outputDirectory);
+
+    /**
+     * @brief Sets the results file
+     * @param resultsFile type : const std::string&
+     * @return void
+     */
+    void setResultsFile(const std::string &resultsFile);
+
+    /**
+     * @brief Selects between resuming from the results file and starting over
+     * @param resume type : bool
+     * @return void
+     */
+    void setResume(bool resume);
+
+    /**
+     * @brief Lists the images of a directory or a glob pattern, sorted
+     * @param pattern type : const std::string& directory, or a pattern with * and ? wildcards
+     * @return std::vector<std::string>
+     */
+    static std::vector<std::string> listImages(const std::string &pattern);
+
+    /**
+     * @brief Reads the images a results file already covers, those with a done or unreadable
+     *        line. A line cut short by a crash does not count.
+     * @param resultsFile type : const std::string&
+     * @return std::set<std::string>
+     */
+    static std::set<std::string> finishedImages(const std::string &resultsFile);
+
+    /**
+     * @brief Detects people on every image of a directory or glob
+     * @param detection type : Detection& detector, its batch size sets the batch
+     * @param pattern type : const std::string& directory or glob pattern
+     * @return bool false if the results file cannot be written
+     */
+    bool process(Detection &detection, const std::string &pattern);
+
+    /**
+     * @brief Gets the counters of the last run
+     * @param void
+     * @return ImageBatchStats
+     */
+    ImageBatchStats getStats();
+
+    /**
+     * @brief Prints the counters of the last run
+     * @param void
+     * @return void
+     */
+    void printStats();
+
+    /**
+     * @brief Destroy the Image Batch Processor object
+     *
+     */
+    ~ImageBatchProcessor() {}
+};
+
+#endif  // INCLUDE_IMAGEBATCHPROCESSOR_H_
@@ -0,0 +1,149 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file InferenceScheduler.h
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Source header file for the InferenceScheduler class that shares one network between streams.
+ * @version 0.1
+ * @date 2020-11-27
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+
+#ifndef INCLUDE_INFERENCESCHEDULER_H_
+#define INCLUDE_INFERENCESCHEDULER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "Detection.h"
+
+/**
+ * @brief Detections of one submitted frame
+ *
+ */
+struct InferenceResult {
+    std::vector<cv::Rect> detections;
+    std::vector<float> confidences;
+};
+
+/**
+ * @brief Frame waiting for inference together with the promise of its result
+ *
+ */
+struct InferenceRequest {
+    cv::Mat frame;
+    std::promise<InferenceResult> promise;
+};
+
+/**
+ * @brief Serves detection requests of several streams with one shared Detection. A worker
+ *        thread takes requests round-robin, one per stream per round, so a fast stream cannot
+ *        starve a slow one, and runs them as one batch through Detection::processBatch.
+ *
+ */
+class InferenceScheduler
+{
+
+private:
+    /**
+     * @brief Private variable for the shared detector. Only the worker thread uses it.
+     *
+     */
+    Detection &detection_;
+
+    /**
+     * @brief Private variable for the pending requests of every stream
+     *
+     */
+    std::vector<std::deque<InferenceRequest>> queues_;
+
+    /**
+     * @brief Private variable for the maximum number of pending requests per stream
+     *
+     */
+    size_t maxPendingPerStream_;
+
+    /**
+     * @brief Private variable for the stream served first in the next round
+     *
+     */
+    size_t nextStream_ = 0;
+
+    /**
+     * @brief Private variable set when the scheduler is shutting down
+     *
+     */
+    bool stopping_ = false;
+
+    /**
+     * @brief Private variables counting the batches and frames run so far
+     *
+     */
+    size_t batchCount_ = 0;
+    size_t frameCount_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable hasWork_;
+    std::condition_variable hasRoom_;
+    std::thread worker_;
+
+    /**
+     * @brief Collects fair batches and runs them until the scheduler stops
+     * @param void
+     * @return void
+     */
+    void workerLoop();
+
+public:
+    /**
+     * @brief Construct a new Inference Scheduler object and start its worker thread
+     * @param detection type : Detection& detector with a loaded model, shared by all streams
+     * @param numStreams type : int number of streams that will submit frames
+     * @param maxPendingPerStream type : size_t requests a stream may queue before submit blocks
+     */
+    InferenceScheduler(Detection &detection, int numStreams,
+    size_t maxPendingPerStream = 2);
+
+    /**
+     * @brief Queues a frame of a stream for detection
+     * @param streamId type : int stream index in [0, numStreams)
+     * @param frame type : const cv::Mat& frame, detections are drawn on it
+     * @return std::future<InferenceResult> - becomes ready once the frame was processed
+     */
+    std::future<InferenceResult> submit(int streamId, const cv::Mat &frame);
+
+    /**
+     * @brief Finishes the pending requests and joins the worker thread
+     * @param void
+     * @return void
+     */
+    void stop();
+
+    /**
+     * @brief Gets the number of forward batches run so far
+     * @param void
+     * @return size_t
+     */
+    size_t getBatchCount();
+
+    /**
+     * @brief Gets the number of frames run so far
+     * @param void
+     * @return size_t
+     */
+    size_t getFrameCount();
+
+    /**
+     * @brief Destroy the Inference Scheduler object
+     *
+     */
+    ~InferenceScheduler() { stop(); }
+};
+
+#endif  // INCLUDE_INFERENCESCHEDULER_H_
@@ -0,0 +1,109 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file LatestSlot.h
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Header only single value mailbox that always holds the newest item.
+ * @version 0.1
+ * @date 2020-11-22
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+
+#ifndef INCLUDE_LATESTSLOT_H_
+#define INCLUDE_LATESTSLOT_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+
+/**
+ * @brief Thread safe slot holding at most one item. A put replaces an item that was not
+ *        taken yet, so consumers always see the newest value.
+ *
+ * @tparam T type of the stored item
+ */
+template <typename T>
+class LatestSlot
+{
+
+private:
+    /**
+     * @brief Private variable for the stored item
+     *
+     */
+    T item_;
+
+    /**
+     * @brief Private variable set while item_ holds a value that was not taken yet
+     *
+     */
+    bool full_ = false;
+
+    /**
+     * @brief Private variable set once the producer side is finished
+     *
+     */
+    bool closed_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable notEmpty_;
+
+public:
+    /**
+     * @brief Stores an item, replacing the previous one if it was not taken
+     * @param item type : T
+     * @return bool - true if an untaken item was replaced
+     */
+    bool put(T item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool replaced = full_;
+        item_ = std::move(item);
+        full_ = true;
+        notEmpty_.notify_one();
+        return replaced;
+    }
+
+    /**
+     * @brief Takes the newest item, blocking until one is available
+     * @param item type : T& receives the item
+     * @return bool - false once the slot is closed and empty
+     */
+    bool take(T &item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        notEmpty_.wait(lock, [this] { return closed_ || full_; });
+        if (!full_)
+            return false;
+        item = std::move(item_);
+        full_ = false;
+        return true;
+    }
+
+    /**
+     * @brief Takes the newest item if one is available, without blocking
+     * @param item type : T& receives the item
+     * @return bool - true if an item was taken
+     */
+    bool tryTake(T &item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!full_)
+            return false;
+        item = std::move(item_);
+        full_ = false;
+        return true;
+    }
+
+    /**
+     * @brief Closes the slot and wakes up blocked consumers
+     * @param void
+     * @return void
+     */
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        notEmpty_.notify_all();
+    }
+};
+
+#endif  // INCLUDE_LATESTSLOT_H_
@@ -0,0 +1,162 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file ModelBundle.h
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Source header file for the ModelBundle class, a memory-mapped single file model.
+ * @version 0.1
+ * @date 2020-12-07
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+
+#ifndef INCLUDE_MODELBUNDLE_H_
+#define INCLUDE_MODELBUNDLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Read-only view of a model bundle: the darknet config, the weights, the output layer
+ *        names and the class labels packed into one versioned file with a checksum. The file
+ *        is memory-mapped shared, so processes starting one after another read the weights
+ *        from the page cache instead of the disk. Views stay valid until close().
+ *
+ */
+class ModelBundle
+{
+
+private:
+    /**
+     * @brief Private variables for the mapped file and its size in bytes
+     *
+     */
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+
+    /**
+     * @brief Private variables for the offsets and sizes of the config, weights, output names and
+     *        labels sections
+     *
+     */
+    size_t offsets_[4] = {0, 0, 0, 0};
+    size_t sizes_[4] = {0, 0, 0, 0};
+
+    /**
+     * @brief Splits a section into its lines
+     * @param section type : int
+     * @return std::vector<std::string>
+     */
+    std::vector<std::string> lines(int section);
+
+public:
+    /**
+     * @brief Version written into new bundles, bundles of other versions are rejected
+     *
+     */
+    static const uint32_t kVersion = 1;
+
+    /**
+     * @brief Construct a new Model Bundle object
+     *
+     */
+    ModelBundle() {}
+
+    ModelBundle(const ModelBundle &) = delete;
+    ModelBundle &operator=(const ModelBundle &) = delete;
+
+    /**
+     * @brief Packs model files into a bundle
+     * @param bundleFile type : const std::string& bundle to write
+     * @param configFile type : const std::string& darknet cfg
+     * @param weightsFile type : const std::string& darknet weights
+     * @param classFile type : const std::string& one label per line
+     * @param outputNames type : const std::vector<std::string>& output layer names of the network
+     * @return bool true if the bundle was written
+     */
+    static bool write(const std::string &bundleFile,
+    const std::string &configFile, const std::string &weightsFile,
+    const std::string &classFile, const std::vector<std::string> &outputNames);
+
+    /**
+     * @brief Maps a bundle and checks its magic, version, section table and checksum
+     * @param bundleFile type : const std::string&
+     * @return bool true if the bundle is valid, otherwise nothing stays mapped
+     */
+    bool open(const std::string &bundleFile);
+
+    /**
+     * @brief Unmaps the bundle
+     * @param void
+     * @return void
+     */
+    void close();
+
+    /**
+     * @brief Checks whether a bundle is mapped
+     * @param void
+     * @return bool
+     */
+    bool isOpen();
+
+    /**
+     * @brief Gets the darknet config text
+     * @param void
+     * @return const char* valid until close(), with getConfigSize() bytes
+     */
+    const char *getConfig();
+
+    /**
+     * @brief Gets the size of the darknet config in bytes
+     * @param void
+     * @return size_t
+     */
+    size_t getConfigSize();
+
+    /**
+     * @brief Gets the darknet weights
+     * @param void
+     * @return const char* valid until close(), with getWeightsSize() bytes
+     */
+    const char *getWeights();
+
+    /**
+     * @brief Gets the size of the darknet weights in bytes
+     * @param void
+     * @return size_t
+     */
+    size_t getWeightsSize();
+
+    /**
+     * @brief Gets the output layer names
+     * @param void
+     * @return std::vector<std::string>
+     */
+    std::vector<std::string> getOutputNames();
+
+    /**
+     * @brief Gets the class labels
+     * @param void
+     * @return std::vector<std::string>
+     */
+    std::vector<std::string> getLabels();
+
+    /**
+     * @brief 64-bit checksum of a buffer, eight bytes per step
+     * @param data type : const char*
+     * @param size type : size_t
+     * @return uint64_t
+     */
+    static uint64_t checksum(const char *data, size_t size);
+
+    /**
+     * @brief Destroy the Model Bundle object, unmaps the bundle
+     *
+     */
+    ~ModelBundle();
+};
+
+#endif  // INCLUDE_MODELBUNDLE_H_
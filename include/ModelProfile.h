@@ -0,0 +1,119 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file ModelProfile.h
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Source header file for the model profiles the detector can run and their comparison.
+ * @version 0.1
+ * @date 2020-12-07
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+
+#ifndef INCLUDE_MODELPROFILE_H_
+#define INCLUDE_MODELPROFILE_H_
+
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+/**
+ * @brief Model the detector runs, from the most accurate to the fastest
+ *
+ */
+enum class ModelProfile {
+    YOLOV4,
+    YOLOV4_LOW_RES,
+    YOLOV4_TINY,
+    ONNX_FP16,
+    ONNX_INT8
+};
+
+/**
+ * @brief Files and network input size of a model profile. ONNX profiles have no config file and
+ *        expect an export whose outputs keep the darknet rows: normalized center x, y, width,
+ *        height, objectness and the class scores.
+ *
+ */
+struct ModelProfileSpec {
+    std::string name;
+    std::string weightsFile;
+    std::string configFile;
+    cv::Size inputSize;
+};
+
+/**
+ * @brief Measured latency and agreement with full YOLOv4 of one profile on a clip
+ *
+ */
+struct ProfileResult {
+    std::string name;
+    bool loaded = false;
+    size_t frames = 0;
+    double meanMs = 0;
+    double precision = 0;
+    double recall = 0;
+};
+
+/**
+ * @brief Table of the model profiles and a latency/accuracy comparison of them on a reference
+ *        clip. Full YOLOv4 is the reference, the other profiles are scored by how many of its
+ *        person boxes they find and how many of theirs it confirms.
+ *
+ */
+class ModelProfiles
+{
+
+public:
+    /**
+     * @brief Gets the files and input size of a profile
+     * @param profile type : ModelProfile
+     * @return ModelProfileSpec
+     */
+    static ModelProfileSpec spec(ModelProfile profile);
+
+    /**
+     * @brief Gets every profile, the reference first
+     * @param void
+     * @return std::vector<ModelProfile>
+     */
+    static std::vector<ModelProfile> all();
+
+    /**
+     * @brief Parses a profile name: yolov4, yolov4-320, yolov4-tiny, onnx-fp16 or onnx-int8
+     * @param name type : const std::string&
+     * @param profile type : ModelProfile& set when the name is known
+     * @return bool true if the name is known
+     */
+    static bool parse(const std::string &name, ModelProfile &profile);
+
+    /**
+     * @brief Matches candidate boxes to reference boxes greedily by IoU, one to one
+     * @param reference type : const std::vector<cv::Rect>&
+     * @param candidate type : const std::vector<cv::Rect>&
+     * @param iouThreshold type : double minimum IoU of a match
+     * @return size_t number of matched pairs
+     */
+    static size_t matchBoxes(const std::vector<cv::Rect> &reference,
+    const std::vector<cv::Rect> &candidate, double iouThreshold = 0.5);
+
+    /**
+     * @brief Runs every profile on the first frames of a clip and measures the mean detection
+     *        latency and the precision and recall against full YOLOv4
+     * @param clip type : const std::string& reference video
+     * @param maxFrames type : int frames used from the start of the clip
+     * @return std::vector<ProfileResult> one result per profile, in the order of all()
+     */
+    static std::vector<ProfileResult> compare(const std::string &clip,
+    int maxFrames = 100);
+
+    /**
+     * @brief Prints a comparison as a table
+     * @param results type : const std::vector<ProfileResult>&
+     * @return void
+     */
+    static void printComparison(const std::vector<ProfileResult> &results);
+};
+
+#endif  // INCLUDE_MODELPROFILE_H_
@@ -0,0 +1,233 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file MotionGate.h
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Source header file for the MotionGate class that skips work on unchanged frames.
+ * @version 0.1
+ * @date 2020-12-04
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+
+#ifndef INCLUDE_MOTIONGATE_H_
+#define INCLUDE_MOTIONGATE_H_
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+/**
+ * @brief Counters of the motion gate
+ *
+ */
+struct GateStats {
+    size_t frames = 0;
+    size_t staticFrames = 0;
+    size_t shiftedFrames = 0;
+    size_t detectionsSkipped = 0;
+    size_t detectionsAllowed = 0;
+    size_t trackerUpdatesSkipped = 0;
+    size_t trackerUpdatesAllowed = 0;
+    double changedBlockSum = 0;
+    double gateMs = 0;
+};
+
+/**
+ * @brief Cheap change detector on a low resolution gray copy of the frame. It estimates the
+ *        global shift of the camera, compares the shifted previous frame block by block and keeps
+ *        a mask of the changed blocks. The differences run through OpenCV's SIMD kernels.
+ *
+ */
+class MotionGate
+{
+
+private:
+    /**
+     * @brief Private variable for the side of a block in low resolution pixels
+     *
+     */
+    int blockSize_ = 8;
+
+    /**
+     * @brief Private variable for the number of block columns
+     *
+     */
+    int gridCols_ = 20;
+
+    /**
+     * @brief Private variable for the largest global shift searched, in low resolution pixels
+     *
+     */
+    int searchRadius_ = 3;
+
+    /**
+     * @brief Private variable for the mean gray level change that marks a block as changed
+     *
+     */
+    double threshold_ = 12.0;
+
+    /**
+     * @brief Private variables for the previous and current low resolution gray frames
+     *
+     */
+    cv::Mat previous_;
+    cv::Mat current_;
+
+    /**
+     * @brief Private variable for a scratch gray image at frame resolution
+     *
+     */
+    cv::Mat gray_;
+
+    /**
+     * @brief Private variables for the scratch difference image and its block means
+     *
+     */
+    cv::Mat diff_;
+    cv::Mat blockMeans_;
+
+    /**
+     * @brief Private variable for the per-block changes of the last frame, one byte per block
+     *
+     */
+    cv::Mat mask_;
+
+    /**
+     * @brief Private variable for the size of the last frame
+     *
+     */
+    cv::Size frameSize_;
+
+    /**
+     * @brief Private variable for the global shift of the last frame in low resolution pixels
+     *
+     */
+    cv::Point shift_;
+
+    /**
+     * @brief Private variable for the number of changed blocks of the last frame
+     *
+     */
+    int changedBlocks_ = 0;
+
+    /**
+     * @brief Private variables for the smoothed cost of a detection and a tracker update in milliseconds
+     *
+     */
+    double detectionMs_ = 0;
+    double trackerMs_ = 0;
+
+    /**
+     * @brief Private variable for the gate counters
+     *
+     */
+    GateStats stats_;
+
+    /**
+     * @brief Finds the shift of the current frame against the previous one with the least mean change
+     * @param void
+     * @return cv::Point shift in low resolution pixels
+     */
+    cv::Point estimateShift();
+
+public:
+    /**
+     * @brief Construct a new Motion Gate object
+     *
+     */
+    MotionGate() {}
+
+    /**
+     * @brief Sets the mean gray level change that marks a block as changed
+     * @param threshold type : double
+     * @return void
+     */
+    void setThreshold(double threshold);
+
+    /**
+     * @brief Compares a frame with the previous one and updates the change mask. Call once per frame.
+     * @param frame type : const cv::Mat& BGR or gray frame
+     * @return void
+     */
+    void update(const cv::Mat &frame);
+
+    /**
+     * @brief Checks whether any block changed on the last frame
+     * @param void
+     * @return bool
+     */
+    bool sceneChanged();
+
+    /**
+     * @brief Decides whether a scheduled detection runs, only on a changed scene
+     * @param void
+     * @return bool
+     */
+    bool allowDetection();
+
+    /**
+     * @brief Decides whether the tracker updates, only when the scene changed or the camera moved
+     * @param void
+     * @return bool
+     */
+    bool allowTrackerUpdate();
+
+    /**
+     * @brief Gets the change mask of the last frame, one byte per block, 255 where it changed
+     * @param void
+     * @return cv::Mat
+     */
+    cv::Mat getChangeMask();
+
+    /**
+     * @brief Gets the changed blocks of the last frame in frame coordinates
+     * @param void
+     * @return std::vector<cv::Rect2d>
+     */
+    std::vector<cv::Rect2d> getChangedRegions();
+
+    /**
+     * @brief Gets the global shift of the last frame in frame pixels
+     * @param void
+     * @return cv::Point2d
+     */
+    cv::Point2d getGlobalShift();
+
+    /**
+     * @brief Records the cost of a detection pass, used to report the compute saved
+     * @param detectionMs type : double
+     * @return void
+     */
+    void recordDetection(double detectionMs);
+
+    /**
+     * @brief Records the cost of a tracker update, used to report the compute saved
+     * @param trackerMs type : double
+     * @return void
+     */
+    void recordTrackerUpdate(double trackerMs);
+
+    /**
+     * @brief Gets the gate counters
+     * @param void
+     * @return GateStats
+     */
+    GateStats getStats();
+
+    /**
+     * @brief Prints the skip rates and the estimated compute saved
+     * @param void
+     * @return void
+     */
+    void printStats();
+
+    /**
+     * @brief Destroy the Motion Gate object
+     *
+     */
+    ~MotionGate() {}
+};
+
+#endif  // INCLUDE_MOTIONGATE_H_
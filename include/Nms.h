@@ -0,0 +1,232 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file Nms.h
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Source header file for the non maximum suppression of person boxes
+ * @version 0.1
+ * @date 2020-12-13
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+
+#ifndef INCLUDE_NMS_H_
+#define INCLUDE_NMS_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+/**
+ * @brief How overlapping boxes are suppressed
+ *
+ */
+enum class NmsMethod {
+    GREEDY,
+    DIOU,
+    SOFT_LINEAR,
+    SOFT_GAUSSIAN
+};
+
+/**
+ * @brief Settings of the suppression
+ *
+ */
+struct NmsOptions {
+    NmsMethod method = NmsMethod::GREEDY;
+    // Gaussian soft-NMS decay, scores are multiplied by exp(-iou^2 / sigma)
+    float sigma = 0.5f;
+    // Most boxes kept per call, 0 for no limit
+    int maxDetections = 0;
+};
+
+/**
+ * @brief Non maximum suppression for the thousands of candidates of crowded and tiled frames.
+ *        Candidates are visited in score order and only compared with the kept boxes of the
+ *        grid cells they cover, several at a time with SIMD. Pairs whose float IoU comes near
+ *        the threshold are decided with the exact arithmetic of cv::dnn::NMSBoxes, so the
+ *        greedy method keeps exactly the boxes NMSBoxes keeps, in the same order. DIoU and
+ *        soft-NMS are optional, and the output can be capped. Buffers are kept between calls.
+ *
+ */
+class Nms
+{
+
+private:
+    /**
+     * @brief Private variable for the settings
+     *
+     */
+    NmsOptions options_;
+
+    /**
+     * @brief Private variable for the candidates above the score threshold, by falling score
+     *
+     */
+    std::vector<std::pair<float, int>> order_;
+
+    /**
+     * @brief Private variables for the corners and areas of the compared boxes, one array each
+     *        so a SIMD register holds the same coordinate of several boxes
+     *
+     */
+    std::vector<float> x1_, y1_, x2_, y2_, area_;
+
+    /**
+     * @brief Private variable for the input index of every entry of the arrays above
+     *
+     */
+    std::vector<int> entries_;
+
+    /**
+     * @brief Private variables for the neighbours of a box gathered from the grid, same layout
+     *
+     */
+    std::vector<float> nx1_, ny1_, nx2_, ny2_, nArea_;
+    std::vector<int> neighbours_;
+
+    /**
+     * @brief Private variables for the grid, every cell lists the entries that cover it
+     *
+     */
+    std::vector<std::vector<int>> cells_;
+    int gridCols_ = 0;
+    int gridRows_ = 0;
+    float originX_ = 0;
+    float originY_ = 0;
+    float cellWidth_ = 1;
+    float cellHeight_ = 1;
+
+    /**
+     * @brief Private variable for the last box every entry was gathered for, against duplicates
+     *        from the cells a box covers
+     *
+     */
+    std::vector<int> visited_;
+
+    /**
+     * @brief Private variables for the current scores, liveness and heap of soft-NMS
+     *
+     */
+    std::vector<float> scores_;
+    std::vector<char> alive_;
+    std::vector<std::pair<float, int>> heap_;
+
+    /**
+     * @brief Private variable for the final score of every kept box
+     *
+     */
+    std::vector<float> keptScores_;
+
+    /**
+     * @brief Sizes the grid to the candidates and empties it
+     * @param boxes type : const std::vector<cv::Rect>&
+     * @return void
+     */
+    void buildGrid(const std::vector<cv::Rect> &boxes);
+
+    /**
+     * @brief Adds an entry to every cell its box covers
+     * @param entry type : int
+     * @return void
+     */
+    void insert(int entry);
+
+    /**
+     * @brief Copies the entries in the cells a box covers into the neighbour arrays
+     * @param box type : const cv::Rect&
+     * @param stamp type : int unique per box
+     * @param liveOnly type : bool skip entries that are no longer alive
+     * @return void
+     */
+    void gather(const cv::Rect &box, int stamp, bool liveOnly);
+
+    /**
+     * @brief Appends a box to the entry arrays
+     * @param box type : const cv::Rect&
+     * @param index type : int input index
+     * @return void
+     */
+    void addEntry(const cv::Rect &box, int index);
+
+    /**
+     * @brief Greedy suppression, by IoU or DIoU
+     * @param boxes type : const std::vector<cv::Rect>&
+     * @param nmsThreshold type : float
+     * @param indices type : std::vector<int>&
+     * @return void
+     */
+    void runGreedy(const std::vector<cv::Rect> &boxes, float nmsThreshold,
+    std::vector<int> &indices);
+
+    /**
+     * @brief Soft suppression, decaying the scores of overlapping boxes
+     * @param boxes type : const std::vector<cv::Rect>&
+     * @param scoreThreshold type : float
+     * @param nmsThreshold type : float
+     * @param indices type : std::vector<int>&
+     * @return void
+     */
+    void runSoft(const std::vector<cv::Rect> &boxes, float scoreThreshold,
+    float nmsThreshold, std::vector<int> &indices);
+
+public:
+    /**
+     * @brief Construct a new Nms object
+     *
+     */
+    Nms() {}
+
+    /**
+     * @brief Sets the method, soft-NMS sigma and output cap
+     * @param options type : const NmsOptions&
+     * @return void
+     */
+    void setOptions(const NmsOptions &options);
+
+    /**
+     * @brief Gets the settings
+     * @param void
+     * @return NmsOptions
+     */
+    NmsOptions getOptions();
+
+    /**
+     * @brief Suppresses overlapping boxes, same arguments as cv::dnn::NMSBoxes
+     * @param boxes type : const std::vector<cv::Rect>&
+     * @param scores type : const std::vector<float>&
+     * @param scoreThreshold type : float boxes at or below it are dropped
+     * @param nmsThreshold type : float boxes overlapping a kept one by more are suppressed
+     * @param indices type : std::vector<int>& kept boxes, by falling score
+     * @return void
+     */
+    void run(const std::vector<cv::Rect> &boxes,
+    const std::vector<float> &scores, float scoreThreshold, float nmsThreshold,
+    std::vector<int> &indices);
+
+    /**
+     * @brief Gets the score of every box kept by the last run, in the order of its indices.
+     *        Soft-NMS lowers the scores of boxes it keeps.
+     * @param void
+     * @return const std::vector<float>&
+     */
+    const std::vector<float> &getKeptScores();
+
+    /**
+     * @brief Parses a method name: greedy, diou, soft-linear or soft-gaussian
+     * @param name type : const std::string&
+     * @param method type : NmsMethod&
+     * @return bool false for an unknown name
+     */
+    static bool parseMethod(const std::string &name, NmsMethod &method);
+
+    /**
+     * @brief Destroy the Nms object
+     *
+     */
+    ~Nms() {}
+};
+
+#endif  // INCLUDE_NMS_H_
@@ -0,0 +1,225 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file OfflineProcessor.h
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Source header file for the OfflineProcessor class that processes recorded video by segment.
+ * @version 0.1
+ * @date 2020-12-08
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+
+#ifndef INCLUDE_OFFLINEPROCESSOR_H_
+#define INCLUDE_OFFLINEPROCESSOR_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "Detection.h"
+
+/**
+ * @brief One tracked box on one frame
+ *
+ */
+struct TrackRecord {
+    int frame = 0;
+    int id = 0;
+    cv::Rect2d box;
+};
+
+/**
+ * @brief Timings and counters of the last offline run
+ *
+ */
+struct OfflineStats {
+    int frames = 0;
+    int segments = 0;
+    int workers = 0;
+    int tracks = 0;
+    double trackingMs = 0;
+    double stitchingMs = 0;
+    double renderingMs = 0;
+};
+
+/**
+ * @brief Processes a recorded video on all cores. The video is cut into segments whose starts
+ *        are multiples of the keyframe interval. A worker seeks to the keyframe at or before
+ *        the early start of its segment and skips forward from there. Workers take segments
+ *        from a shared counter, each with its own detector and SORT tracker.
+ *        A segment starts its tracker some frames early, and the tracks of this overlap are
+ *        matched by IoU to the tracks the previous segment ended with to stitch the IDs. The
+ *        stitched tracks are drawn into one video and written to one detection log.
+ *
+ */
+class OfflineProcessor
+{
+
+private:
+    /**
+     * @brief Private variable for the number of worker threads, 0 for one per core
+     *
+     */
+    int numWorkers_ = 0;
+
+    /**
+     * @brief Private variable for the keyframe interval of the input in frames
+     *
+     */
+    int keyframeInterval_ = 250;
+
+    /**
+     * @brief Private variable for the frames a segment is tracked before its start
+     *
+     */
+    int overlap_ = 45;
+
+    /**
+     * @brief Private variable for the frames between two detections, like the sequential mode
+     *
+     */
+    int detectionInterval_ = 45;
+
+    /**
+     * @brief Private variable for the minimum mean IoU of two stitched tracks
+     *
+     */
+    double stitchIou_ = 0.3;
+
+    /**
+     * @brief Private variable for the model every worker loads
+     *
+     */
+    ModelProfile profile_ = ModelProfile::YOLOV4;
+
+    /**
+     * @brief Private variable for the non maximum suppression of every worker
+     *
+     */
+    NmsOptions nmsOptions_;
+
+    /**
+     * @brief Private variable for letterboxing the frames, false to stretch them
+     *
+     */
+    bool letterbox_ = true;
+
+    /**
+     * @brief Private variable for the counters of the last run
+     *
+     */
+    OfflineStats stats_;
+
+    /**
+     * @brief Detects and tracks one segment, starting the tracker overlap frames early
+     * @param detection type : Detection& detector of the calling worker
+     * @param video type : const std::string&
+     * @param segment type : cv::Range frames of the segment
+     * @param last type : bool the last segment reads to the end of the video
+     * @return std::vector<TrackRecord> records of the overlap and the segment, segment local IDs
+     */
+    std::vector<TrackRecord> trackSegment(Detection &detection,
+    const std::string &video, cv::Range segment, bool last);
+
+public:
+    /**
+     * @brief Construct a new Offline Processor object
+     *
+     */
+    OfflineProcessor() {}
+
+    /**
+     * @brief Sets the number of worker threads
+     * @param numWorkers type : int 0 for one per core
+     * @return void
+     */
+    void setNumWorkers(int numWorkers);
+
+    /**
+     * @brief Sets the keyframe interval of the input, segments start on its multiples
+     * @param keyframeInterval type : int frames
+     * @return void
+     */
+    void setKeyframeInterval(int keyframeInterval);
+
+    /**
+     * @brief Sets the frames a segment is tracked before its start for stitching
+     * @param overlap type : int frames
+     * @return void
+     */
+    void setOverlap(int overlap);
+
+    /**
+     * @brief Sets the frames between two detections
+     * @param detectionInterval type : int
+     * @return void
+     */
+    void setDetectionInterval(int detectionInterval);
+
+    /**
+     * @brief Sets the model and the non maximum suppression every worker's detector uses
+     * @param profile type : ModelProfile
+     * @param nmsOptions type : const NmsOptions&
+     * @param letterbox type : bool false to stretch the frames to the network input
+     * @return void
+     */
+    void setModelConfig(ModelProfile profile, const NmsOptions &nmsOptions,
+    bool letterbox);
+
+    /**
+     * @brief Cuts a video into about two segments per worker, each a multiple of the keyframe
+     *        interval long
+     * @param frameCount type : int
+     * @param numWorkers type : int
+     * @param keyframeInterval type : int
+     * @return std::vector<cv::Range> consecutive segments covering [0, frameCount)
+     */
+    static std::vector<cv::Range> planSegments(int frameCount, int numWorkers,
+    int keyframeInterval);
+
+    /**
+     * @brief Matches the tracks of a segment to the tracks of the previous one on the frames
+     *        both tracked, by the mean IoU over those frames
+     * @param previous type : const std::vector<TrackRecord>& previous segment, stitched IDs
+     * @param current type : const std::vector<TrackRecord>& current segment, local IDs
+     * @param overlap type : cv::Range frames tracked by both
+     * @param minIou type : double
+     * @return std::map<int, int> stitched ID of every matched local ID
+     */
+    static std::map<int, int> stitchIds(const std::vector<TrackRecord> &previous,
+    const std::vector<TrackRecord> &current, cv::Range overlap, double minIou);
+
+    /**
+     * @brief Processes a video and writes the annotated video and the detection log
+     * @param video type : const std::string& input video
+     * @param outputVideo type : const std::string& annotated video to write
+     * @param logFile type : const std::string& CSV of frame, id, x, y, width, height
+     * @return bool false if the input could not be opened
+     */
+    bool process(const std::string &video, const std::string &outputVideo,
+    const std::string &logFile);
+
+    /**
+     * @brief Gets the counters of the last run
+     * @param void
+     * @return OfflineStats
+     */
+    OfflineStats getStats();
+
+    /**
+     * @brief Prints the counters of the last run
+     * @param void
+     * @return void
+     */
+    void printStats();
+
+    /**
+     * @brief Destroy the Offline Processor object
+     *
+     */
+    ~OfflineProcessor() {}
+};
+
+#endif  // INCLUDE_OFFLINEPROCESSOR_H_
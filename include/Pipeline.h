@@ -0,0 +1,300 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file Pipeline.h
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Source header file for the staged detect/track Pipeline class.
+ * @version 0.1
+ * @date 2020-11-20
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+
+#ifndef INCLUDE_PIPELINE_H_
+#define INCLUDE_PIPELINE_H_
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include "BoundedQueue.h"
+#include "LatestSlot.h"
+#include "Detection.h"
+#include "DetectionPolicy.h"
+#include "FramePool.h"
+#include "Track.h"
+
+/**
+ * @brief Frame handed from the decoder to the later stages
+ *
+ */
+struct PipelineFrame {
+    int frameNumber = 0;
+    FrameHandle buffer;
+    cv::Mat frame;
+    bool runDetection = false;
+    std::chrono::steady_clock::time_point captureTime;
+};
+
+/**
+ * @brief Detections of one frame handed from the inference worker to the tracker
+ *
+ */
+struct PipelineResult {
+    int frameNumber = 0;
+    std::vector<cv::Rect> detections;
+};
+
+/**
+ * @brief Throughput counters of one pipeline stage
+ *
+ */
+struct StageStats {
+    std::string name;
+    size_t frames = 0;
+    double busyMs = 0;
+    double wallMs = 0;
+};
+
+/**
+ * @brief Depth counters of one pipeline queue
+ *
+ */
+struct QueueStats {
+    std::string name;
+    size_t capacity = 0;
+    size_t maxDepth = 0;
+    double averageDepth = 0;
+};
+
+/**
+ * @brief Counters of one real-time run
+ *
+ */
+struct RealtimeStats {
+    size_t captured = 0;
+    size_t processed = 0;
+    size_t dropped = 0;
+    size_t stale = 0;
+    size_t detections = 0;
+    size_t coalesced = 0;
+    size_t overBudget = 0;
+    double latencyBudgetMs = 0;
+    double averageLatencyMs = 0;
+    double maxLatencyMs = 0;
+};
+
+/**
+ * @brief Runs decode, YOLO inference, tracking and encode on separate threads connected by
+ *        bounded queues. Frames keep their order, and the detections of a frame are merged
+ *        back into the tracker when the tracker reaches that frame.
+ *
+ */
+class Pipeline
+{
+
+private:
+    /**
+     * @brief Private variable for the detector used by the inference worker
+     *
+     */
+    Detection &detection_;
+
+    /**
+     * @brief Private variable for the tracker used by the tracker stage
+     *
+     */
+    Track &tracker_;
+
+    /**
+     * @brief Private variable for the capacity of the frame queues
+     *
+     */
+    size_t queueCapacity_;
+
+    /**
+     * @brief Private variable for the number of frames between two detection passes
+     *
+     */
+    int detectionInterval_ = 45;
+
+    /**
+     * @brief Private variable for the optional adaptive detection policy, replaces the interval
+     *
+     */
+    DetectionPolicy *policy_ = nullptr;
+
+    /**
+     * @brief Private variables for the tracker signals and the last inference time the policy
+     *        reads. The tracker stage publishes them, so the decoder sees them a few frames late.
+     *
+     */
+    std::atomic<int> activeTracks_{0};
+    std::atomic<int> lostTracks_{0};
+    std::atomic<double> inferenceMs_{0};
+
+    /**
+     * @brief Feeds the last inference time to the policy and asks it about this frame
+     * @param frame type : const cv::Mat&
+     * @return bool - true if detection should run
+     */
+    bool policyWantsDetection(const cv::Mat &frame);
+
+    /**
+     * @brief Private variable for the stage counters of the last run
+     *
+     */
+    std::vector<StageStats> stageStats_;
+
+    /**
+     * @brief Private variable for the queue counters of the last run
+     *
+     */
+    std::vector<QueueStats> queueStats_;
+
+    /**
+     * @brief Private variable for the counters of the last real-time run
+     *
+     */
+    RealtimeStats realtimeStats_;
+
+    /**
+     * @brief Reads frames and dispatches them to the tracker and, on detection frames, to inference
+     * @param capture type : cv::VideoCapture& opened input stream
+     * @param pool type : FramePool& buffers the frames are decoded into
+     * @param trackQueue type : BoundedQueue<PipelineFrame>& frames for the tracker
+     * @param inferQueue type : BoundedQueue<PipelineFrame>& frames for the inference worker
+     * @param stats type : StageStats& counters of this stage
+     * @return void
+     */
+    void decodeStage(cv::VideoCapture &capture, FramePool &pool,
+    BoundedQueue<PipelineFrame> &trackQueue,
+    BoundedQueue<PipelineFrame> &inferQueue, StageStats &stats);
+
+    /**
+     * @brief Runs YOLO on every frame it receives, in order
+     * @param inferQueue type : BoundedQueue<PipelineFrame>& input frames
+     * @param resultQueue type : BoundedQueue<PipelineResult>& detections for the tracker
+     * @param stats type : StageStats& counters of this stage
+     * @return void
+     */
+    void inferenceStage(BoundedQueue<PipelineFrame> &inferQueue,
+    BoundedQueue<PipelineResult> &resultQueue, StageStats &stats);
+
+    /**
+     * @brief Updates the tracker on every frame and re-seeds it with the detections of detection frames
+     * @param trackQueue type : BoundedQueue<PipelineFrame>& input frames
+     * @param resultQueue type : BoundedQueue<PipelineResult>& detections from inference
+     * @param encodeQueue type : BoundedQueue<PipelineFrame>& annotated frames
+     * @param stats type : StageStats& counters of this stage
+     * @return void
+     */
+    void trackStage(BoundedQueue<PipelineFrame> &trackQueue,
+    BoundedQueue<PipelineResult> &resultQueue,
+    BoundedQueue<PipelineFrame> &encodeQueue, StageStats &stats);
+
+    /**
+     * @brief Hands annotated frames to the output sink
+     * @param encodeQueue type : BoundedQueue<PipelineFrame>& annotated frames
+     * @param sink type : std::function<void(const cv::Mat &)> writes one frame
+     * @param stats type : StageStats& counters of this stage
+     * @return void
+     */
+    void encodeStage(BoundedQueue<PipelineFrame> &encodeQueue,
+    const std::function<void(const cv::Mat &)> &sink, StageStats &stats);
+
+public:
+    /**
+     * @brief Construct a new Pipeline object
+     * @param detection type : Detection& detector with a loaded model
+     * @param tracker type : Track& tracker owned by this pipeline while it runs
+     * @param queueCapacity type : size_t capacity of the frame queues. Bounds memory
+     *        and how far the decoder may run ahead of the tracker.
+     */
+    Pipeline(Detection &detection, Track &tracker, size_t queueCapacity = 64);
+
+    /**
+     * @brief Sets the number of frames between two detection passes
+     * @param interval type : int
+     * @return void
+     */
+    void setDetectionInterval(int interval);
+
+    /**
+     * @brief Lets an adaptive policy decide which frames get a detection pass
+     * @param policy type : DetectionPolicy* policy used by this pipeline only, nullptr for the interval
+     * @return void
+     */
+    void setDetectionPolicy(DetectionPolicy *policy);
+
+    /**
+     * @brief Processes the whole stream. Returns when the last frame has been handed to the sink.
+     * @param capture type : cv::VideoCapture& opened input stream
+     * @param sink type : std::function<void(const cv::Mat &)> called once per frame, in order
+     * @return int - number of frames processed
+     */
+    int run(cv::VideoCapture &capture,
+    const std::function<void(const cv::Mat &)> &sink);
+
+    /**
+     * @brief Processes a live stream under a latency budget. The grabber always keeps only the
+     *        newest frame, frames older than the budget are skipped, and the tracker coasts
+     *        while a detection runs in the background. A finished detection re-seeds the
+     *        tracker on the newest frame, and detection requests made while one is running
+     *        are coalesced into a single request.
+     * @param capture type : cv::VideoCapture& opened input stream. Recorded files are paced to
+     *        their frame rate so they behave like a camera.
+     * @param sink type : std::function<void(const cv::Mat &)> called once per processed frame
+     * @param latencyBudgetMs type : double maximum age of a frame from capture to output
+     * @return int - number of frames processed
+     */
+    int runRealtime(cv::VideoCapture &capture,
+    const std::function<void(const cv::Mat &)> &sink, double latencyBudgetMs);
+
+    /**
+     * @brief Gets the counters of the last real-time run
+     * @param void
+     * @return RealtimeStats
+     */
+    RealtimeStats getRealtimeStats();
+
+    /**
+     * @brief Prints dropped, stale and coalesced counts and latency of the last real-time run
+     * @param void
+     * @return void
+     */
+    void printRealtimeStats();
+
+    /**
+     * @brief Gets the stage counters of the last run
+     * @param void
+     * @return std::vector<StageStats>
+     */
+    std::vector<StageStats> getStageStats();
+
+    /**
+     * @brief Gets the queue counters of the last run
+     * @param void
+     * @return std::vector<QueueStats>
+     */
+    std::vector<QueueStats> getQueueStats();
+
+    /**
+     * @brief Prints per-stage throughput and queue depth of the last run
+     * @param void
+     * @return void
+     */
+    void printStats();
+
+    /**
+     * @brief Destroy the Pipeline object
+     *
+     */
+    ~Pipeline() {}
+};
+
+#endif  // INCLUDE_PIPELINE_H_
@@ -0,0 +1,163 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file Preprocessor.h
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Source header file for the Preprocessor class that builds the network input in one pass.
+ * @version 0.1
+ * @date 2020-12-06
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+
+#ifndef INCLUDE_PREPROCESSOR_H_
+#define INCLUDE_PREPROCESSOR_H_
+
+#include <memory>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "ThreadPool.h"
+
+/**
+ * @brief Placement of a frame inside the letterboxed network input
+ *
+ */
+struct LetterboxInfo {
+    bool active = false;
+    float scale = 1;
+    int padX = 0;
+    int padY = 0;
+    cv::Size content;
+    cv::Size input;
+};
+
+/**
+ * @brief Turns a BGR frame into a planar RGB float blob in a single pass: letterbox resize with
+ *        bilinear interpolation, channel swap, 1/255 scaling and HWC to CHW packing. Each output
+ *        row interpolates its two source rows into a float row with SIMD, then gathers the output
+ *        pixels of all three channels with SIMD lookups. Large frames are split into row bands
+ *        on a thread pool. Tables and row buffers are kept, so frames of the same size allocate
+ *        nothing.
+ *
+ */
+class Preprocessor
+{
+
+private:
+    /**
+     * @brief Private variable for the network input size
+     *
+     */
+    cv::Size inputSize_ = cv::Size(416, 416);
+
+    /**
+     * @brief Private variable for the frame size the tables were built for
+     *
+     */
+    cv::Size frameSize_;
+
+    /**
+     * @brief Private variable for the placement of the last frame
+     *
+     */
+    LetterboxInfo info_;
+
+    /**
+     * @brief Private variables for the left and right source offsets and the weight of every output column
+     *
+     */
+    std::vector<int> xLeft_;
+    std::vector<int> xRight_;
+    std::vector<float> xWeight_;
+
+    /**
+     * @brief Private variables for the top and bottom source rows and the weight of every output row
+     *
+     */
+    std::vector<int> yTop_;
+    std::vector<int> yBottom_;
+    std::vector<float> yWeight_;
+
+    /**
+     * @brief Private variable for one interpolated source row per band
+     *
+     */
+    std::vector<std::vector<float>> rowBuffers_;
+
+    /**
+     * @brief Private variable for the number of threads, the calling thread included
+     *
+     */
+    int numThreads_ = 1;
+
+    /**
+     * @brief Private variable for the pool of the row bands, created on first use
+     *
+     */
+    std::shared_ptr<ThreadPool> pool_;
+
+    /**
+     * @brief Builds the interpolation tables for a frame size
+     * @param frameSize type : cv::Size
+     * @return void
+     */
+    void buildTables(cv::Size frameSize);
+
+    /**
+     * @brief Writes the output rows [firstRow, lastRow) of the blob
+     * @param frame type : const cv::Mat& 8-bit BGR frame
+     * @param blob type : float* 3 planes of the input size
+     * @param firstRow type : int
+     * @param lastRow type : int
+     * @param rowBuffer type : float* interpolated source row
+     * @return void
+     */
+    void processRows(const cv::Mat &frame, float *blob, int firstRow,
+    int lastRow, float *rowBuffer);
+
+public:
+    /**
+     * @brief Construct a new Preprocessor object
+     *
+     */
+    Preprocessor() {}
+
+    /**
+     * @brief Sets the network input size
+     * @param inputSize type : cv::Size
+     * @return void
+     */
+    void setInputSize(cv::Size inputSize);
+
+    /**
+     * @brief Sets the number of threads used on large frames
+     * @param numThreads type : int the calling thread included
+     * @return void
+     */
+    void setNumThreads(int numThreads);
+
+    /**
+     * @brief Writes the letterboxed blob of a frame
+     * @param frame type : const cv::Mat& 8-bit BGR frame
+     * @param blob type : float* room for 3 planes of the input size
+     * @return const LetterboxInfo& placement of the frame in the blob
+     */
+    const LetterboxInfo &run(const cv::Mat &frame, float *blob);
+
+    /**
+     * @brief Maps a box in network input pixels back to frame pixels
+     * @param box type : const cv::Rect& box in network input pixels
+     * @param info type : const LetterboxInfo&
+     * @return cv::Rect box in frame pixels
+     */
+    static cv::Rect undo(const cv::Rect &box, const LetterboxInfo &info);
+
+    /**
+     * @brief Destroy the Preprocessor object
+     *
+     */
+    ~Preprocessor() {}
+};
+
+#endif  // INCLUDE_PREPROCESSOR_H_
@@ -0,0 +1,245 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file Profiler.h
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Source header file for the per-stage latency instrumentation of the frame loop.
+ * @version 0.1
+ * @date 2020-12-10
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+
+#ifndef INCLUDE_PROFILER_H_
+#define INCLUDE_PROFILER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Stages of the frame loop that are timed
+ *
+ */
+enum class Stage {
+    DECODE,
+    PREPROCESS,
+    FORWARD,
+    POSTPROCESS,
+    TRACK_DETECTIONS,
+    TRACK_UPDATE,
+    DRAW,
+    ENCODE,
+    COUNT
+};
+
+/**
+ * @brief Latency summary of one stage, in milliseconds
+ *
+ */
+struct StageSummary {
+    Stage stage = Stage::DECODE;
+    uint64_t count = 0;
+    double p50 = 0;
+    double p95 = 0;
+    double p99 = 0;
+    double max = 0;
+};
+
+/**
+ * @brief Process wide collector of stage timings. Every thread records into its own log-linear
+ *        histograms, one per stage, without locks; the reporter reads them while they fill.
+ *        Buckets are 1/16 of a power of two wide, so percentiles are within about 6 percent.
+ *        When switched off a probe costs one relaxed atomic load.
+ *
+ */
+class Profiler
+{
+
+private:
+    /**
+     * @brief Private variables for the switches of the histograms and of the trace events
+     *
+     */
+    static std::atomic<bool> enabled_;
+    static std::atomic<bool> tracing_;
+
+public:
+    /**
+     * @brief Sub-buckets per power of two and number of buckets of a histogram
+     *
+     */
+    static const int kSubBuckets = 16;
+    static const int kBuckets = (64 - 3) * kSubBuckets;
+
+    /**
+     * @brief Switches the recording on or off
+     * @param enabled type : bool
+     * @return void
+     */
+    static void setEnabled(bool enabled);
+
+    /**
+     * @brief Checks whether probes record
+     * @param void
+     * @return bool
+     */
+    static bool isEnabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Switches the recording of Chrome trace events on or off
+     * @param tracing type : bool
+     * @return void
+     */
+    static void setTracing(bool tracing);
+
+    /**
+     * @brief Records one timed interval of a stage on the calling thread
+     * @param stage type : Stage
+     * @param start type : std::chrono::steady_clock::time_point
+     * @param end type : std::chrono::steady_clock::time_point
+     * @return void
+     */
+    static void record(Stage stage, std::chrono::steady_clock::time_point start,
+    std::chrono::steady_clock::time_point end);
+
+    /**
+     * @brief Maps a duration to its histogram bucket
+     * @param nanoseconds type : uint64_t
+     * @return int
+     */
+    static int bucketOf(uint64_t nanoseconds);
+
+    /**
+     * @brief Gets the largest duration that falls into a bucket
+     * @param bucket type : int
+     * @return uint64_t nanoseconds
+     */
+    static uint64_t bucketUpperBound(int bucket);
+
+    /**
+     * @brief Merges the histograms of all threads into one summary per stage that ran
+     * @param void
+     * @return std::vector<StageSummary>
+     */
+    static std::vector<StageSummary> summarize();
+
+    /**
+     * @brief Clears the histograms and trace events of all threads. Not for use while
+     *        probes are recording.
+     * @param void
+     * @return void
+     */
+    static void reset();
+
+    /**
+     * @brief Prints p50, p95, p99 and max of every stage that ran
+     * @param void
+     * @return void
+     */
+    static void printReport();
+
+    /**
+     * @brief Writes the recorded trace events as Chrome trace-event JSON, for chrome://tracing
+     *        or Perfetto
+     * @param file type : const std::string&
+     * @return bool false if the file could not be written
+     */
+    static bool writeTrace(const std::string &file);
+
+    /**
+     * @brief Gets the name of a stage
+     * @param stage type : Stage
+     * @return const char*
+     */
+    static const char *stageName(Stage stage);
+};
+
+/**
+ * @brief Times the enclosing scope as one stage interval. Does nothing but check the switch when
+ *        the profiler is off.
+ *
+ */
+class ScopedTimer
+{
+
+private:
+    /**
+     * @brief Private variables for the stage, the start time and whether the timer runs
+     *
+     */
+    Stage stage_;
+    std::chrono::steady_clock::time_point start_;
+    bool active_;
+
+public:
+    /**
+     * @brief Construct a new Scoped Timer object, starts timing if the profiler is on
+     * @param stage type : Stage
+     */
+    explicit ScopedTimer(Stage stage) : stage_(stage),
+    active_(Profiler::isEnabled()) {
+        if (active_)
+            start_ = std::chrono::steady_clock::now();
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    /**
+     * @brief Destroy the Scoped Timer object, records the interval
+     *
+     */
+    ~ScopedTimer() {
+        if (active_)
+            Profiler::record(stage_, start_, std::chrono::steady_clock::now());
+    }
+};
+
+/**
+ * @brief Turns the profiler on for the lifetime of the session, prints a report every interval
+ *        from a background thread, and prints the final report and writes the trace when it ends
+ *
+ */
+class ProfilerSession
+{
+
+private:
+    /**
+     * @brief Private variables for the report interval, the trace file and the report thread
+     *
+     */
+    double intervalSeconds_;
+    std::string traceFile_;
+    std::thread reporter_;
+    std::mutex mutex_;
+    std::condition_variable stop_;
+    bool stopping_ = false;
+
+public:
+    /**
+     * @brief Construct a new Profiler Session object
+     * @param intervalSeconds type : double seconds between reports, 0 to report only at the end
+     * @param traceFile type : const std::string& Chrome trace to write at the end, empty for none
+     */
+    ProfilerSession(double intervalSeconds, const std::string &traceFile);
+
+    ProfilerSession(const ProfilerSession &) = delete;
+    ProfilerSession &operator=(const ProfilerSession &) = delete;
+
+    /**
+     * @brief Destroy the Profiler Session object, reports and switches the profiler off
+     *
+     */
+    ~ProfilerSession();
+};
+
+#endif  // INCLUDE_PROFILER_H_
@@ -0,0 +1,127 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file ResultWriter.h
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Source header file for the ResultWriter class that streams per-frame tracks as JSON lines.
+ * @version 0.1
+ * @date 2020-12-09
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+
+#ifndef INCLUDE_RESULTWRITER_H_
+#define INCLUDE_RESULTWRITER_H_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+/**
+ * @brief One track on one frame as the path planner sees it
+ *
+ */
+struct TrackResult {
+    int id = 0;
+    cv::Rect2d box;
+    float confidence = 0;
+    cv::Point2f pose;
+};
+
+/**
+ * @brief Writes one JSON object per frame and line, for example
+ *        {"frame":3,"t":100.0,"tracks":[{"id":1,"box":[10,20,30,60],"conf":0.91,"pose":[25,50]}]}
+ *        Lines are formatted into a reused buffer and written with stdio, so stdout can carry
+ *        the results while std::cout is pointed elsewhere.
+ *
+ */
+class ResultWriter
+{
+
+private:
+    /**
+     * @brief Private variable for the output stream
+     *
+     */
+    std::FILE *out_ = nullptr;
+
+    /**
+     * @brief Private variable set when the stream was opened here and is closed here
+     *
+     */
+    bool ownsFile_ = false;
+
+    /**
+     * @brief Private variable for the line being formatted, reused from frame to frame
+     *
+     */
+    std::string line_;
+
+    /**
+     * @brief Private variable for the number of frames written
+     *
+     */
+    size_t frames_ = 0;
+
+public:
+    /**
+     * @brief Construct a new Result Writer object
+     *
+     */
+    ResultWriter() {}
+
+    ResultWriter(const ResultWriter &) = delete;
+    ResultWriter &operator=(const ResultWriter &) = delete;
+
+    /**
+     * @brief Opens the output
+     * @param path type : const std::string& file to write, "-" for stdout
+     * @return bool true if the output can be written
+     */
+    bool open(const std::string &path);
+
+    /**
+     * @brief Formats one frame as a JSON line, without the newline
+     * @param frame type : int frame index
+     * @param timestampMs type : double position in the video
+     * @param tracks type : const std::vector<TrackResult>&
+     * @param line type : std::string& cleared and filled
+     * @return void
+     */
+    static void formatFrame(int frame, double timestampMs,
+    const std::vector<TrackResult> &tracks, std::string &line);
+
+    /**
+     * @brief Writes one frame
+     * @param frame type : int frame index
+     * @param timestampMs type : double position in the video
+     * @param tracks type : const std::vector<TrackResult>&
+     * @return void
+     */
+    void writeFrame(int frame, double timestampMs,
+    const std::vector<TrackResult> &tracks);
+
+    /**
+     * @brief Gets the number of frames written
+     * @param void
+     * @return size_t
+     */
+    size_t getFrameCount();
+
+    /**
+     * @brief Flushes the output and closes it if it was opened here
+     * @param void
+     * @return void
+     */
+    void close();
+
+    /**
+     * @brief Destroy the Result Writer object, closes the output
+     *
+     */
+    ~ResultWriter();
+};
+
+#endif  // INCLUDE_RESULTWRITER_H_
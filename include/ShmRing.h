@@ -0,0 +1,226 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file ShmRing.h
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Source header file for the shared memory ring that hands tracks to other processes.
+ * @version 0.1
+ * @date 2020-12-09
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+
+#ifndef INCLUDE_SHMRING_H_
+#define INCLUDE_SHMRING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ResultWriter.h"
+
+/**
+ * @brief One track of a ring entry, plain data so any process can read it
+ *
+ */
+struct ShmTrack {
+    int32_t id;
+    float confidence;
+    float x, y, width, height;
+    float poseX, poseY;
+};
+
+/**
+ * @brief One frame of tracks. sequence numbers the published frames from 0, timestampNs is
+ *        the steady clock (CLOCK_MONOTONIC) when the entry was published.
+ *
+ */
+struct ShmFrame {
+    static const int kMaxTracks = 64;
+    uint64_t sequence;
+    int64_t timestampNs;
+    int32_t frameIndex;
+    int32_t trackCount;
+    ShmTrack tracks[kMaxTracks];
+};
+
+/**
+ * @brief Start of the shared memory object, followed by the slots
+ *
+ */
+struct ShmRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t slotSize;
+    std::atomic<uint64_t> published;
+};
+
+/**
+ * @brief A slot guarded by a sequence lock. The stamp is odd while the producer writes and
+ *        2 * (sequence + 1) once the entry is complete.
+ *
+ */
+struct ShmSlot {
+    std::atomic<uint64_t> stamp;
+    ShmFrame frame;
+};
+
+/**
+ * @brief Producer side of a lock-free single producer, multi consumer ring in POSIX shared
+ *        memory. publish() never waits for consumers: a slow consumer loses the oldest
+ *        entries instead of holding the producer back.
+ *
+ */
+class ShmRingPublisher
+{
+
+private:
+    /**
+     * @brief Private variables for the shared memory name, the mapping and its size
+     *
+     */
+    std::string name_;
+    void *mapping_ = nullptr;
+    size_t size_ = 0;
+
+    /**
+     * @brief Private variables for the header and the slots inside the mapping
+     *
+     */
+    ShmRingHeader *header_ = nullptr;
+    ShmSlot *slots_ = nullptr;
+
+public:
+    /**
+     * @brief Construct a new Shm Ring Publisher object
+     *
+     */
+    ShmRingPublisher() {}
+
+    ShmRingPublisher(const ShmRingPublisher &) = delete;
+    ShmRingPublisher &operator=(const ShmRingPublisher &) = delete;
+
+    /**
+     * @brief Creates the shared memory object, replacing an older one of the same name
+     * @param name type : const std::string& POSIX shared memory name like /human_tracks
+     * @param capacity type : uint32_t number of slots
+     * @return bool true if the ring is ready
+     */
+    bool create(const std::string &name, uint32_t capacity = 64);
+
+    /**
+     * @brief Publishes the tracks of one frame, tracks beyond ShmFrame::kMaxTracks are dropped
+     * @param frameIndex type : int
+     * @param tracks type : const std::vector<TrackResult>&
+     * @return uint64_t sequence number of the entry
+     */
+    uint64_t publish(int frameIndex, const std::vector<TrackResult> &tracks);
+
+    /**
+     * @brief Unmaps and unlinks the shared memory object
+     * @param void
+     * @return void
+     */
+    void close();
+
+    /**
+     * @brief Destroy the Shm Ring Publisher object, closes the ring
+     *
+     */
+    ~ShmRingPublisher();
+};
+
+/**
+ * @brief Consumer side of the ring. Every reader keeps its own position and maps the ring
+ *        read-only, so any number of processes can read without coordinating.
+ *
+ */
+class ShmRingReader
+{
+
+private:
+    /**
+     * @brief Private variables for the mapping and its size
+     *
+     */
+    const void *mapping_ = nullptr;
+    size_t size_ = 0;
+
+    /**
+     * @brief Private variables for the header and the slots inside the mapping
+     *
+     */
+    const ShmRingHeader *header_ = nullptr;
+    const ShmSlot *slots_ = nullptr;
+
+    /**
+     * @brief Private variables for the next sequence to read and the entries lost to overruns
+     *
+     */
+    uint64_t next_ = 0;
+    uint64_t dropped_ = 0;
+
+    /**
+     * @brief Copies one entry out of its slot
+     * @param sequence type : uint64_t
+     * @param frame type : ShmFrame& filled if the entry is intact
+     * @return bool false if the entry is not published yet or was overwritten meanwhile
+     */
+    bool copyEntry(uint64_t sequence, ShmFrame &frame) const;
+
+public:
+    /**
+     * @brief Construct a new Shm Ring Reader object
+     *
+     */
+    ShmRingReader() {}
+
+    ShmRingReader(const ShmRingReader &) = delete;
+    ShmRingReader &operator=(const ShmRingReader &) = delete;
+
+    /**
+     * @brief Maps a ring and starts reading at its newest entry
+     * @param name type : const std::string&
+     * @return bool false if the ring does not exist or has another layout
+     */
+    bool open(const std::string &name);
+
+    /**
+     * @brief Reads the next entry in order, skipping entries the producer already overwrote
+     * @param frame type : ShmFrame&
+     * @return bool false if no new entry is available
+     */
+    bool tryRead(ShmFrame &frame);
+
+    /**
+     * @brief Reads the newest entry and continues after it
+     * @param frame type : ShmFrame&
+     * @return bool false if nothing was published yet
+     */
+    bool readLatest(ShmFrame &frame);
+
+    /**
+     * @brief Gets the number of entries lost because this reader fell a full ring behind
+     * @param void
+     * @return uint64_t
+     */
+    uint64_t getDropped();
+
+    /**
+     * @brief Unmaps the ring
+     * @param void
+     * @return void
+     */
+    void close();
+
+    /**
+     * @brief Destroy the Shm Ring Reader object, unmaps the ring
+     *
+     */
+    ~ShmRingReader();
+};
+
+#endif  // INCLUDE_SHMRING_H_
@@ -0,0 +1,91 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file ThreadPool.h
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Source header file for the ThreadPool class, a fixed set of reusable worker threads.
+ * @version 0.1
+ * @date 2020-12-01
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+
+#ifndef INCLUDE_THREADPOOL_H_
+#define INCLUDE_THREADPOOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Fixed size pool of worker threads. Threads are created once in the constructor and
+ *        reused by every parallelFor call, so no thread is created per frame.
+ *
+ */
+class ThreadPool
+{
+
+private:
+    /**
+     * @brief Private variable for the worker threads
+     *
+     */
+    std::vector<std::thread> workers_;
+
+    /**
+     * @brief Private variable for the tasks waiting for a worker
+     *
+     */
+    std::deque<std::function<void()>> tasks_;
+
+    /**
+     * @brief Private variable set when the pool is shutting down
+     *
+     */
+    bool stopping_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable hasTask_;
+
+    /**
+     * @brief Runs tasks until the pool shuts down
+     * @param void
+     * @return void
+     */
+    void workerLoop();
+
+public:
+    /**
+     * @brief Construct a new Thread Pool object
+     * @param numThreads type : int number of worker threads, at least 1
+     */
+    explicit ThreadPool(int numThreads);
+
+    /**
+     * @brief Calls body(i) for every i in [0, n) on the workers and the calling thread and
+     *        returns when all calls are done. Several threads may call it at the same time.
+     * @param n type : size_t number of iterations
+     * @param body type : const std::function<void(size_t)>& loop body, must not throw
+     * @return void
+     */
+    void parallelFor(size_t n, const std::function<void(size_t)> &body);
+
+    /**
+     * @brief Gets the number of worker threads
+     * @param void
+     * @return int
+     */
+    int getNumThreads();
+
+    /**
+     * @brief Destroy the Thread Pool object, joins the workers
+     *
+     */
+    ~ThreadPool();
+};
+
+#endif  // INCLUDE_THREADPOOL_H_
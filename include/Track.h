@@ -1,3 +1,6 @@
+#ifndef INCLUDE_TRACK_H_
+#define INCLUDE_TRACK_H_
+
 #include <iostream>
 #include <vector>
 #include <numeric>
@@ -8,9 +11,34 @@
 #include <opencv2/tracking/tracker.hpp>
 
 #include <map>
+#include <memory>
+#include "ThreadPool.h"
+#include "TrackTable.h"
+
+/**
+ * @brief Tracking algorithm used by Track
+ * 
+ */
+enum class TrackerMode {
+    KCF,
+    SORT
+};
+
+/**
+ * @brief Filters of one SORT track, kept at the track's slot of the TrackTable. Center x,
+ *        center y, width and height each have their own constant velocity Kalman filter with
+ *        state (position, velocity).
+ * 
+ */
+struct MotionTrack {
+    float state[4][2] = {};
+    float covariance[4][3] = {};
+    cv::Ptr<cv::Tracker> fallback;
+};
 
 /**
- * @brief 
+ * @brief Tracks detected humans between detection passes, either with OpenCV's KCF multi
+ *        tracker or with a motion-only SORT tracker that keeps stable track IDs.
  * 
  */
 class Track
@@ -18,22 +46,145 @@ class Track
 
 private:
     /**
-     * @brief Private Variable for the multip tracker network
+     * @brief Private Variable for the box, motion, counts, ID and pose of every track
+     * 
+     */
+    TrackTable table_;
+
+    /**
+     * @brief Private Variable for the KCF tracker of every slot in the KCF mode
+     * 
+     */
+    std::vector<cv::Ptr<cv::Tracker>> kcfTrackers_;
+
+    /**
+     * @brief Private Variable for the number of threads updating the per-object trackers
+     * 
+     */
+    int numThreads_ = 1;
+
+    /**
+     * @brief Private Variable for the worker pool, created on first use when numThreads_ > 1
      * 
      */
-    cv::Ptr<cv::MultiTracker> multiTracker;
+    std::shared_ptr<ThreadPool> pool_;
+
+    /**
+     * @brief Runs body(i) for i in [0, n) on the worker pool, or inline with one thread
+     * @param n type : size_t
+     * @param body type : const std::function<void(size_t)>&
+     * @return void
+     */
+    void forEachObject(size_t n, const std::function<void(size_t)> &body);
     /**
      * @brief Private Variable for current frame
      * 
      */
     cv::Mat frame_;
+
+    /**
+     * @brief Private Variable for the tracking algorithm
+     * 
+     */
+    TrackerMode mode_ = TrackerMode::KCF;
+
+    /**
+     * @brief Private Variable for the Kalman filters of every slot in the SORT mode
+     * 
+     */
+    std::vector<MotionTrack> filters_;
+
+    /**
+     * @brief Private Variables reused by every update for the slots followed on appearance,
+     *        their boxes and whether they were found, so updates do not allocate
+     * 
+     */
+    std::vector<int> lostSlots_;
+    std::vector<cv::Rect2d> lostBoxes_;
+    std::vector<char> found_;
+
+    /**
+     * @brief Private Variable for the ID given to the next new track
+     * 
+     */
+    int nextTrackId_ = 1;
+
+    /**
+     * @brief Private Variable for the minimum IoU of a track/detection match
+     * 
+     */
+    float iouThreshold_ = 0.3;
+
+    /**
+     * @brief Private Variable for the detection passes a track may go unmatched before it is dropped
+     * 
+     */
+    int maxMisses_ = 2;
+
+    /**
+     * @brief Private Variable to start a KCF tracker for tracks that lose their match
+     * 
+     */
+    bool appearanceFallback_ = true;
+
+    /**
+     * @brief Private Variable for the number of tracks lost on the last update
+     * 
+     */
+    int lostCount_ = 0;
+
+    /**
+     * @brief Private Variables for the fraction of a detection's width and height that is
+     *        tracked, and for the fractions cut at its left and top
+     * 
+     */
+    double shrinkWidth_ = 0.8;
+    double shrinkHeight_ = 0.8;
+    double cutLeft_ = 0.1;
+    double cutTop_ = 0.06;
+
+    /**
+     * @brief Starts a SORT track at a detection
+     * @param box type : const cv::Rect2d&
+     * @return void
+     */
+    void createTrack(const cv::Rect2d &box);
+
+    /**
+     * @brief Ends the track in a slot
+     * @param slot type : int
+     * @return void
+     */
+    void endTrack(int slot);
+
+    /**
+     * @brief Advances the Kalman filters of a track by one frame
+     * @param slot type : int
+     * @return void
+     */
+    void predictTrack(int slot);
+
+    /**
+     * @brief Corrects the Kalman filters of a track with a measured box
+     * @param slot type : int
+     * @param box type : const cv::Rect2d&
+     * @return void
+     */
+    void correctTrack(int slot, const cv::Rect2d &box);
+
     /**
-     * @brief Gets the Poses from the bounding boxes in the UAV's Camera Frame.
-     * @param coordinates type : std::vector<float>
-     * @return std::vector<float> Retruns the coordinates for bounding boxes in the frame
+     * @brief Copies the box and velocity of the filters of a track into the table
+     * @param slot type : int
+     * @return void
      */
+    void storeTrack(int slot);
 
-    std::vector<float> getCoordinatesInCameraFrame(std::vector<float> coordinates);
+    /**
+     * @brief Gets the current box of a SORT track
+     * @param track type : const MotionTrack&
+     * @return cv::Rect2d
+     */
+    cv::Rect2d trackBox(const MotionTrack &track);
 
 public:
     /**
@@ -43,11 +194,11 @@ public:
     Track();
     /**
      * @brief Sets current frame
-     * @param frame type : cv::Mat
+     * @param frame type : const cv::Mat& shares the buffer, tracks are drawn on it
      * @return void
      */
 
-    void setFrame(cv::Mat frame);
+    void setFrame(const cv::Mat &frame);
     /**
      * @brief Initializes the tracker
      * @param void
@@ -79,9 +230,98 @@ public:
      * @return cv::Mat return frame with tracking bounding box
      */
     cv::Mat drawGreenBoundingBox();
+
+    /**
+     * @brief Selects the tracking algorithm. Changing the mode ends all tracks right away,
+     *        like initializeTracker, and IDs start from 1 again.
+     * @param mode type : TrackerMode
+     * @return void
+     */
+    void setTrackerMode(TrackerMode mode);
+
+    /**
+     * @brief Sets the number of threads that update the per-object trackers. Results do not
+     *        depend on it. Use fewer threads to leave cores for inference.
+     * @param numThreads type : int at least 1, 1 updates inline on the calling thread
+     * @return void
+     */
+    void setNumThreads(int numThreads);
+
+    /**
+     * @brief Enables KCF as an appearance fallback for SORT tracks that lose their match
+     * @param enabled type : bool
+     * @return void
+     */
+    void setAppearanceFallback(bool enabled);
+
+    /**
+     * @brief Sets how much of a detection resizeBoxes keeps. The box stays centered across and
+     *        loses 30 percent of the cut height at the top, the head and shoulders line.
+     * @param width type : double fraction of the width kept, 0.8 by default
+     * @param height type : double fraction of the height kept, 0.8 by default
+     * @return void
+     */
+    void setBoxShrink(double width, double height);
+
+    /**
+     * @brief Gets the boxes of all current tracks
+     * @param void
+     * @return std::vector<cv::Rect2d>
+     */
+    std::vector<cv::Rect2d> getTrackedBoxes();
+
+    /**
+     * @brief Gets the IDs of all current tracks, in the order of getTrackedBoxes. SORT IDs stay
+     *        the same across detection passes, KCF IDs are the position in the last detection pass.
+     * @param void
+     * @return std::vector<int>
+     */
+    std::vector<int> getTrackIds();
+
+    /**
+     * @brief Gets the pose in the camera frame of all current tracks, in the order of
+     *        getTrackedBoxes, without drawing anything
+     * @param void
+     * @return std::vector<cv::Point2f>
+     */
+    std::vector<cv::Point2f> getTrackedPoses();
+
+    /**
+     * @brief Gets the table of the current tracks. Its view reads boxes, velocities, ages, hit
+     *        and miss counts, IDs and poses in place, in the order of getTrackedBoxes.
+     * @param void
+     * @return const TrackTable& valid until the tracker runs again
+     */
+    const TrackTable &getTrackTable();
+
+    /**
+     * @brief Gets the number of tracks lost on the last update. A KCF tracker is lost when its
+     *        update fails, a SORT track when it went unmatched and has no appearance tracker.
+     * @param void
+     * @return int
+     */
+    int getLostCount();
+
+    /**
+     * @brief Intersection over union of two boxes
+     * @param a type : const cv::Rect2d&
+     * @param b type : const cv::Rect2d&
+     * @return double in [0, 1]
+     */
+    static double iou(const cv::Rect2d &a, const cv::Rect2d &b);
+
+    /**
+     * @brief Solves the rectangular assignment problem with the Hungarian algorithm
+     * @param cost type : const std::vector<std::vector<double>>& rows x cols cost matrix
+     * @return std::vector<int> - column assigned to every row, -1 if the row is unassigned
+     */
+    static std::vector<int> solveAssignment(
+    const std::vector<std::vector<double>> &cost);
     /**
      * @brief Destroy the Track object
      * 
      */
     ~Track() {}
 };
+
+#endif  // INCLUDE_TRACK_H_
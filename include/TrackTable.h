@@ -0,0 +1,229 @@
+/**
+ * Copyright 2020 Sneha Nayak, Sukoon Sarin
+ * @file TrackTable.h
+ * @author Sneha Nayak (snehanyk@umd.edu)
+ * @author Sukoon Sarin (sukoon@umd.edu)
+ * @brief Source header file for the table of tracked persons
+ * @version 0.1
+ * @date 2020-12-14
+ *
+ * @copyright Copyright (c) 2020 Sneha Nayak, Sukoon Sarin
+ *
+ */
+
+#ifndef INCLUDE_TRACKTABLE_H_
+#define INCLUDE_TRACKTABLE_H_
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+/**
+ * @brief Read only view of the live tracks. Every column is indexed by slot, slots lists the
+ *        slots of the live tracks in the order they were started. The pointers stay valid until
+ *        the tracker runs again.
+ *
+ */
+struct TrackView {
+    const int *slots = nullptr;
+    size_t count = 0;
+    // Box of every slot, top left corner and size in pixels
+    const float *x = nullptr;
+    const float *y = nullptr;
+    const float *width = nullptr;
+    const float *height = nullptr;
+    // Motion of the box center, in pixels per frame
+    const float *velocityX = nullptr;
+    const float *velocityY = nullptr;
+    // Frames since the track started, matches and passes or updates missed in a row
+    const int *age = nullptr;
+    const int *hits = nullptr;
+    const int *misses = nullptr;
+    const int *id = nullptr;
+    // Pose in the camera frame
+    const float *poseX = nullptr;
+    const float *poseY = nullptr;
+};
+
+/**
+ * @brief Structure of arrays holding the state of every track. A track keeps its slot while it
+ *        lives, and the slots of ended tracks are reused through a free list, so the table only
+ *        allocates when the number of tracks grows past its capacity.
+ *
+ */
+class TrackTable
+{
+
+private:
+    /**
+     * @brief Private variables for the box of every slot
+     *
+     */
+    std::vector<float> x_, y_, width_, height_;
+
+    /**
+     * @brief Private variables for the velocity of the box center of every slot
+     *
+     */
+    std::vector<float> velocityX_, velocityY_;
+
+    /**
+     * @brief Private variables for the age, hit and miss counts and ID of every slot
+     *
+     */
+    std::vector<int> age_, hits_, misses_, id_;
+
+    /**
+     * @brief Private variables for the pose in the camera frame of every slot
+     *
+     */
+    std::vector<float> poseX_, poseY_;
+
+    /**
+     * @brief Private variable for the slots of the live tracks, oldest track first
+     *
+     */
+    std::vector<int> slots_;
+
+    /**
+     * @brief Private variable for the slots of ended tracks, the last one is reused first
+     *
+     */
+    std::vector<int> free_;
+
+public:
+    /**
+     * @brief Construct a new TrackTable object with room for a crowded frame
+     *
+     */
+    TrackTable();
+
+    /**
+     * @brief Makes room for a number of tracks
+     * @param capacity type : size_t
+     * @return void
+     */
+    void reserve(size_t capacity);
+
+    /**
+     * @brief Ends all tracks. Keeps the storage, the next tracks take slots from 0 on.
+     * @param void
+     * @return void
+     */
+    void clear();
+
+    /**
+     * @brief Starts a track with zero age, hits, misses and velocity
+     * @param id type : int
+     * @return int slot of the track
+     */
+    int acquire(int id);
+
+    /**
+     * @brief Ends the track in a slot and frees the slot
+     * @param slot type : int
+     * @return void
+     */
+    void release(int slot);
+
+    /**
+     * @brief Sets the box of a slot and its pose in the camera frame
+     * @param slot type : int
+     * @param box type : const cv::Rect2d&
+     * @return void
+     */
+    void setBox(int slot, const cv::Rect2d &box);
+
+    /**
+     * @brief Sets the velocity of the box center of a slot
+     * @param slot type : int
+     * @param velocityX type : float pixels per frame
+     * @param velocityY type : float pixels per frame
+     * @return void
+     */
+    void setVelocity(int slot, float velocityX, float velocityY);
+
+    /**
+     * @brief Counts a match of a slot and clears its misses
+     * @param slot type : int
+     * @return void
+     */
+    void addHit(int slot);
+
+    /**
+     * @brief Counts a miss of a slot
+     * @param slot type : int
+     * @return void
+     */
+    void addMiss(int slot);
+
+    /**
+     * @brief Ages a slot by one frame
+     * @param slot type : int
+     * @return void
+     */
+    void addAge(int slot);
+
+    /**
+     * @brief Gets the box of a slot
+     * @param slot type : int
+     * @return cv::Rect2d
+     */
+    cv::Rect2d getBox(int slot) const;
+
+    /**
+     * @brief Gets the ID of a slot
+     * @param slot type : int
+     * @return int
+     */
+    int getId(int slot) const;
+
+    /**
+     * @brief Gets the misses in a row of a slot
+     * @param slot type : int
+     * @return int
+     */
+    int getMisses(int slot) const;
+
+    /**
+     * @brief Gets the slot of a live track
+     * @param id type : int
+     * @return int -1 if no live track has the ID
+     */
+    int findSlot(int id) const;
+
+    /**
+     * @brief Gets the slots of the live tracks, oldest track first
+     * @param void
+     * @return const std::vector<int>&
+     */
+    const std::vector<int> &getSlots() const;
+
+    /**
+     * @brief Gets the number of live tracks
+     * @param void
+     * @return size_t
+     */
+    size_t size() const;
+
+    /**
+     * @brief Gets the number of tracks the table holds without allocating
+     * @param void
+     * @return size_t
+     */
+    size_t capacity() const;
+
+    /**
+     * @brief Gets a view of the live tracks that reads the columns in place
+     * @param void
+     * @return TrackView
+     */
+    TrackView view() const;
+
+    /**
+     * @brief Destroy the TrackTable object
+     *
+     */
+    ~TrackTable() {}
+};
+
+#endif  // INCLUDE_TRACKTABLE_H_
@@ -12,8 +12,15 @@
  * 
  */
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <map>
+#include <numeric>
+#include <thread>
 #include <vector>
 #include <opencv2/opencv.hpp>
 #include <opencv2/core/core.hpp>
@@ -22,6 +29,23 @@
 #include "../include/DataLoader.h"
 #include "../include/Detection.h"
 #include "../include/Track.h"
+#include "../include/TrackTable.h"
+#include "../include/BoundedQueue.h"
+#include "../include/Pipeline.h"
+#include "../include/InferenceScheduler.h"
+#include "../include/DetectionPolicy.h"
+#include "../include/FramePool.h"
+#include "../include/MotionGate.h"
+#include "../include/Preprocessor.h"
+#include "../include/ModelProfile.h"
+#include "../include/ModelBundle.h"
+#include "../include/OfflineProcessor.h"
+#include "../include/ImageBatchProcessor.h"
+#include "../include/ResultWriter.h"
+#include "../include/ShmRing.h"
+#include "../include/Profiler.h"
+#include "../include/Evaluation.h"
+#include "../include/Nms.h"
 
 
 // keys It is used for showing parsing examples.
@@ -104,6 +128,22 @@ TEST(DetectionTest, checkModelFiles) {
         dummyweightfile, dummyconfigfile);
     });
 }
+/**
+ * @brief Test case for a failed model load. The detector reports the missing model and returns no detections.
+ */
+TEST(DetectionTest, checkMissingModel) {
+    Detection detection3;
+    detection3.loadModelandLabelClasses("missing.weights",
+    "missing.cfg", "../coco.names");
+    EXPECT_FALSE(detection3.isModelLoaded());
+    detection3.setFrame(cv::Mat::zeros(416, 416, CV_8UC3));
+    EXPECT_TRUE(detection3.processFrameforHuman().empty());
+    EXPECT_NO_FATAL_FAILURE({
+        detection3.warmUp();
+    });
+    EXPECT_EQ(detection3.getWarmUpTime(), 0);
+}
+
 /**
  * @brief Test Case for Initializing Confidence and non maximum suppression threshold along with width and height of the image
  */
@@ -160,6 +200,134 @@ TEST(DetectionTest, Processconfidence) {
     EXPECT_EQ(getconf1, getconf2);
 }
 
+/**
+ * @brief Test case for processBatch. Frames of different sizes get their own result vectors, and
+ * identical frames in one batch get identical detections.
+ */
+TEST(DetectionTest, ProcessBatch) {
+    cv::Mat frame = cv::imread("../person.jpg");
+    cv::Mat small;
+    cv::resize(frame, small, cv::Size(frame.cols / 2, frame.rows / 2));
+    Detection detection4;
+    detection4.setBatchSize(2);
+    EXPECT_EQ(detection4.getBatchSize(), 2);
+    std::vector<cv::Mat> frames = {frame.clone(), small, frame.clone()};
+    std::vector<std::vector<cv::Rect>> batchDetections;
+    std::vector<std::vector<float>> batchConfidences;
+    detection4.processBatch(frames, batchDetections, batchConfidences);
+    ASSERT_EQ(batchDetections.size(), frames.size());
+    ASSERT_EQ(batchConfidences.size(), frames.size());
+    for (size_t i = 0; i < frames.size(); ++i)
+        EXPECT_EQ(batchDetections[i].size(), batchConfidences[i].size());
+    EXPECT_EQ(batchDetections[0], batchDetections[2]);
+}
+
+/**
+ * @brief Test case for the person-only decoder. It accepts exactly the rows whose best class is person.
+ */
+TEST(DetectionTest, PersonOnlyDecoding) {
+    cv::Mat out = cv::Mat::zeros(37, 85, CV_32F);
+    // Person rows, a row won by another class and a row below threshold
+    out.at<float>(3, 5) = 0.9f;
+    out.at<float>(20, 5) = 0.7f;
+    out.at<float>(36, 5) = 0.8f;
+    out.at<float>(11, 5) = 0.6f;
+    out.at<float>(11, 7) = 0.9f;
+    out.at<float>(30, 5) = 0.2f;
+    for (int j = 0; j < out.rows; ++j) {
+        out.at<float>(j, 0) = 0.5f;
+        out.at<float>(j, 1) = 0.5f;
+        out.at<float>(j, 2) = 0.1f;
+        out.at<float>(j, 3) = 0.2f;
+    }
+    std::vector<cv::Rect> personBoxes, allBoxes;
+    std::vector<float> personConf, allConf;
+    std::vector<int> ids;
+    Detection::decodePersonRows(out, 0, 0.5f, cv::Size(640, 480),
+    personBoxes, personConf);
+    Detection::decodeAllClassRows(out, 0.5f, cv::Size(640, 480), ids,
+    allBoxes, allConf);
+    std::vector<float> expected = {0.9f, 0.7f, 0.8f};
+    EXPECT_EQ(personConf, expected);
+    ASSERT_EQ(ids.size(), 4u);
+    EXPECT_EQ(ids[1], 2);
+    EXPECT_EQ(personBoxes[0], allBoxes[0]);
+}
+
+/**
+ * @brief Test case for the regions of interest. Nearby tracks share one square region, distant
+ * tracks get their own, and every region lies inside the frame and holds its tracks.
+ */
+TEST(DetectionTest, RegionsOfInterest) {
+    cv::Size frameSize(1280, 720);
+    std::vector<cv::Rect2d> tracked = {cv::Rect2d(100, 100, 20, 40),
+    cv::Rect2d(140, 110, 20, 40), cv::Rect2d(1000, 600, 30, 60),
+    cv::Rect2d(0, 0, 0, 0)};
+    std::vector<cv::Rect> regions = Detection::regionsOfInterest(tracked,
+    frameSize, 0.5);
+    ASSERT_EQ(regions.size(), 2u);
+    cv::Rect frame(cv::Point(0, 0), frameSize);
+    for (size_t i = 0; i < regions.size(); ++i) {
+        EXPECT_EQ(regions[i].width, regions[i].height);
+        EXPECT_EQ(regions[i] & frame, regions[i]);
+        for (size_t j = i + 1; j < regions.size(); ++j)
+            EXPECT_EQ((regions[i] & regions[j]).area(), 0);
+    }
+    for (size_t k = 0; k < 3; ++k) {
+        cv::Rect box(tracked[k]);
+        EXPECT_TRUE((box & regions[0]) == box || (box & regions[1]) == box);
+    }
+}
+
+/**
+ * @brief Test case for processRegions. Detections come back in full-frame coordinates.
+ */
+TEST(DetectionTest, ProcessRegions) {
+    cv::Mat frame = cv::imread("../person.jpg");
+    Detection detection5;
+    detection5.setFrame(frame);
+    cv::Rect region(frame.cols / 4, frame.rows / 4, 200, 200);
+    region &= cv::Rect(0, 0, frame.cols, frame.rows);
+    std::vector<cv::Rect> boxes = detection5.processRegions({region});
+    for (const auto &box : boxes)
+        EXPECT_GT((box & region).area(), 0);
+    EXPECT_TRUE(detection5.processRegions({}).empty());
+}
+
+/**
+ * @brief Test case for the tile grid. Tiles have the full size, stay inside the frame and cover it.
+ */
+TEST(DetectionTest, TileGrid) {
+    std::vector<cv::Rect> tiles = Detection::tileGrid(cv::Size(1000, 600),
+    416, 0.25);
+    ASSERT_EQ(tiles.size(), 6u);
+    cv::Mat covered = cv::Mat::zeros(600, 1000, CV_8U);
+    for (const auto &tile : tiles) {
+        EXPECT_EQ(tile.size(), cv::Size(416, 416));
+        EXPECT_EQ(tile & cv::Rect(0, 0, 1000, 600), tile);
+        covered(tile).setTo(1);
+    }
+    EXPECT_EQ(cv::countNonZero(covered), 600 * 1000);
+    EXPECT_EQ(Detection::tileGrid(cv::Size(320, 240), 416, 0.25).size(), 1u);
+}
+
+/**
+ * @brief Test case for processTiles. An unchanged frame reuses the detections of every tile.
+ */
+TEST(DetectionTest, ProcessTiles) {
+    cv::Mat frame = cv::imread("../person.jpg");
+    Detection detection6;
+    detection6.setTiling(320, 0.2);
+    detection6.setFrame(frame.clone());
+    std::vector<cv::Rect> first = detection6.processTiles();
+    size_t tiles = detection6.getTilesRun();
+    detection6.setFrame(frame.clone());
+    std::vector<cv::Rect> second = detection6.processTiles();
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(detection6.getTilesRun(), tiles);
+    EXPECT_EQ(detection6.getTilesSkipped(), tiles);
+}
+
 /**
  * @brief Test case for setFrame method of Track class. 
  */
@@ -178,3 +346,930 @@ TEST(TrackerTest, Initializetracker) {
         dummytrack.initializeTracker();
     });
 }
+
+/**
+ * @brief Test case for the Hungarian solver. The cheapest pairing is found on a rectangular matrix.
+ */
+TEST(TrackerTest, SolveAssignment) {
+    std::vector<std::vector<double>> cost = {{4, 1, 3}, {2, 0, 5}};
+    std::vector<int> assignment = Track::solveAssignment(cost);
+    std::vector<int> expected = {1, 0};
+    EXPECT_EQ(assignment, expected);
+    std::vector<std::vector<double>> tall = {{1}, {0}, {2}};
+    expected = {-1, 0, -1};
+    EXPECT_EQ(Track::solveAssignment(tall), expected);
+    EXPECT_DOUBLE_EQ(Track::iou(cv::Rect2d(0, 0, 10, 10),
+    cv::Rect2d(5, 0, 10, 10)), 50.0 / 150.0);
+}
+
+/**
+ * @brief Builds a YOLO output with one person row per box, in the coordinates of a frame of
+ *        the given size
+ */
+std::vector<cv::Mat> personOutputs(const std::vector<cv::Rect> &boxes,
+const std::vector<float> &scores, cv::Size frameSize) {
+    cv::Mat out(static_cast<int>(boxes.size()), 85, CV_32F, cv::Scalar(0));
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        float *row = out.ptr<float>(static_cast<int>(i));
+        row[0] = (boxes[i].x + boxes[i].width / 2.f) / frameSize.width;
+        row[1] = (boxes[i].y + boxes[i].height / 2.f) / frameSize.height;
+        row[2] = static_cast<float>(boxes[i].width) / frameSize.width;
+        row[3] = static_cast<float>(boxes[i].height) / frameSize.height;
+        row[4] = row[5] = scores[i];
+    }
+    return {out};
+}
+
+/**
+ * @brief Test case for the SORT mode fed by the detector. The overlapping candidates YOLO
+ *        gives for one person start one track, on every detection pass.
+ */
+TEST(TrackerTest, SortMergesOverlappingCandidates) {
+    Detection detection10;
+    detection10.loadModelandLabelClasses("missing.weights", "missing.cfg",
+    "../coco.names");
+    detection10.initializeParams(0.5, 0.4, 416, 416);
+    detection10.setDrawBoxes(false);
+    cv::Mat frame = cv::Mat::zeros(512, 512, CV_8UC3);
+    detection10.setFrame(frame);
+    Track sortTrack;
+    sortTrack.setTrackerMode(TrackerMode::SORT);
+    sortTrack.setAppearanceFallback(false);
+    sortTrack.initializeTracker();
+    sortTrack.setFrame(frame);
+    for (int pass = 0; pass < 3; ++pass) {
+        int shift = 4 * pass;
+        sortTrack.runTrackerAlgorithm(detection10.processOutputs(
+        personOutputs({cv::Rect(100 + shift, 100, 80, 200),
+        cv::Rect(106 + shift, 96, 84, 204)}, {0.9f, 0.8f}, frame.size())));
+        EXPECT_EQ(sortTrack.getTrackIds(), std::vector<int>({1}));
+    }
+}
+
+/**
+ * @brief Test case for the SORT mode. Track IDs survive a detection pass with moved boxes.
+ */
+TEST(TrackerTest, SortKeepsIds) {
+    Track sortTrack;
+    sortTrack.setTrackerMode(TrackerMode::SORT);
+    sortTrack.setAppearanceFallback(false);
+    sortTrack.initializeTracker();
+    sortTrack.setFrame(cv::Mat::zeros(480, 640, CV_8UC3));
+    sortTrack.runTrackerAlgorithm({cv::Rect(100, 100, 50, 100),
+    cv::Rect(400, 200, 60, 120)});
+    for (int i = 0; i < 5; ++i)
+        sortTrack.updateTracker();
+    sortTrack.runTrackerAlgorithm({cv::Rect(405, 205, 60, 120),
+    cv::Rect(104, 102, 50, 100), cv::Rect(10, 10, 40, 80)});
+    std::vector<int> ids = sortTrack.getTrackIds();
+    std::vector<int> expected = {1, 2, 3};
+    EXPECT_EQ(ids, expected);
+    EXPECT_EQ(sortTrack.getTrackedBoxes().size(), 3u);
+}
+
+/**
+ * @brief Test case for TrackTable. Ended tracks give their slot to the next track, live tracks
+ *        keep their slot and ID, and the view reads the columns in track order. A mode switch
+ *        ends all tracks.
+ */
+TEST(TrackerTest, TrackTableReusesSlots) {
+    TrackTable table;
+    size_t capacity = table.capacity();
+    int first = table.acquire(1);
+    int second = table.acquire(2);
+    int third = table.acquire(3);
+    table.setBox(second, cv::Rect2d(10, 20, 30, 40));
+    table.release(first);
+    EXPECT_EQ(table.acquire(4), first);
+    EXPECT_EQ(table.findSlot(2), second);
+    EXPECT_EQ(table.findSlot(1), -1);
+    TrackView view = table.view();
+    ASSERT_EQ(view.count, 3u);
+    std::vector<int> ids;
+    for (size_t i = 0; i < view.count; ++i)
+        ids.push_back(view.id[view.slots[i]]);
+    std::vector<int> expected = {2, 3, 4};
+    EXPECT_EQ(ids, expected);
+    EXPECT_FLOAT_EQ(view.poseX[second], 25);
+    EXPECT_FLOAT_EQ(view.poseY[second], 40);
+    EXPECT_EQ(table.getBox(third), cv::Rect2d());
+    table.clear();
+    for (size_t i = 0; i < capacity; ++i)
+        table.acquire(static_cast<int>(i));
+    EXPECT_EQ(table.capacity(), capacity);
+
+    Track sortTrack;
+    sortTrack.setTrackerMode(TrackerMode::SORT);
+    sortTrack.setAppearanceFallback(false);
+    sortTrack.initializeTracker();
+    sortTrack.setFrame(cv::Mat::zeros(480, 640, CV_8UC3));
+    sortTrack.runTrackerAlgorithm({cv::Rect(100, 100, 50, 100),
+    cv::Rect(400, 200, 60, 120)});
+    for (int i = 0; i < 3; ++i)
+        sortTrack.runTrackerAlgorithm({cv::Rect(400, 200, 60, 120)});
+    sortTrack.runTrackerAlgorithm({cv::Rect(400, 200, 60, 120),
+    cv::Rect(50, 300, 40, 80)});
+    const TrackTable &tracks = sortTrack.getTrackTable();
+    EXPECT_EQ(sortTrack.getTrackIds(), std::vector<int>({2, 3}));
+    EXPECT_EQ(tracks.findSlot(3), 0);
+    EXPECT_EQ(tracks.view().hits[tracks.findSlot(2)], 5);
+    // Switching the mode ends the tracks at once
+    sortTrack.setTrackerMode(TrackerMode::KCF);
+    EXPECT_EQ(tracks.size(), 0u);
+}
+
+/**
+ * @brief Test case for ThreadPool. Every iteration runs exactly once.
+ */
+TEST(TrackerTest, ThreadPoolParallelFor) {
+    ThreadPool pool(3);
+    std::vector<int> counts(100, 0);
+    pool.parallelFor(counts.size(), [&](size_t i) {
+        counts[i]++;
+    });
+    EXPECT_EQ(std::accumulate(counts.begin(), counts.end(), 0), 100);
+    EXPECT_EQ(*std::max_element(counts.begin(), counts.end()), 1);
+}
+
+/**
+ * @brief Test case for parallel KCF updates. The tracked boxes do not depend on the thread count.
+ */
+TEST(TrackerTest, ParallelUpdateIsDeterministic) {
+    cv::Mat frame = cv::imread("../person.jpg");
+    std::vector<cv::Rect> boxes = {cv::Rect(20, 20, 60, 120),
+    cv::Rect(150, 40, 60, 120), cv::Rect(60, 100, 50, 100)};
+    std::vector<std::vector<cv::Rect2d>> results;
+    for (int threads : {1, 4}) {
+        Track parallelTrack;
+        parallelTrack.setNumThreads(threads);
+        parallelTrack.initializeTracker();
+        parallelTrack.setFrame(frame);
+        parallelTrack.runTrackerAlgorithm(boxes);
+        for (int i = 0; i < 3; ++i)
+            parallelTrack.updateTracker();
+        results.push_back(parallelTrack.getTrackedBoxes());
+    }
+    EXPECT_EQ(results[0], results[1]);
+}
+
+/**
+ * @brief Test case for BoundedQueue. Items come out in order and a closed queue drains before pop fails.
+ */
+TEST(PipelineTest, BoundedQueueOrder) {
+    BoundedQueue<int> queue(4);
+    for (int i = 0; i < 4; ++i)
+        EXPECT_TRUE(queue.push(i));
+    queue.close();
+    EXPECT_FALSE(queue.push(4));
+    int item = -1;
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(queue.pop(item));
+        EXPECT_EQ(item, i);
+    }
+    EXPECT_FALSE(queue.pop(item));
+    EXPECT_EQ(queue.getMaxDepth(), 4u);
+}
+
+/**
+ * @brief Writes an image sequence whose frames are filled with four times their index
+ * @param directory type : const std::string&
+ * @param count type : int
+ * @return std::string pattern that opens the sequence as a video
+ */
+std::string numberedFrames(const std::string &directory, int count) {
+    std::filesystem::create_directory(directory);
+    for (int i = 0; i < count; ++i)
+        cv::imwrite(cv::format("%s/frame_%03d.png", directory.c_str(), i),
+        cv::Mat(48, 64, CV_8UC3, cv::Scalar::all(4 * i)));
+    return directory + "/frame_%03d.png";
+}
+
+/**
+ * @brief Test case for the staged pipeline. Every decoded frame reaches the sink exactly once
+ *        and in order.
+ */
+TEST(PipelineTest, RunVideo) {
+    const int count = 40;
+    cv::VideoCapture capture(numberedFrames("pipeline_test_frames", count));
+    ASSERT_TRUE(capture.isOpened());
+    // Without a model the detector finds nobody, so nothing is drawn
+    Detection detection13;
+    detection13.loadModelandLabelClasses("missing.weights", "missing.cfg",
+    "../coco.names");
+    Track pipelineTrack;
+    Pipeline pipeline(detection13, pipelineTrack, 8);
+    pipeline.setDetectionInterval(5);
+    std::vector<int> written;
+    int processed = pipeline.run(capture, [&](const cv::Mat &frame) {
+        written.push_back(frame.at<cv::Vec3b>(0, 0)[0] / 4);
+    });
+    EXPECT_EQ(processed, count);
+    std::vector<int> expected(count);
+    std::iota(expected.begin(), expected.end(), 0);
+    EXPECT_EQ(written, expected);
+    std::vector<StageStats> stats = pipeline.getStageStats();
+    ASSERT_EQ(stats.size(), 4u);
+    EXPECT_EQ(stats[0].frames, stats[2].frames);
+    EXPECT_EQ(stats[2].frames, stats[3].frames);
+    EXPECT_EQ(stats[1].frames, static_cast<size_t>(count / 5));
+    for (const auto &queue : pipeline.getQueueStats())
+        EXPECT_LE(queue.maxDepth, queue.capacity);
+    std::filesystem::remove_all("pipeline_test_frames");
+}
+
+/**
+ * @brief Test case for LatestSlot. A put replaces an untaken item so only the newest is seen.
+ */
+TEST(PipelineTest, LatestSlotKeepsNewest) {
+    LatestSlot<int> slot;
+    EXPECT_FALSE(slot.put(1));
+    EXPECT_TRUE(slot.put(2));
+    int item = 0;
+    EXPECT_TRUE(slot.tryTake(item));
+    EXPECT_EQ(item, 2);
+    EXPECT_FALSE(slot.tryTake(item));
+    slot.close();
+    EXPECT_FALSE(slot.take(item));
+}
+
+/**
+ * @brief Test case for the real-time mode. Every captured frame is either processed, dropped or
+ *        stale, and the processed frames reach the sink in capture order.
+ */
+TEST(PipelineTest, RunRealtime) {
+    const int count = 40;
+    cv::VideoCapture capture(numberedFrames("realtime_test_frames", count));
+    ASSERT_TRUE(capture.isOpened());
+    Detection detection14;
+    detection14.loadModelandLabelClasses("missing.weights", "missing.cfg",
+    "../coco.names");
+    Track realtimeTrack;
+    Pipeline pipeline(detection14, realtimeTrack);
+    std::vector<int> written;
+    int processed = pipeline.runRealtime(capture, [&](const cv::Mat &frame) {
+        written.push_back(frame.at<cv::Vec3b>(0, 0)[0] / 4);
+    }, 200);
+    RealtimeStats stats = pipeline.getRealtimeStats();
+    EXPECT_EQ(static_cast<size_t>(processed), stats.processed);
+    EXPECT_EQ(written.size(), stats.processed);
+    EXPECT_EQ(stats.captured, static_cast<size_t>(count));
+    EXPECT_EQ(stats.captured, stats.processed + stats.dropped + stats.stale);
+    EXPECT_TRUE(std::is_sorted(written.begin(), written.end()));
+    EXPECT_EQ(std::adjacent_find(written.begin(), written.end()),
+    written.end());
+    for (int index : written) {
+        EXPECT_GE(index, 0);
+        EXPECT_LT(index, count);
+    }
+    std::filesystem::remove_all("realtime_test_frames");
+}
+
+/**
+ * @brief Test case for InferenceScheduler. Requests of several streams all complete and are batched.
+ */
+TEST(SchedulerTest, ServesAllStreams) {
+    Detection detection5;
+    detection5.loadModelandLabelClasses("missing.weights", "missing.cfg",
+    "../coco.names");
+    InferenceScheduler scheduler(detection5, 3);
+    std::vector<std::future<InferenceResult>> results;
+    for (int i = 0; i < 6; ++i)
+        results.push_back(scheduler.submit(i % 3,
+        cv::Mat::zeros(120, 160, CV_8UC3)));
+    for (auto &result : results)
+        EXPECT_TRUE(result.get().detections.empty());
+    scheduler.stop();
+    EXPECT_EQ(scheduler.getFrameCount(), 6u);
+    EXPECT_LE(scheduler.getBatchCount(), 6u);
+}
+
+/**
+ * @brief Test case for the per-stream counters. A missing stream is reported without frames.
+ */
+TEST(SchedulerTest, MissingStream) {
+    InferenceScheduler scheduler(DataLoader::sharedDetection(), 1);
+    DataLoader loader("missing.mp4", "video");
+    EXPECT_NO_THROW({
+        loader.processStream(scheduler, 0);
+    });
+    EXPECT_EQ(loader.getStreamStats().frames, 0u);
+}
+
+/**
+ * @brief Test case for the detection policy. A still empty scene only needs the maximum interval,
+ *        a lost track or motion in an empty scene trigger detection after the minimum interval.
+ */
+TEST(PolicyTest, AdaptiveCadence) {
+    DetectionPolicy policy;
+    policy.setIntervals(5, 90, 45);
+    cv::Mat still(120, 160, CV_8UC3, cv::Scalar(40, 40, 40));
+    int triggered = 0;
+    for (int i = 0; i < 200; ++i)
+        triggered += policy.shouldDetect(still, 0, 0);
+    EXPECT_EQ(triggered, 3);
+    EXPECT_EQ(policy.getStats().fixedCadence, 4u);
+
+    EXPECT_TRUE(policy.shouldDetect(still, 2, 1));
+    for (int i = 0; i < 4; ++i)
+        EXPECT_FALSE(policy.shouldDetect(still, 2, 1));
+    EXPECT_TRUE(policy.shouldDetect(still, 2, 1));
+    EXPECT_EQ(policy.getLastReason(), DetectionReason::TRACKER_FAILURE);
+
+    cv::Mat bright(120, 160, CV_8UC3, cv::Scalar(200, 200, 200));
+    for (int i = 0; i < 4; ++i)
+        policy.shouldDetect(i % 2 ? still : bright, 0, 0);
+    EXPECT_TRUE(policy.shouldDetect(bright, 0, 0));
+    EXPECT_EQ(policy.getLastReason(), DetectionReason::EMPTY_SCENE_MOTION);
+}
+
+/**
+ * @brief Test case for the CPU budget. Slow detections hold back triggers up to the maximum interval.
+ */
+TEST(PolicyTest, CpuBudget) {
+    DetectionPolicy policy;
+    policy.setIntervals(5, 20, 45);
+    policy.setCpuBudget(0.1);
+    cv::Mat frame(120, 160, CV_8UC3, cv::Scalar(40, 40, 40));
+    EXPECT_TRUE(policy.shouldDetect(frame, 0, 0));
+    policy.recordDetection(1000);
+    int triggered = 0;
+    for (int i = 0; i < 19; ++i)
+        triggered += policy.shouldDetect(frame, 1, 1);
+    EXPECT_EQ(triggered, 0);
+    EXPECT_GT(policy.getStats().cpuLimited, 0u);
+    EXPECT_TRUE(policy.shouldDetect(frame, 1, 1));
+    EXPECT_EQ(policy.getLastReason(), DetectionReason::MAX_INTERVAL);
+}
+
+/**
+ * @brief Test case for the motion gate. A still frame changes nothing, a moving person changes
+ *        the blocks it covers, and a camera pan is compensated instead of marking every block.
+ */
+TEST(GateTest, ChangeMask) {
+    MotionGate gate;
+    cv::Mat background(240, 320, CV_8UC3, cv::Scalar(50, 50, 50));
+    cv::Mat before = background.clone();
+    cv::rectangle(before, cv::Rect(40, 40, 40, 40), cv::Scalar(200, 200, 200),
+    cv::FILLED);
+    gate.update(before);
+    EXPECT_TRUE(gate.sceneChanged());
+    gate.update(before);
+    EXPECT_FALSE(gate.sceneChanged());
+    EXPECT_FALSE(gate.allowDetection());
+    EXPECT_FALSE(gate.allowTrackerUpdate());
+
+    cv::Mat after = background.clone();
+    cv::Rect moved(200, 120, 40, 40);
+    cv::rectangle(after, moved, cv::Scalar(200, 200, 200), cv::FILLED);
+    gate.update(after);
+    EXPECT_TRUE(gate.allowDetection());
+    std::vector<cv::Rect2d> regions = gate.getChangedRegions();
+    EXPECT_TRUE(std::any_of(regions.begin(), regions.end(),
+    [&](const cv::Rect2d &region) {
+        return (region & cv::Rect2d(moved)).area() > 0;
+    }));
+    EXPECT_EQ(gate.getStats().detectionsSkipped, 1u);
+
+    cv::Mat texture(240, 320, CV_8UC3);
+    cv::randu(texture, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::Mat panned = texture.clone();
+    texture(cv::Rect(0, 0, 316, 240)).copyTo(panned(cv::Rect(4, 0, 316, 240)));
+    gate.update(texture);
+    gate.update(panned);
+    EXPECT_NEAR(gate.getGlobalShift().x, 4, 1e-6);
+    EXPECT_FALSE(gate.sceneChanged());
+    EXPECT_TRUE(gate.allowTrackerUpdate());
+}
+
+/**
+ * @brief Test case for the frame pool. Copies of a handle share the buffer, which goes back to the
+ *        pool with the last copy and keeps its memory.
+ */
+TEST(FramePoolTest, HandlesRecycleBuffers) {
+    FramePool pool(2);
+    EXPECT_EQ(pool.capacity(), 2u);
+    const uchar *data = nullptr;
+    {
+        FrameHandle first = pool.acquire();
+        first.mat().create(120, 160, CV_8UC3);
+        data = first.mat().data;
+        FrameHandle copy = first;
+        EXPECT_EQ(copy.useCount(), 2);
+        FrameHandle second = pool.acquire();
+        EXPECT_EQ(pool.available(), 0u);
+        first = FrameHandle();
+        EXPECT_EQ(copy.useCount(), 1);
+        EXPECT_EQ(pool.available(), 0u);
+    }
+    EXPECT_EQ(pool.available(), 2u);
+    FrameHandle again = pool.acquire();
+    again.mat().create(120, 160, CV_8UC3);
+    EXPECT_EQ(again.mat().data, data);
+}
+
+/**
+ * @brief Test case for the steady state frame loop. Once warmed up, decoding into pooled buffers
+ *        and preprocessing into the reused blob allocates no cv::Mat memory.
+ */
+TEST(FramePoolTest, SteadyStateAllocatesNothing) {
+    cv::Mat source(480, 640, CV_8UC3, cv::Scalar(10, 20, 30));
+    FramePool pool(4);
+    Detection detection7;
+    auto step = [&]() {
+        FrameHandle frame = pool.acquire();
+        source.copyTo(frame.mat());
+        detection7.setFrame(frame.mat());
+        detection7.preprocess(frame.mat());
+    };
+    for (int i = 0; i < 4; ++i)
+        step();
+    MatAllocationCounter counter;
+    counter.install();
+    for (int i = 0; i < 20; ++i)
+        step();
+    counter.uninstall();
+    EXPECT_EQ(counter.getCount(), 0u);
+
+    detection7.setLetterbox(false);
+    cv::Mat reference = cv::dnn::blobFromImage(source, 1 / 255.0,
+    cv::Size(416, 416), cv::Scalar(0, 0, 0), true, false);
+    EXPECT_LT(cv::norm(detection7.preprocess(source), reference,
+    cv::NORM_INF), 1e-5);
+}
+
+/**
+ * @brief Test case for the fused letterbox kernel. The blob matches resize, copyMakeBorder and
+ *        blobFromImage run one after another, on one thread and on several, and boxes map back
+ *        to the frame.
+ */
+TEST(PreprocessorTest, MatchesLetterboxReference) {
+    cv::Mat frame(270, 480, CV_8UC3);
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+    const cv::Size inputSize(416, 416);
+    Preprocessor preprocessor;
+    preprocessor.setInputSize(inputSize);
+    cv::Mat blob(std::vector<int>{1, 3, 416, 416}, CV_32F);
+    LetterboxInfo info = preprocessor.run(frame, blob.ptr<float>());
+    EXPECT_TRUE(info.active);
+    EXPECT_EQ(info.content, cv::Size(416, 234));
+    EXPECT_EQ(info.input, inputSize);
+    EXPECT_EQ(info.padX, 0);
+    EXPECT_EQ(info.padY, 91);
+
+    cv::Mat resized, padded;
+    cv::resize(frame, resized, info.content);
+    cv::copyMakeBorder(resized, padded, info.padY,
+    416 - 234 - info.padY, 0, 0, cv::BORDER_CONSTANT, cv::Scalar::all(127.5));
+    cv::Mat reference = cv::dnn::blobFromImage(padded, 1 / 255.0, cv::Size(),
+    cv::Scalar(), true, false);
+    EXPECT_LT(cv::norm(blob, reference, cv::NORM_INF), 2 / 255.0);
+
+    cv::Mat large(1080, 1920, CV_8UC3);
+    cv::randu(large, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::Mat threadedBlob = blob.clone();
+    preprocessor.run(large, blob.ptr<float>());
+    preprocessor.setNumThreads(4);
+    preprocessor.run(large, threadedBlob.ptr<float>());
+    EXPECT_EQ(cv::norm(blob, threadedBlob, cv::NORM_INF), 0);
+
+    cv::Rect box = Preprocessor::undo(cv::Rect(104, 91 + 52, 208, 117), info);
+    EXPECT_EQ(box, cv::Rect(120, 60, 240, 135));
+}
+
+/**
+ * @brief Test case for the model profiles. Names round trip, the low resolution profile shrinks
+ *        the input and boxes are matched one to one by IoU.
+ */
+TEST(ModelProfileTest, ProfilesAndMatching) {
+    for (ModelProfile profile : ModelProfiles::all()) {
+        ModelProfile parsed = ModelProfile::YOLOV4;
+        EXPECT_TRUE(ModelProfiles::parse(ModelProfiles::spec(profile).name,
+        parsed));
+        EXPECT_EQ(parsed, profile);
+    }
+    ModelProfile unknown = ModelProfile::YOLOV4_TINY;
+    EXPECT_FALSE(ModelProfiles::parse("yolov9", unknown));
+    EXPECT_EQ(unknown, ModelProfile::YOLOV4_TINY);
+
+    Detection detection8;
+    detection8.setModelProfile(ModelProfile::YOLOV4_LOW_RES);
+    EXPECT_EQ(detection8.getInputSize(), cv::Size(320, 320));
+
+    std::vector<cv::Rect> reference = {cv::Rect(0, 0, 100, 100),
+    cv::Rect(200, 200, 50, 50)};
+    std::vector<cv::Rect> candidate = {cv::Rect(5, 5, 100, 100),
+    cv::Rect(2, 2, 100, 100), cv::Rect(400, 400, 50, 50)};
+    EXPECT_EQ(ModelProfiles::matchBoxes(reference, candidate), 1u);
+    EXPECT_EQ(ModelProfiles::matchBoxes(reference, candidate, 0.99), 0u);
+}
+
+/**
+ * @brief Test case for the model bundle. Sections written by write() are read back from the
+ *        mapping, and a corrupted byte or a missing file is rejected.
+ */
+TEST(ModelBundleTest, RoundTripAndChecksum) {
+    const std::string config = "bundle_test.cfg";
+    const std::string weights = "bundle_test.weights";
+    const std::string labels = "bundle_test.names";
+    const std::string bundleFile = "bundle_test.bundle";
+    std::ofstream(config) << "[net]\nwidth=416\n";
+    std::string weightBytes(10000, '\0');
+    for (size_t i = 0; i < weightBytes.size(); ++i)
+        weightBytes[i] = static_cast<char>(i * 7);
+    std::ofstream(weights, std::ios::binary) << weightBytes;
+    std::ofstream(labels) << "person\nbicycle\n";
+
+    ASSERT_TRUE(ModelBundle::write(bundleFile, config, weights, labels,
+    {"yolo_139", "yolo_150", "yolo_161"}));
+    {
+        ModelBundle bundle;
+        ASSERT_TRUE(bundle.open(bundleFile));
+        EXPECT_EQ(std::string(bundle.getConfig(), bundle.getConfigSize()),
+        "[net]\nwidth=416\n");
+        EXPECT_EQ(std::string(bundle.getWeights(), bundle.getWeightsSize()),
+        weightBytes);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(bundle.getWeights()) % 4096, 0u);
+        EXPECT_EQ(bundle.getOutputNames(),
+        std::vector<std::string>({"yolo_139", "yolo_150", "yolo_161"}));
+        EXPECT_EQ(bundle.getLabels(),
+        std::vector<std::string>({"person", "bicycle"}));
+    }
+
+    {
+        std::fstream file(bundleFile, std::ios::in | std::ios::out |
+        std::ios::binary);
+        file.seekp(-100, std::ios::end);
+        file.put('x');
+    }
+    ModelBundle corrupted;
+    EXPECT_FALSE(corrupted.open(bundleFile));
+    EXPECT_FALSE(corrupted.isOpen());
+    EXPECT_FALSE(corrupted.open("missing.bundle"));
+    for (const auto &file : {config, weights, labels, bundleFile})
+        std::remove(file.c_str());
+}
+
+/**
+ * @brief Test case for the offline segment plan and the ID stitching. Segments start on
+ *        keyframes and cover the video, and tracks moving through the overlap keep their ID.
+ */
+TEST(OfflineTest, SegmentsAndStitching) {
+    std::vector<cv::Range> segments = OfflineProcessor::planSegments(1000,
+    2, 100);
+    ASSERT_EQ(segments.size(), 4u);
+    EXPECT_EQ(segments.front().start, 0);
+    EXPECT_EQ(segments.back().end, 1000);
+    for (size_t i = 0; i < segments.size(); ++i) {
+        EXPECT_EQ(segments[i].start % 100, 0);
+        if (i > 0) {
+            EXPECT_EQ(segments[i].start, segments[i - 1].end);
+        }
+    }
+    EXPECT_TRUE(OfflineProcessor::planSegments(0, 4, 100).empty());
+
+    // Two people walk through frames 90 to 99, the second segment
+    // numbered them the other way round and also sees a third person
+    std::vector<TrackRecord> previous, current;
+    for (int frame = 90; frame < 100; ++frame) {
+        previous.push_back({frame, 7, cv::Rect2d(frame, 10, 40, 80)});
+        previous.push_back({frame, 9, cv::Rect2d(300 - frame, 200, 40, 80)});
+        current.push_back({frame, 1, cv::Rect2d(300 - frame + 1, 201, 40, 80)});
+        current.push_back({frame, 2, cv::Rect2d(frame + 1, 11, 40, 80)});
+        current.push_back({frame, 3, cv::Rect2d(600, 400, 40, 80)});
+    }
+    std::map<int, int> ids = OfflineProcessor::stitchIds(previous, current,
+    cv::Range(90, 100), 0.3);
+    EXPECT_EQ(ids.size(), 2u);
+    EXPECT_EQ(ids[1], 9);
+    EXPECT_EQ(ids[2], 7);
+    EXPECT_EQ(ids.count(3), 0u);
+}
+
+/**
+ * @brief Test case for the batch image inputs. Only images are listed. An image without its
+ *        done line is redone on resume, and its partial lines and a line cut short by a crash
+ *        are dropped first. Names with commas and unreadable images are not redone.
+ */
+TEST(ImageBatchTest, ListingAndResume) {
+    const std::string directory = "batch_test_images";
+    std::filesystem::create_directory(directory);
+    cv::Mat image(32, 32, CV_8UC3, cv::Scalar(0, 0, 255));
+    cv::imwrite(directory + "/b.png", image);
+    cv::imwrite(directory + "/a.jpg", image);
+    std::ofstream(directory + "/notes.txt") << "not an image";
+    std::vector<std::string> images =
+    ImageBatchProcessor::listImages(directory);
+    ASSERT_EQ(images.size(), 2u);
+    EXPECT_NE(images[0].find("a.jpg"), std::string::npos);
+    EXPECT_NE(images[1].find("b.png"), std::string::npos);
+    EXPECT_EQ(ImageBatchProcessor::listImages(directory + "/*.png").size(),
+    1u);
+
+    const std::string results = "batch_test_results.csv";
+    std::ofstream(results) << "image,x,y,width,height,confidence\n"
+    << images[0] << ",1,2,3,4,0.9\n" << images[0] << ",,,,,done\n"
+    << "\"c,\"\"d\"\".png\",,,,,done\n" << "e,f.png,1,2,3,4,0.8\n"
+    << "e,f.png,,,,,done\n" << "broken.png,,,,,unreadable\n"
+    << images[1] << ",5,6,7,8,0.7\n" << images[1] << ",5,6";
+    std::set<std::string> finished =
+    ImageBatchProcessor::finishedImages(results);
+    EXPECT_EQ(finished.count(images[0]), 1u);
+    // Partly written, and its last line was cut short
+    EXPECT_EQ(finished.count(images[1]), 0u);
+    // Quoted names, names of older files with commas and unreadable images
+    EXPECT_EQ(finished.count("c,\"d\".png"), 1u);
+    EXPECT_EQ(finished.count("e,f.png"), 1u);
+    EXPECT_EQ(finished.count("broken.png"), 1u);
+    EXPECT_EQ(finished.size(), 4u);
+
+    // Resuming drops the partial image and redoes it on clean lines
+    Detection detection12;
+    detection12.loadModelandLabelClasses("missing.weights", "missing.cfg",
+    "../coco.names");
+    ImageBatchProcessor processor;
+    processor.setResultsFile(results);
+    ASSERT_TRUE(processor.process(detection12, directory));
+    EXPECT_EQ(processor.getStats().resumed, 1u);
+    EXPECT_EQ(processor.getStats().images, 1u);
+    std::ifstream written(results);
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(written, line);)
+        lines.push_back(line);
+    ASSERT_EQ(lines.size(), 8u);
+    EXPECT_EQ(lines[6], "broken.png,,,,,unreadable");
+    EXPECT_EQ(lines[7], images[1] + ",,,,,done");
+    EXPECT_EQ(ImageBatchProcessor::finishedImages(results).size(), 5u);
+    std::remove(results.c_str());
+    std::filesystem::remove_all(directory);
+}
+
+/**
+ * @brief Test case for the headless results. A frame is one compact JSON line, and the poses
+ *        come from the tracker without drawing on the frame.
+ */
+TEST(HeadlessTest, FrameLinesAndPoses) {
+    TrackResult track;
+    track.id = 4;
+    track.box = cv::Rect2d(10, 20, 30, 60);
+    track.confidence = 0.9f;
+    track.pose = cv::Point2f(25, 50);
+    std::string line;
+    ResultWriter::formatFrame(7, 233.3, {track}, line);
+    EXPECT_EQ(line, "{\"frame\":7,\"t\":233.3,\"tracks\":[{\"id\":4,"
+    "\"box\":[10.0,20.0,30.0,60.0],\"conf\":0.900,\"pose\":[25.0,50.0]}]}");
+    ResultWriter::formatFrame(8, 266.7, {}, line);
+    EXPECT_EQ(line, "{\"frame\":8,\"t\":266.7,\"tracks\":[]}");
+
+    cv::Mat frame(240, 320, CV_8UC3, cv::Scalar(0, 0, 0));
+    Track tracker9;
+    tracker9.setTrackerMode(TrackerMode::SORT);
+    tracker9.initializeTracker();
+    tracker9.setFrame(frame);
+    tracker9.runTrackerAlgorithm({cv::Rect(100, 60, 40, 80)});
+    std::vector<cv::Point2f> poses = tracker9.getTrackedPoses();
+    std::vector<cv::Rect2d> boxes = tracker9.getTrackedBoxes();
+    ASSERT_EQ(poses.size(), boxes.size());
+    ASSERT_EQ(poses.size(), 1u);
+    EXPECT_FLOAT_EQ(poses[0].x, boxes[0].x + boxes[0].width / 2);
+    EXPECT_FLOAT_EQ(poses[0].y, boxes[0].y + boxes[0].height / 2);
+    EXPECT_EQ(cv::countNonZero(frame.reshape(1)), 0);
+}
+
+/**
+ * @brief Test case for the shared memory ring. A reader sees entries in order with their
+ *        sequence numbers, and a reader that falls a full ring behind skips to the oldest entry
+ *        still there and counts the lost ones.
+ */
+TEST(ShmRingTest, PublishAndOverrun) {
+    const std::string name = "/human_tracks_test";
+    ShmRingPublisher publisher;
+    ASSERT_TRUE(publisher.create(name, 4));
+    ShmRingReader reader;
+    ASSERT_TRUE(reader.open(name));
+    ShmFrame frame;
+    EXPECT_FALSE(reader.tryRead(frame));
+
+    TrackResult track;
+    track.id = 3;
+    track.box = cv::Rect2d(10, 20, 30, 60);
+    track.pose = cv::Point2f(25, 50);
+    EXPECT_EQ(publisher.publish(100, {track}), 0u);
+    ASSERT_TRUE(reader.tryRead(frame));
+    EXPECT_EQ(frame.sequence, 0u);
+    EXPECT_EQ(frame.frameIndex, 100);
+    ASSERT_EQ(frame.trackCount, 1);
+    EXPECT_EQ(frame.tracks[0].id, 3);
+    EXPECT_FLOAT_EQ(frame.tracks[0].poseY, 50);
+    EXPECT_GT(frame.timestampNs, 0);
+    EXPECT_FALSE(reader.tryRead(frame));
+
+    for (int i = 1; i <= 10; ++i)
+        publisher.publish(100 + i, {});
+    ASSERT_TRUE(reader.tryRead(frame));
+    EXPECT_EQ(frame.sequence, 7u);
+    EXPECT_EQ(reader.getDropped(), 6u);
+    ShmRingReader late;
+    ASSERT_TRUE(late.open(name));
+    ASSERT_TRUE(late.readLatest(frame));
+    EXPECT_EQ(frame.frameIndex, 110);
+}
+
+/**
+ * @brief Checks the bucketing, the merged percentiles and the off switch of
+ * the stage profiler
+ */
+TEST(ProfilerTest, PercentilesAndSwitch) {
+    for (uint64_t ns : {0ull, 15ull, 16ull, 1000ull, 123456789ull}) {
+        int bucket = Profiler::bucketOf(ns);
+        EXPECT_LE(ns, Profiler::bucketUpperBound(bucket));
+        if (bucket > 0) {
+            EXPECT_GT(ns, Profiler::bucketUpperBound(bucket - 1));
+        }
+    }
+    Profiler::reset();
+    Profiler::setEnabled(false);
+    { ScopedTimer timer(Stage::DRAW); }
+    EXPECT_TRUE(Profiler::summarize().empty());
+
+    Profiler::setEnabled(true);
+    auto start = std::chrono::steady_clock::now();
+    for (int ms = 1; ms <= 100; ++ms)
+        Profiler::record(Stage::FORWARD, start,
+        start + std::chrono::milliseconds(ms));
+    std::thread other([start] {
+        Profiler::record(Stage::FORWARD, start,
+        start + std::chrono::milliseconds(500));
+    });
+    other.join();
+    Profiler::setEnabled(false);
+    std::vector<StageSummary> summaries = Profiler::summarize();
+    ASSERT_EQ(summaries.size(), 1u);
+    EXPECT_EQ(summaries[0].stage, Stage::FORWARD);
+    EXPECT_EQ(summaries[0].count, 101u);
+    EXPECT_NEAR(summaries[0].p50, 51, 51 * 0.07);
+    EXPECT_NEAR(summaries[0].p95, 96, 96 * 0.07);
+    EXPECT_NEAR(summaries[0].max, 500, 1e-6);
+    Profiler::reset();
+}
+
+/**
+ * @brief Checks the MOT metrics on a hand-made sequence with a miss, a false
+ * positive and an ID switch, the ground truth loader and the Pareto marks
+ */
+TEST(EvaluationTest, MotMetricsAndPareto) {
+    MotAccumulator accumulator;
+    const cv::Rect2d a(0, 0, 40, 100), b(200, 0, 40, 100);
+    accumulator.update({{1, a}, {2, b}}, {{10, a}, {20, b}});
+    accumulator.update({{1, a}, {2, b}}, {{10, a}});
+    accumulator.update({{1, a}, {2, b}}, {{30, a}, {20, b},
+    {40, cv::Rect2d(400, 0, 40, 100)}});
+    MotMetrics metrics = accumulator.finish();
+    EXPECT_EQ(metrics.groundTruth, 6);
+    EXPECT_EQ(metrics.truePositives, 5);
+    EXPECT_EQ(metrics.misses, 1);
+    EXPECT_EQ(metrics.falsePositives, 1);
+    EXPECT_EQ(metrics.idSwitches, 1);
+    EXPECT_NEAR(metrics.mota, 1.0 - 3.0 / 6, 1e-9);
+    // 1 keeps 10 for two frames, 2 keeps 20 for two frames
+    EXPECT_EQ(metrics.idTruePositives, 4);
+    EXPECT_NEAR(metrics.idf1, 8.0 / 12, 1e-9);
+
+    std::string file = (std::filesystem::temp_directory_path() /
+    "gt_test.txt").string();
+    std::ofstream(file) << "1,1,11,21,40,100,1,1,1\n1,2,50,50,10,10,0,1,1\n"
+    "2,3,1,1,40,100,1,7,1\n2,1,12,21,40,100,1,1,0.5\n";
+    MotSequence truth;
+    ASSERT_TRUE(Evaluator::loadGroundTruth(file, truth));
+    ASSERT_EQ(truth[1].size(), 1u);
+    EXPECT_EQ(truth[1][0].box, cv::Rect2d(10, 20, 40, 100));
+    ASSERT_EQ(truth[2].size(), 1u);
+    std::remove(file.c_str());
+
+    std::vector<EvalResult> results(3);
+    results[0].metrics.mota = 0.5;
+    results[0].cpuSecondsPerFrame = 0.1;
+    results[1].metrics.mota = 0.4;
+    results[1].cpuSecondsPerFrame = 0.2;
+    results[2].metrics.mota = 0.6;
+    results[2].cpuSecondsPerFrame = 0.3;
+    Evaluator::markPareto(results);
+    EXPECT_TRUE(results[0].pareto);
+    EXPECT_FALSE(results[1].pareto);
+    EXPECT_TRUE(results[2].pareto);
+    EXPECT_EQ(Evaluator::grid({0.3f, 0.5f}, {0.4f}, {15, 45}, {0.8}).size(),
+    4u);
+}
+
+/**
+ * @brief Test case for the NMS axis of a sweep. A setting's NMS threshold reaches the tracks
+ *        that are scored, and one detector serves several settings.
+ */
+TEST(EvaluationTest, NmsThresholdChangesHypotheses) {
+    Evaluator evaluator;
+    evaluator.setSortTracker(true);
+    Detection detection11;
+    detection11.loadModelandLabelClasses("missing.weights", "missing.cfg",
+    "../coco.names");
+    cv::Mat frame = cv::Mat::zeros(512, 512, CV_8UC3);
+    // Two people close enough for an IoU of 0.6
+    std::vector<cv::Mat> outs = personOutputs({cv::Rect(100, 100, 80, 200),
+    cv::Rect(120, 100, 80, 200)}, {0.9f, 0.8f}, frame.size());
+    std::vector<size_t> counts;
+    for (float nmsThreshold : {0.3f, 0.9f}) {
+        EvalParams params;
+        params.nmsThreshold = nmsThreshold;
+        Track tracker;
+        evaluator.configure(params, detection11, tracker);
+        detection11.setFrame(frame);
+        tracker.setFrame(frame);
+        tracker.runTrackerAlgorithm(detection11.processOutputs(outs));
+        std::vector<MotBox> hypotheses;
+        Evaluator::collectHypotheses(tracker, hypotheses);
+        counts.push_back(hypotheses.size());
+    }
+    EXPECT_EQ(counts, std::vector<size_t>({1, 2}));
+}
+
+/**
+ * @brief Checks that the grid NMS keeps what NMSBoxes keeps, with the grid on
+ * and off, and the cap and soft-NMS options
+ */
+TEST(NmsTest, MatchesNMSBoxes) {
+    cv::RNG rng(5);
+    Nms nms;
+    for (int count : {10, 100, 2000}) {
+        std::vector<cv::Rect> boxes;
+        std::vector<float> scores;
+        cv::Rect person;
+        for (int i = 0; i < count; ++i) {
+            if (i % 8 == 0)
+                person = cv::Rect(rng.uniform(0, 1800), rng.uniform(0, 900),
+                rng.uniform(20, 100), rng.uniform(50, 250));
+            boxes.emplace_back(person.x + rng.uniform(-8, 8),
+            person.y + rng.uniform(-8, 8), person.width + rng.uniform(-8, 8),
+            person.height + rng.uniform(-8, 8));
+            // Coarse scores, so ties are common
+            scores.push_back(rng.uniform(0, 20) / 20.f);
+        }
+        for (float threshold : {0.f, 0.3f, 0.4f, 0.7f}) {
+            std::vector<int> expected, kept;
+            cv::dnn::NMSBoxes(boxes, scores, 0.3f, threshold, expected);
+            nms.run(boxes, scores, 0.3f, threshold, kept);
+            EXPECT_EQ(kept, expected);
+        }
+    }
+
+    std::vector<cv::Rect> boxes = {cv::Rect(0, 0, 40, 100),
+    cv::Rect(4, 2, 40, 100), cv::Rect(300, 0, 40, 100)};
+    std::vector<float> scores = {0.9f, 0.8f, 0.7f};
+    std::vector<int> kept;
+    NmsOptions options;
+    options.maxDetections = 1;
+    nms.setOptions(options);
+    nms.run(boxes, scores, 0.5f, 0.4f, kept);
+    EXPECT_EQ(kept, std::vector<int>({0}));
+
+    // Soft-NMS keeps the overlapping box at a lower score
+    options = NmsOptions();
+    options.method = NmsMethod::SOFT_GAUSSIAN;
+    nms.setOptions(options);
+    nms.run(boxes, scores, 0.1f, 0.4f, kept);
+    ASSERT_EQ(kept, std::vector<int>({0, 2, 1}));
+    EXPECT_FLOAT_EQ(nms.getKeptScores()[1], 0.7f);
+    EXPECT_LT(nms.getKeptScores()[2], 0.8f * 0.5f);
+    NmsMethod method;
+    EXPECT_TRUE(Nms::parseMethod("diou", method));
+    EXPECT_EQ(method, NmsMethod::DIOU);
+    EXPECT_FALSE(Nms::parseMethod("fast", method));
+}
+
+/**
+ * @brief Checks that the detector returns the boxes kept by NMS with their kept scores, and
+ *        that the cap on detections reaches its output
+ */
+TEST(NmsTest, DetectorReturnsKeptBoxes) {
+    Detection detection9;
+    detection9.loadModelandLabelClasses("missing.weights", "missing.cfg",
+    "../coco.names");
+    detection9.initializeParams(0.5, 0.4, 416, 416);
+    detection9.setDrawBoxes(false);
+    // A power of two side keeps the normalized rows exact
+    cv::Mat frame = cv::Mat::zeros(512, 512, CV_8UC3);
+    detection9.setFrame(frame);
+    std::vector<cv::Mat> outs = personOutputs({cv::Rect(60, 100, 80, 200),
+    cv::Rect(64, 104, 80, 200), cv::Rect(260, 100, 80, 200)},
+    {0.9f, 0.8f, 0.7f}, frame.size());
+    std::vector<cv::Rect> found = detection9.processOutputs(outs);
+    ASSERT_EQ(found.size(), 2u);
+    EXPECT_EQ(found[0].x, 60);
+    EXPECT_EQ(found[1].x, 260);
+    EXPECT_EQ(detection9.getConfidence().size(), 2u);
+
+    NmsOptions options;
+    options.maxDetections = 1;
+    detection9.setNmsOptions(options);
+    found = detection9.processOutputs(outs);
+    ASSERT_EQ(found.size(), 1u);
+    EXPECT_EQ(found[0].x, 60);
+    EXPECT_FLOAT_EQ(detection9.getConfidence()[0], 0.9f);
+}